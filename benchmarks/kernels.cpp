@@ -0,0 +1,289 @@
+// Microbenchmarks of the hot kernels on synthetic projects.
+//
+// Every benchmark reports the bytes of its inputs and outputs per second and
+// the nonzeros of its input per second (`nnz/s`). The kernels come from the
+// ISA level selected at run time, `SPECTRE_ISA` forces another one.
+
+#include "canonical.h"
+#include "convert.h"
+#include "core.h"
+#include "pipeline.h"
+#include "synthetic.h"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace {
+  using namespace spectre;
+
+  // The sizes of the projects by `state.range(0)`, from tens of thousands to
+  // millions of nonzeros
+  synthetic_params project_params(std::int64_t const size)
+  {
+    synthetic_params p;
+    p.n_peaks = 1000;
+    if (size == 0)
+      return p;
+
+    p.n_scans = 2000;
+    p.sampling = 0.01;
+    p.density = size == 1 ? 0.005 : 0.02;
+    p.n_peaks = size == 1 ? 5000 : 20000;
+    return p;
+  }
+
+  // A synthetic project in CSC, i.e. each major is a chromatogram
+  template <typename I, typename D>
+  compressed_matrix<I, D> const &project(std::int64_t const size)
+  {
+    static std::map<std::int64_t, compressed_matrix<I, D>> cache;
+    auto it = cache.find(size);
+    if (it == cache.end())
+      it = cache
+               .emplace(size, transpose(synthetic_xic<I, D>(
+                                  project_params(size))))
+               .first;
+    return it->second;
+  }
+
+  template <typename I, typename D>
+  kernel_table<I, I, D> const &kernels(benchmark::State &state)
+  {
+    auto const &isa = select_isa();
+    state.SetLabel(isa.name);
+    return get_kernels<I, I, D>(isa.kernels());
+  }
+
+  template <typename I, typename D>
+  std::size_t bytes(compressed_matrix<I, D> const &A) noexcept
+  {
+    return A.pointers.size() * sizeof(I) + A.indices.size() * sizeof(I) +
+           A.data.size() * sizeof(D);
+  }
+
+  // Reports the throughput of `in_bytes + out_bytes` and of the nonzeros of
+  // `A` per iteration
+  template <typename I, typename D>
+  void report(benchmark::State &state, compressed_matrix<I, D> const &A,
+              std::size_t const out_bytes)
+  {
+    state.SetBytesProcessed(static_cast<std::int64_t>(
+        state.iterations() * (bytes(A) + out_bytes)));
+    state.counters["nnz/s"] = benchmark::Counter(
+        static_cast<double>(A.data.size()),
+        benchmark::Counter::kIsIterationInvariantRate);
+  }
+
+  // An output of the rolling kernels and of the convolutions
+  template <typename I, typename D>
+  compressed_matrix<I, D> rolling_alloc(compressed_matrix<I, D> const &A,
+                                        I const window)
+  {
+    compressed_matrix<I, D> B;
+    B.pointers.resize(A.pointers.size());
+    B.n_minor = A.n_minor;
+    auto const size = rolling_alloc_csr(as_span(A.pointers), as_span(A.indices),
+                                        as_span(B.pointers), A.n_minor, window);
+    B.indices.resize(static_cast<std::size_t>(size));
+    B.data.resize(static_cast<std::size_t>(size));
+    return B;
+  }
+
+  constexpr std::int64_t window = 51;
+
+  template <typename I, typename D, rolling_op Op>
+  void BM_rolling_csr(benchmark::State &state)
+  {
+    auto const &table = kernels<I, D>(state);
+    auto const &A = project<I, D>(state.range(0));
+    auto const n_threads = static_cast<unsigned>(state.range(1));
+    auto B = rolling_alloc(A, static_cast<I>(window));
+
+    for (auto _ : state) {
+      for_majors(A, n_threads, [&](auto const a, auto const b) {
+        table.rolling[Op](as_span(A.pointers).slice(a, b + 1),
+                          as_span(A.indices), as_span(A.data),
+                          as_span(B.indices).slice(B.pointers[a], B.pointers[b]),
+                          as_span(B.data).slice(B.pointers[a], B.pointers[b]),
+                          A.n_minor, static_cast<I>(window));
+      });
+      benchmark::DoNotOptimize(B.data.data());
+    }
+    report(state, A, bytes(B));
+  }
+
+  template <typename I, typename D>
+  void BM_convolve_csr_dv(benchmark::State &state)
+  {
+    auto const &table = kernels<I, D>(state);
+    auto const &A = project<I, D>(state.range(0));
+    auto const n_threads = static_cast<unsigned>(state.range(1));
+    auto const coeffs = savgol_coeffs<D>(5, 3);
+    auto B = rolling_alloc(A, static_cast<I>(coeffs.size()));
+
+    for (auto _ : state) {
+      for_majors(A, n_threads, [&](auto const a, auto const b) {
+        table.convolve(as_span(A.pointers).slice(a, b + 1), as_span(A.indices),
+                       as_span(A.data), as_span(coeffs),
+                       as_span(B.indices).slice(B.pointers[a], B.pointers[b]),
+                       as_span(B.data).slice(B.pointers[a], B.pointers[b]),
+                       A.n_minor);
+      });
+      benchmark::DoNotOptimize(B.data.data());
+    }
+    report(state, A, bytes(B));
+  }
+
+  template <typename I, typename D>
+  void BM_stdev_csr(benchmark::State &state)
+  {
+    auto const &table = kernels<I, D>(state);
+    auto const &A = project<I, D>(state.range(0));
+    auto const n_threads = static_cast<unsigned>(state.range(1));
+    std::vector<D> result(static_cast<std::size_t>(A.n_major()));
+
+    for (auto _ : state) {
+      for_majors(A, n_threads, [&](auto const a, auto const b) {
+        table.stdev(as_span(A.pointers).slice(a, b + 1), as_span(A.data),
+                    A.n_minor, as_span(result).slice(a, b));
+      });
+      benchmark::DoNotOptimize(result.data());
+    }
+    report(state, A, result.size() * sizeof(D));
+  }
+
+  // The max-clip of the baseline estimation, i.e. of the rolling median by the
+  // rolling minimum plus its deviation
+  template <typename I, typename D>
+  void BM_maxclip(benchmark::State &state)
+  {
+    auto const &table = kernels<I, D>(state);
+    auto const &data = project<I, D>(state.range(0));
+    auto const n_threads = static_cast<unsigned>(state.range(1));
+    auto A = rolling(table, rolling_median, data, static_cast<I>(window), 0);
+    auto const B = rolling(table, rolling_min, data, static_cast<I>(window), 0);
+    auto const C = stdev(table, B, 0);
+
+    for (auto _ : state) {
+      for_majors(A, n_threads, [&](auto const a, auto const b) {
+        table.maxclip(as_cspan(A.pointers).slice(a, b + 1),
+                      as_cspan(A.indices), as_span(A.data),
+                      as_cspan(B.pointers).slice(a, b + 1),
+                      as_cspan(B.indices), as_cspan(B.data),
+                      as_cspan(C).slice(a, b));
+      });
+      benchmark::DoNotOptimize(A.data.data());
+    }
+    report(state, A, bytes(B) + C.size() * sizeof(D));
+  }
+
+  template <typename I, typename D>
+  void BM_is_canonical_csr(benchmark::State &state)
+  {
+    auto const &A = project<I, D>(state.range(0));
+    auto const n_threads = static_cast<unsigned>(state.range(1));
+    for (auto _ : state)
+      benchmark::DoNotOptimize(is_canonical_csr(
+          as_span(A.pointers), as_span(A.indices), n_threads));
+    report(state, A, 0);
+  }
+
+  template <typename I, typename D>
+  void BM_is_canonical_coo(benchmark::State &state)
+  {
+    auto const &A = project<I, D>(state.range(0));
+    auto const n_threads = static_cast<unsigned>(state.range(1));
+    std::vector<I> majors;
+    majors.reserve(A.indices.size());
+    for (I major = 0; major < A.n_major(); ++major)
+      majors.insert(majors.end(), A.pointers[major + 1] - A.pointers[major],
+                    major);
+
+    for (auto _ : state)
+      benchmark::DoNotOptimize(is_canonical_coo(
+          as_cspan(majors), as_span(A.indices), n_threads));
+    report(state, A, majors.size() * sizeof(I));
+  }
+
+  // The canonicalization of the project with the indices of every major
+  // reversed, i.e. radix sorted, and with every tenth nonzero duplicated
+  template <typename I, typename D>
+  void BM_canonicalize_csr(benchmark::State &state)
+  {
+    auto const &A = project<I, D>(state.range(0));
+    auto const n_threads = static_cast<unsigned>(state.range(1));
+    compressed_matrix<I, D> shuffled;
+    shuffled.pointers.push_back(0);
+    for (I major = 0; major < A.n_major(); ++major) {
+      for (auto i = A.pointers[major + 1]; i-- > A.pointers[major];) {
+        shuffled.indices.push_back(A.indices[i]);
+        shuffled.data.push_back(A.data[i]);
+        if (i % 10 == 0) {
+          shuffled.indices.push_back(A.indices[i]);
+          shuffled.data.push_back(A.data[i]);
+        }
+      }
+      shuffled.pointers.push_back(static_cast<I>(shuffled.indices.size()));
+    }
+
+    auto B = shuffled;
+    for (auto _ : state) {
+      state.PauseTiming();
+      B.pointers = shuffled.pointers;
+      B.indices = shuffled.indices;
+      B.data = shuffled.data;
+      state.ResumeTiming();
+
+      benchmark::DoNotOptimize(canonicalize_csr(
+          as_span(B.pointers), as_span(B.indices), as_span(B.data),
+          duplicate_sum, n_threads));
+    }
+    report(state, shuffled, 0);
+  }
+
+  template <typename I, typename D>
+  void BM_csr_to_csc(benchmark::State &state)
+  {
+    auto const &A = project<I, D>(state.range(0));
+    for (auto _ : state)
+      benchmark::DoNotOptimize(transpose(A).data.data());
+    report(state, A, bytes(A));
+  }
+
+  // The sizes by the numbers of threads, 0 means all hardware threads
+  void parallel_args(benchmark::internal::Benchmark *b)
+  {
+    b->ArgNames({"size", "threads"})
+        ->ArgsProduct({{0, 1, 2}, {1, 2, 4, 0}})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+  }
+
+  void serial_args(benchmark::internal::Benchmark *b)
+  {
+    b->ArgName("size")->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+  }
+} // namespace
+
+#define SPECTRE_BENCHMARK_TYPES(name, args, ...)                               \
+  BENCHMARK_TEMPLATE(name, std::int32_t, float, ##__VA_ARGS__)->Apply(args);   \
+  BENCHMARK_TEMPLATE(name, std::int32_t, double, ##__VA_ARGS__)->Apply(args);  \
+  BENCHMARK_TEMPLATE(name, std::int64_t, float, ##__VA_ARGS__)->Apply(args);   \
+  BENCHMARK_TEMPLATE(name, std::int64_t, double, ##__VA_ARGS__)->Apply(args)
+
+SPECTRE_BENCHMARK_TYPES(BM_rolling_csr, parallel_args, rolling_min);
+SPECTRE_BENCHMARK_TYPES(BM_rolling_csr, parallel_args, rolling_max);
+SPECTRE_BENCHMARK_TYPES(BM_rolling_csr, parallel_args, rolling_mean);
+SPECTRE_BENCHMARK_TYPES(BM_rolling_csr, parallel_args, rolling_median);
+SPECTRE_BENCHMARK_TYPES(BM_rolling_csr, parallel_args, rolling_sum);
+SPECTRE_BENCHMARK_TYPES(BM_rolling_csr, parallel_args, rolling_count);
+SPECTRE_BENCHMARK_TYPES(BM_convolve_csr_dv, parallel_args);
+SPECTRE_BENCHMARK_TYPES(BM_stdev_csr, parallel_args);
+SPECTRE_BENCHMARK_TYPES(BM_maxclip, parallel_args);
+SPECTRE_BENCHMARK_TYPES(BM_is_canonical_csr, parallel_args);
+SPECTRE_BENCHMARK_TYPES(BM_is_canonical_coo, parallel_args);
+SPECTRE_BENCHMARK_TYPES(BM_canonicalize_csr, parallel_args);
+SPECTRE_BENCHMARK_TYPES(BM_csr_to_csc, serial_args);
+
+BENCHMARK_MAIN();
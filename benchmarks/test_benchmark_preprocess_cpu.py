@@ -1,15 +1,26 @@
+import os
+
 import pytest
 
 import spectre
 
-file_list = ['CalNFR1.mzXML']
+file_list = ['synthetic', 'CalNFR1.mzXML']
 precision_list = [1, 0.1, 0.01, 0.001]
 
 
+def load(file, precision):
+    """The project of `file`, a deterministic synthetic one if 'synthetic'."""
+    if file == 'synthetic':
+        return spectre.synthetic_xic(sampling=precision)
+    if not os.path.exists(file):
+        pytest.skip('{} is not available'.format(file))
+    return spectre.from_mzxml(file, precision)
+
+
 @pytest.mark.parametrize("file", file_list)
 @pytest.mark.parametrize("precision", precision_list)
 def test_bench_naive_preprocess(benchmark, file, precision):
-    experiment = spectre.from_mzxml(file, precision)
+    experiment = load(file, precision)
 
     def function(ex):
         spectre.naive.preprocess(xic=ex.copy(), peak_width=5)
@@ -19,7 +30,7 @@ def test_bench_naive_preprocess(benchmark, file, precision):
 @pytest.mark.parametrize("file", file_list)
 @pytest.mark.parametrize("precision", [1])
 def test_bench_numpy_preprocess(benchmark, file, precision):
-    experiment = spectre.from_mzxml(file, precision)
+    experiment = load(file, precision)
 
     def function(ex):
         spectre.numpy.preprocess(xic=ex.copy(), peak_width=5)
@@ -29,7 +40,7 @@ def test_bench_numpy_preprocess(benchmark, file, precision):
 @pytest.mark.parametrize("file", file_list)
 @pytest.mark.parametrize("precision", precision_list)
 def test_bench_cpp_preprocess(benchmark, file, precision):
-    experiment = spectre.from_mzxml(file, precision)
+    experiment = load(file, precision)
 
     def function(ex):
         spectre.cpp.preprocess(xic=ex.copy(), peak_width=5)
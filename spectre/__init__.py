@@ -1,10 +1,28 @@
+__version__ = '0.0.1'
+
 from .load import from_mzxml
 from .load import from_spectra
 from .load import from_pickle
 from .load import to_pickle
+from .load import from_arrays
+from .load import to_arrays
 
 from .preprocess import numpy
 from .preprocess import naive
 from .preprocess import cpp
 
 from .xic import Xic
+from .sparse.hybrid import HybridXic
+
+from .synthetic import synthetic_xic
+
+from .batch import process_many
+
+from .align import align_runs
+
+from .online import AppendableXic
+from .online import OnlinePreprocessor
+
+from .cache import XicCache
+
+from .tracing import profile
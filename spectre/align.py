@@ -0,0 +1,121 @@
+"""Alignment of the retention times of many runs to a reference run.
+
+The runs are compared through the chromatograms of the most intense m/z
+columns of the reference, so only a few traces per run are ever dense. Each
+run is warped onto the reference by a dynamic time warping within a band
+around the diagonal, natively and in parallel over the runs.
+"""
+from collections import namedtuple
+from typing import List, Optional, Sequence
+
+import numpy as np
+from scipy.sparse import csr_matrix
+
+from spectre.sparse import _sparse
+from spectre.sparse.preprocess_cpp import canonicalize
+from spectre.tracing import span
+from spectre.xic import Xic
+
+Alignment = namedtuple('Alignment', ['rt_scales', 'xic', 'cost'])
+Alignment.__doc__ = """An alignment of one run to the reference.
+
+Attributes:
+    rt_scales (numpy.ndarray): The retention times of the scans of the run
+        warped onto the time of the reference, non-decreasing.
+    xic (Xic): The run resampled at the scans of the reference, i.e. with the
+        `rt_scales` of the reference.
+    cost (float): The mean distance of the matched scans, lower is better.
+"""
+
+
+def select_features(xic: Xic, n_features: int = 50) -> np.ndarray:
+    """The ascending m/z values of the `n_features` columns with the largest
+    total intensity."""
+    totals = np.asarray(xic.index().sum(axis=0)).ravel()
+    top = np.argsort(totals)[::-1][:n_features]
+    return np.sort(np.asarray(xic.mz_scales)[top[totals[top] > 0]])
+
+
+def _profile(xic: Xic, mz: np.ndarray, ppm: float, n_threads: int):
+    """The (scans x features) intensities of the features, flattened."""
+    _, traces = xic.chromatograms(mz, ppm, n_threads=n_threads)
+    return np.ascontiguousarray(traces.T, dtype=np.float64).ravel()
+
+
+def resample(xic: Xic, positions: np.ndarray, rt_scales: np.ndarray,
+             n_threads: int = 0) -> Xic:
+    """Interpolate the scans of `xic` linearly at fractional scan positions.
+
+    Every output scan merges the two neighbouring scans of the input, so the
+    result stays sparse.
+    """
+    x = canonicalize(xic.data.tocsr(), n_threads=n_threads)
+    if x.dtype not in (np.float32, np.float64):
+        x = x.astype(np.float64)
+    positions = np.ascontiguousarray(positions, dtype=np.float64)
+
+    needs_64bit = len(positions) * x.shape[1] > np.iinfo(np.int32).max
+    index_type = np.int64 if needs_64bit else np.result_type(x.indptr,
+                                                             x.indices)
+    indptr = x.indptr.astype(index_type, copy=False)
+    indices = x.indices.astype(index_type, copy=False)
+
+    out_indptr = np.empty(len(positions) + 1, dtype=index_type)
+    size = _sparse.resample_alloc_csr(indptr, indices, positions, out_indptr,
+                                      n_threads)
+    out_indices = np.empty(size, dtype=index_type)
+    out_data = np.empty(size, dtype=x.dtype)
+    _sparse.resample_csr(indptr, indices, x.data, positions, out_indptr,
+                         out_indices, out_data, n_threads)
+
+    data = csr_matrix((out_data, out_indices, out_indptr),
+                      (len(positions), x.shape[1]), copy=False)
+    return Xic(data, xic.mz_scales, rt_scales)
+
+
+def align_runs(reference: Xic, runs: Sequence[Xic], n_features: int = 50,
+               ppm: float = 10.0, band: Optional[int] = None,
+               n_threads: int = 0) -> List[Alignment]:
+    """Align the retention times of `runs` to the `reference`.
+
+    Args:
+        reference (Xic): The run the others are aligned to.
+        runs (Sequence[Xic]): The runs to align.
+        n_features (int): The number of the most intense m/z columns of the
+            reference compared between the runs.
+        ppm (float): A relative m/z tolerance of the features in the runs.
+        band (Optional[int]): The largest shift from the diagonal in scans, a
+            tenth of the scans of the reference by default. A narrower band is
+            faster, the time and memory of a run grow linearly with it.
+        n_threads (int): A number of threads, 0 means all hardware threads.
+
+    Returns:
+        List[Alignment]: An alignment of every run.
+    """
+    n_ref = reference.data.shape[0]
+    if band is None:
+        band = max(1, n_ref // 10)
+
+    with span('align_runs'):
+        mz = select_features(reference, n_features)
+        if not len(mz):
+            raise ValueError('The reference has no intensities to align to!')
+
+        with span('align_runs.profiles'):
+            ref_profile = _profile(reference, mz, ppm, n_threads)
+            profiles = [_profile(run, mz, ppm, n_threads) for run in runs]
+
+        ref_to_run = [np.empty(n_ref) for _ in runs]
+        run_to_ref = [np.empty(run.data.shape[0]) for run in runs]
+        costs = np.empty(len(runs))
+        _sparse.dtw_align_runs(ref_profile, profiles, len(mz), band,
+                               ref_to_run, run_to_ref, costs, n_threads)
+
+        scans = np.arange(n_ref)
+        with span('align_runs.resample'):
+            return [Alignment(np.interp(warp, scans, reference.rt_scales),
+                              resample(run, positions, reference.rt_scales,
+                                       n_threads),
+                              cost)
+                    for run, warp, positions, cost in zip(
+                        runs, run_to_ref, ref_to_run, costs)]
@@ -0,0 +1,216 @@
+import os
+import queue
+import threading
+from time import perf_counter
+from typing import Callable, Iterable, Optional, Sequence
+
+_DONE = object()
+
+
+class StageStats:
+    """Throughput of a single stage of :func:`process_many`.
+
+    Attributes:
+        name (str): A name of the stage.
+        runs (int): A number of runs passed through the stage.
+        seconds (float): A total time spent in the stage (summed over all
+            threads of the stage).
+        bytes (int): A total number of bytes processed by the stage.
+    """
+
+    def __init__(self, name: str):
+        self.name = name
+        self.runs = 0
+        self.seconds = 0.0
+        self.bytes = 0
+        self._lock = threading.Lock()
+
+    def record(self, seconds: float, nbytes: int):
+        with self._lock:
+            self.runs += 1
+            self.seconds += seconds
+            self.bytes += nbytes
+
+    @property
+    def runs_per_second(self) -> float:
+        return self.runs / self.seconds if self.seconds else 0.0
+
+    @property
+    def mb_per_second(self) -> float:
+        return self.bytes / 1e6 / self.seconds if self.seconds else 0.0
+
+    def __repr__(self):
+        return '{}(runs={}, {:.3f} runs/s, {:.1f} MB/s)'.format(
+            self.name, self.runs, self.runs_per_second, self.mb_per_second)
+
+
+class BatchReport:
+    """Throughput of :func:`process_many` overall and per stage.
+
+    Attributes:
+        stages (Dict[str, StageStats]): The 'decode', 'preprocess' and 'write'
+            stages.
+        seconds (float): A wall time of the whole batch.
+        outputs (List[str]): Paths of the written projects.
+    """
+
+    def __init__(self, stages, seconds: float, outputs):
+        self.stages = stages
+        self.seconds = seconds
+        self.outputs = outputs
+
+    @property
+    def runs_per_second(self) -> float:
+        runs = self.stages['write'].runs
+        return runs / self.seconds if self.seconds else 0.0
+
+    def __repr__(self):
+        return 'BatchReport({:.3f} runs/s, {})'.format(
+            self.runs_per_second, list(self.stages.values()))
+
+
+def _put(q: queue.Queue, item, stop: threading.Event) -> bool:
+    while not stop.is_set():
+        try:
+            q.put(item, timeout=0.1)
+            return True
+        except queue.Full:
+            pass
+    return False
+
+
+def _get(q: queue.Queue, stop: threading.Event):
+    while not stop.is_set():
+        try:
+            return q.get(timeout=0.1)
+        except queue.Empty:
+            pass
+    return _DONE
+
+
+def _nbytes(xic) -> int:
+    data = xic.data
+    return data.data.nbytes + data.indices.nbytes + data.indptr.nbytes
+
+
+def process_many(files: Iterable[str], sampling: float, peak_width: float,
+                 outputs: Optional[Sequence[str]] = None,
+                 preprocess: Optional[Callable] = None, n_workers: int = 0,
+                 queue_size: int = 2) -> BatchReport:
+    """Load, preprocess and save many runs with overlapped I/O and compute.
+
+    The runs flow through three stages connected by bounded queues: a decoding
+    thread parses mzXML files (see :func:`spectre.from_mzxml`), a pool of
+    `n_workers` threads preprocesses them (the native kernels release the GIL)
+    and a writing thread pickles the results (see :func:`spectre.to_pickle`).
+    So while run N is being preprocessed, run N+1 is decoded and run N-1 is
+    written.
+
+    Args:
+        files (Iterable[str]): Paths to the mzXML files.
+        sampling (float): A sampling resolution (see
+            :func:`spectre.from_spectra`).
+        peak_width (float): A peak width passed to the preprocessing.
+        outputs (Optional[Sequence[str]]): Paths of the output pickle files,
+            by default the input paths with a '.pickle' extension.
+        preprocess (Optional[Callable]): A preprocessing function with the
+            signature of :func:`spectre.cpp.preprocess` (the default).
+        n_workers (int): A number of preprocessing threads, 0 means one per
+            CPU.
+        queue_size (int): A number of runs buffered between two stages.
+
+    Returns:
+        BatchReport: The throughput of the batch and of each stage.
+    """
+    from spectre.load import from_mzxml, to_pickle
+
+    if preprocess is None:
+        from spectre.sparse.preprocess_cpp import preprocess
+
+    files = list(files)
+    if outputs is None:
+        outputs = [os.path.splitext(file)[0] + '.pickle' for file in files]
+    outputs = list(outputs)
+    if len(outputs) != len(files):
+        raise ValueError('The number of outputs does not match the number of '
+                         'files!')
+
+    n_workers = n_workers or os.cpu_count() or 1
+    decoded = queue.Queue(queue_size)
+    processed = queue.Queue(queue_size)
+    stages = {name: StageStats(name)
+              for name in ('decode', 'preprocess', 'write')}
+
+    stop = threading.Event()
+    errors = []
+    remaining = [n_workers]
+    remaining_lock = threading.Lock()
+
+    def fail(error):
+        errors.append(error)
+        stop.set()
+
+    def decode():
+        try:
+            for i, file in enumerate(files):
+                begin = perf_counter()
+                xic = from_mzxml(file, sampling)
+                stages['decode'].record(perf_counter() - begin,
+                                        os.path.getsize(file))
+                if not _put(decoded, (i, xic), stop):
+                    break
+        except BaseException as error:
+            fail(error)
+        finally:
+            _put(decoded, _DONE, stop)
+
+    def work():
+        try:
+            while True:
+                item = _get(decoded, stop)
+                if item is _DONE:
+                    # wake up the next worker waiting for the input
+                    _put(decoded, _DONE, stop)
+                    break
+
+                i, xic = item
+                begin = perf_counter()
+                nbytes = _nbytes(xic)
+                xic = preprocess(xic, peak_width)
+                stages['preprocess'].record(perf_counter() - begin, nbytes)
+                if not _put(processed, (i, xic), stop):
+                    break
+        except BaseException as error:
+            fail(error)
+        finally:
+            with remaining_lock:
+                remaining[0] -= 1
+                if remaining[0] == 0:
+                    _put(processed, _DONE, stop)
+
+    def write():
+        try:
+            while True:
+                item = _get(processed, stop)
+                if item is _DONE:
+                    break
+
+                i, xic = item
+                begin = perf_counter()
+                to_pickle(xic, outputs[i])
+                stages['write'].record(perf_counter() - begin,
+                                       os.path.getsize(outputs[i]))
+        except BaseException as error:
+            fail(error)
+
+    begin = perf_counter()
+    threads = [threading.Thread(target=decode), threading.Thread(target=write)]
+    threads += [threading.Thread(target=work) for _ in range(n_workers)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    if errors:
+        raise errors[0]
+    return BatchReport(stages, perf_counter() - begin, outputs)
@@ -0,0 +1,194 @@
+import hashlib
+import json
+import os
+import shutil
+import tempfile
+from contextlib import contextmanager
+from typing import Callable, Optional, Text
+
+from spectre.load import from_arrays, to_arrays
+from spectre.xic import Xic
+
+_LOCK = '.lock'
+_TEMP = '.tmp-'
+
+
+def file_digest(path: Text, chunk: int = 1 << 20) -> str:
+    """A SHA-256 of the content of a file."""
+    digest = hashlib.sha256()
+    with open(path, 'rb') as f:
+        for block in iter(lambda: f.read(chunk), b''):
+            digest.update(block)
+    return digest.hexdigest()
+
+
+def _function_name(func: Callable) -> str:
+    return '{}.{}'.format(func.__module__, func.__qualname__)
+
+
+class XicCache:
+    """A content-addressed on-disk cache of loaded and preprocessed projects.
+
+    The entries are keyed by a SHA-256 of the content of the input file, of
+    the processing parameters and of the library version, so a renamed file
+    still hits while an edited one or a new release misses. Each entry is a
+    directory of `.npy` arrays loaded as copy-on-write memory maps, hence a
+    hit costs neither a parse nor a copy and mutating the returned project
+    never touches the cache.
+
+    The cache is safe to share by processes on one host. An entry is written
+    to a temporary directory and renamed into place atomically, so readers
+    see either a complete entry or none, and the eviction of the least
+    recently used entries beyond `max_bytes` runs under an exclusive lock of
+    the cache directory. An entry evicted while being read is a miss.
+
+    Args:
+        directory (Text): A directory of the cache, created if missing.
+        max_bytes (int): A size bound of all entries.
+    """
+
+    def __init__(self, directory: Text, max_bytes: int = 10 << 30):
+        self.directory = os.path.abspath(directory)
+        self.max_bytes = max_bytes
+        os.makedirs(self.directory, exist_ok=True)
+
+    @staticmethod
+    def key(digest: str, **params) -> str:
+        """A key of the entry derived from `digest` by `params`."""
+        from spectre import __version__
+
+        payload = json.dumps({'digest': digest, 'version': __version__,
+                              'params': params}, sort_keys=True, default=repr)
+        return hashlib.sha256(payload.encode()).hexdigest()
+
+    def _path(self, key: str) -> str:
+        return os.path.join(self.directory, key[:2], key)
+
+    @contextmanager
+    def _locked(self):
+        import fcntl
+
+        with open(os.path.join(self.directory, _LOCK), 'a') as lock:
+            fcntl.flock(lock, fcntl.LOCK_EX)
+            try:
+                yield
+            finally:
+                fcntl.flock(lock, fcntl.LOCK_UN)
+
+    def get(self, key: str) -> Optional[Xic]:
+        """The cached project of `key` or None."""
+        path = self._path(key)
+        try:
+            xic = from_arrays(path)
+            # the modification time of an entry is its last use
+            os.utime(path)
+        except (FileNotFoundError, NotADirectoryError):
+            return None
+        return xic
+
+    def put(self, key: str, xic: Xic) -> None:
+        """Store a project, keeping an entry of `key` stored concurrently."""
+        temp = tempfile.mkdtemp(prefix=_TEMP, dir=self.directory)
+        try:
+            to_arrays(xic, temp)
+
+            # locked, so that `clear` never removes the group in between
+            path = self._path(key)
+            with self._locked():
+                os.makedirs(os.path.dirname(path), exist_ok=True)
+                try:
+                    os.rename(temp, path)
+                except OSError:
+                    if not os.path.isdir(path):
+                        raise
+        finally:
+            shutil.rmtree(temp, ignore_errors=True)
+
+        self.evict()
+
+    def _entries(self):
+        for group in os.scandir(self.directory):
+            if not group.is_dir() or group.name.startswith(_TEMP):
+                continue
+            for entry in os.scandir(group.path):
+                try:
+                    size = sum(f.stat().st_size for f in os.scandir(entry.path))
+                    yield entry.stat().st_mtime, size, entry.path
+                except FileNotFoundError:
+                    pass
+
+    def size(self) -> int:
+        """A total size of the entries in bytes."""
+        return sum(size for _, size, _ in self._entries())
+
+    def evict(self) -> None:
+        """Remove the least recently used entries beyond `max_bytes`."""
+        with self._locked():
+            entries = sorted(self._entries())
+            total = sum(size for _, size, _ in entries)
+            for _, size, path in entries:
+                if total <= self.max_bytes:
+                    break
+                # renamed first so that readers never see a partial entry
+                trash = tempfile.mkdtemp(prefix=_TEMP, dir=self.directory)
+                try:
+                    os.rename(path, os.path.join(trash, 'entry'))
+                except FileNotFoundError:
+                    pass
+                shutil.rmtree(trash, ignore_errors=True)
+                total -= size
+
+    def clear(self) -> None:
+        """Remove all entries. The temporary directories of the entries being
+        written concurrently are kept, so those are still stored."""
+        with self._locked():
+            for group in os.scandir(self.directory):
+                if group.is_dir() and not group.name.startswith(_TEMP):
+                    shutil.rmtree(group.path, ignore_errors=True)
+
+    def load(self, file: Text, sampling: float,
+             peak_width: Optional[float] = None,
+             preprocess: Optional[Callable] = None,
+             digest: Optional[str] = None) -> Xic:
+        """:func:`spectre.from_mzxml` and optionally a preprocessing, cached.
+
+        Both the loaded and the preprocessed projects are cached, so another
+        `peak_width` reuses the parsed file.
+
+        Args:
+            file (Text): A valid path to the mzXML file.
+            sampling (float): A sampling resolution.
+            peak_width (Optional[float]): A peak width of the preprocessing,
+                the loaded project is returned when None.
+            preprocess (Optional[Callable]): A preprocessing function with the
+                signature of :func:`spectre.cpp.preprocess` (the default).
+            digest (Optional[str]): A known :func:`file_digest` of the file.
+
+        Returns:
+            Xic: A Spectre project.
+        """
+        from spectre.load import from_mzxml
+
+        digest = digest or file_digest(file)
+        raw_key = self.key(digest, sampling=sampling)
+
+        if peak_width is not None:
+            if preprocess is None:
+                from spectre.sparse.preprocess_cpp import preprocess
+            key = self.key(raw_key, peak_width=peak_width,
+                           preprocess=_function_name(preprocess))
+            xic = self.get(key)
+            if xic is not None:
+                return xic
+
+        xic = self.get(raw_key)
+        if xic is None:
+            xic = from_mzxml(file, sampling)
+            self.put(raw_key, xic)
+
+        if peak_width is None:
+            return xic
+
+        xic = preprocess(xic, peak_width)
+        self.put(key, xic)
+        return xic
@@ -8,7 +8,7 @@ def gaussian_kernel(peak_width, cutoff=0.01):
     # `w(n) = e ^ -0.5 * (n / std)^2`, where `n` is `peak_width / 2`, taken from
     # https://docs.scipy.org/doc/scipy-1.1.0/reference/generated/scipy.signal.windows.gaussian.html
     std = peak_width / np.sqrt(-8 * np.log(cutoff))
-    return signal.gaussian(np.round(peak_width), std)
+    return signal.windows.gaussian(int(np.round(peak_width)), std)
 
 
 def match_filter(data, kernel):
@@ -27,3 +27,58 @@ def match_filter(data, kernel):
         conds[i] = np.linalg.cond(ci)
 
     return ranks, norms, conds
+
+
+def nmf(xic, n_components: int, window: int, max_iter: int = 200,
+        tol: float = 1e-4, warm_start: bool = True, seed: int = 0,
+        n_threads: int = 0):
+    """Separate components of a sparse XIC by non-negative matrix factorization.
+
+    The retention time axis is split into consecutive windows of `window`
+    scans and each window is factorized independently as `X ~ W * H`, where
+    `W` are the elution profiles and `H` the component spectra.
+
+    Args:
+        xic (Xic): A preprocessed Spectre project (see
+            :func:`spectre.sparse.preprocess_cpp.preprocess`).
+        n_components (int): A number of components per window.
+        window (int): A number of scans per window.
+        max_iter (int): A maximal number of multiplicative updates.
+        tol (float): A relative decrease of the fit error to stop at.
+        warm_start (bool): Initialize each window from the spectra of the
+            previous window (the windows are then solved one after another,
+            each one with all threads), otherwise solve the windows in
+            parallel.
+        seed (int): A seed of the random initialization.
+        n_threads (int): A number of threads, 0 means all hardware threads.
+
+    Returns:
+        (numpy.ndarray, numpy.ndarray, numpy.ndarray): The component spectra
+        of shape `(n_windows, n_components, n_mz)`, the elution profiles of
+        shape `(n_rt, n_components)` and the relative error of each window.
+    """
+    from spectre.sparse import _sparse
+
+    data = xic.data.tocsr()
+    data.sum_duplicates()
+    if data.dtype not in (np.float32, np.float64):
+        data = data.astype(np.float64)
+
+    n_rows, n_cols = data.shape
+    windows = np.r_[np.arange(0, n_rows, window), n_rows]
+    windows = windows.astype(data.indptr.dtype)
+    n_windows = windows.size - 1
+
+    rng = np.random.RandomState(seed)
+    scale = np.sqrt(data.data.mean() / n_components) if data.nnz else 1.0
+    profiles = rng.uniform(0, scale, (n_rows, n_components))
+    spectra = rng.uniform(0, scale, (n_windows, n_cols, n_components))
+    profiles = profiles.astype(data.dtype)
+    spectra = spectra.astype(data.dtype)
+    errors = np.zeros(n_windows, data.dtype)
+
+    _sparse.nmf_csr(data.indptr, data.indices, data.data, windows,
+                    profiles.ravel(), spectra.ravel(), errors, n_cols,
+                    n_components, max_iter, tol, warm_start, n_threads)
+
+    return spectra.transpose(0, 2, 1), profiles, errors
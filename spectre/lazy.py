@@ -0,0 +1,406 @@
+import copy
+from typing import List, Optional, Tuple
+
+import numpy as np
+from scipy.sparse import csc_matrix
+
+from spectre.xic import Xic
+
+Range = Tuple[int, int]
+
+
+class _Node:
+    """An operation of the graph, all of them act on each m/z column
+    independently, so any m/z range of the result depends only on the same
+    range of the inputs."""
+
+    def __init__(self, shape, children=()):
+        self.shape = shape
+        self.children = tuple(children)
+
+    def inputs(self, rows: Range, cols: Range) -> List[Tuple['_Node', Range,
+                                                            Range]]:
+        """The regions of the children needed to compute the given region."""
+        return [(child, rows, cols) for child in self.children]
+
+    def apply(self, values, rows: Range, cols: Range, ctx: '_Context'):
+        """Computes the region from the regions of `inputs`."""
+        raise NotImplementedError
+
+    def describe(self) -> str:
+        return type(self).__name__.lstrip('_').lower()
+
+
+class _Source(_Node):
+    def __init__(self, data):
+        # a copy, canonicalizing must not reorder the arrays of the caller
+        data = data.tocsc(copy=True)
+        data.sum_duplicates()
+        if data.dtype not in (np.float32, np.float64):
+            data = data.astype(np.float64)
+        super().__init__(data.shape)
+        self.data = data
+
+    def apply(self, values, rows, cols, ctx):
+        if rows == (0, self.shape[0]) and cols == (0, self.shape[1]):
+            return self.data
+        return self.data[rows[0]:rows[1], cols[0]:cols[1]]
+
+
+class _Select(_Node):
+    def __init__(self, child, rows: Range, cols: Range):
+        super().__init__((rows[1] - rows[0], cols[1] - cols[0]), [child])
+        self.rows, self.cols = rows, cols
+
+    def inputs(self, rows, cols):
+        r0, c0 = self.rows[0], self.cols[0]
+        return [(self.children[0], (r0 + rows[0], r0 + rows[1]),
+                 (c0 + cols[0], c0 + cols[1]))]
+
+    def apply(self, values, rows, cols, ctx):
+        return values[0]
+
+    def describe(self):
+        return 'select(rows={}, cols={})'.format(self.rows, self.cols)
+
+
+class _Windowed(_Node):
+    """An operation along the retention time, a value depends on the scans
+    within `halo` of it, or on the whole column if `halo` is None."""
+
+    halo: Optional[int] = None
+
+    def extend(self, rows: Range) -> Range:
+        if self.halo is None:
+            return 0, self.shape[0]
+        return max(0, rows[0] - self.halo), min(self.shape[0],
+                                                rows[1] + self.halo)
+
+    def inputs(self, rows, cols):
+        return [(self.children[0], self.extend(rows), cols)]
+
+    def compute(self, x, ctx: '_Context', region):
+        raise NotImplementedError
+
+    def apply(self, values, rows, cols, ctx):
+        ext = self.extend(rows)
+        result = self.compute(values[0], ctx, (ext, cols))
+        if ext == rows:
+            return result
+        return result[rows[0] - ext[0]:rows[1] - ext[0]]
+
+
+class _Smooth(_Windowed):
+    def __init__(self, child, window: int, degree: int):
+        super().__init__(child.shape, [child])
+        self.window, self.degree = window, degree
+        self.halo = window // 2
+
+    def compute(self, x, ctx, region):
+        from spectre.sparse.preprocess_cpp import savgol_filter
+        return savgol_filter(x, self.window, self.degree, axis=0)
+
+    def describe(self):
+        return 'smooth(window={}, degree={})'.format(self.window, self.degree)
+
+
+class _Rolling(_Windowed):
+    def __init__(self, child, stat: str, window: int):
+        if stat not in ('min', 'max', 'mean', 'median', 'sum', 'count'):
+            raise ValueError('Unsupported rolling statistic "{}"'.format(stat))
+        super().__init__(child.shape, [child])
+        self.stat, self.window = stat, window
+        self.halo = window // 2
+
+    def compute(self, x, ctx, region):
+        # rolling statistics of the same input share one output structure
+        key = (id(self.children[0]), region, self.window)
+        plan = ctx.plans.get(key)
+        if plan is None:
+            from spectre.sparse.preprocess_cpp import RollingPlan
+            plan = ctx.plans[key] = RollingPlan(x, self.window, axis=0)
+        return getattr(plan, self.stat)(x)
+
+    def describe(self):
+        return 'rolling_{}(window={})'.format(self.stat, self.window)
+
+
+class _Baseline(_Windowed):
+    """The baseline depends on the standard deviation of whole columns, so it
+    blocks the retention time pushdown."""
+
+    def __init__(self, child, k: int):
+        super().__init__(child.shape, [child])
+        self.k = k
+
+    def compute(self, x, ctx, region):
+        from spectre.sparse.preprocess_cpp import estimate_baseline
+        return estimate_baseline(x, self.k)
+
+    def describe(self):
+        return 'baseline(k={})'.format(self.k)
+
+
+class _Clip(_Node):
+    def __init__(self, child, lower: float, upper: float):
+        if not lower <= 0 <= upper:
+            raise ValueError('The clipping range must contain zero!')
+        super().__init__(child.shape, [child])
+        self.lower, self.upper = lower, upper
+
+    def apply(self, values, rows, cols, ctx):
+        from spectre.sparse.preprocess_cpp import clip
+        return clip(values[0], self.lower, self.upper, axis=0)
+
+    def describe(self):
+        return 'clip({}, {})'.format(self.lower, self.upper)
+
+
+class _Subtract(_Node):
+    def __init__(self, lhs, rhs):
+        if lhs.shape != rhs.shape:
+            raise ValueError('Shapes {} and {} do not match'.format(
+                lhs.shape, rhs.shape))
+        super().__init__(lhs.shape, [lhs, rhs])
+
+    def apply(self, values, rows, cols, ctx):
+        return (values[0] - values[1]).tocsc()
+
+
+class _SubtractClip(_Node):
+    """A subtraction fused with the clipping of its result, the difference
+    is never formed."""
+
+    def __init__(self, lhs, rhs, lower: float, upper: float):
+        super().__init__(lhs.shape, [lhs, rhs])
+        self.lower, self.upper = lower, upper
+
+    def apply(self, values, rows, cols, ctx):
+        from spectre.sparse.preprocess_cpp import subtract_clip
+        return subtract_clip(values[0], values[1], self.lower, self.upper,
+                             axis=0)
+
+    def describe(self):
+        return 'subtract_clip({}, {})'.format(self.lower, self.upper)
+
+
+def _fuse(node: _Node, memo: dict) -> _Node:
+    """Rewrites the graph, merging adjacent elementwise stages into a single
+    native pass. Shared subgraphs stay shared."""
+    if id(node) in memo:
+        return memo[id(node)]
+
+    if isinstance(node, _Clip):
+        # the clipping ranges contain zero, so they always intersect
+        child = _fuse(node.children[0], memo)
+        if isinstance(child, (_Clip, _SubtractClip)):
+            lower = max(node.lower, child.lower)
+            upper = min(node.upper, child.upper)
+            if isinstance(child, _Clip):
+                result = _Clip(child.children[0], lower, upper)
+            else:
+                result = _SubtractClip(*child.children, lower, upper)
+        elif isinstance(child, _Subtract):
+            result = _SubtractClip(*child.children, node.lower, node.upper)
+        else:
+            result = _Clip(child, node.lower, node.upper)
+    elif node.children:
+        children = [_fuse(child, memo) for child in node.children]
+        if all(a is b for a, b in zip(children, node.children)):
+            result = node
+        else:
+            result = copy.copy(node)
+            result.children = tuple(children)
+    else:
+        result = node
+
+    memo[id(node)] = result
+    return result
+
+
+def _union(lhs: Range, rhs: Range) -> Range:
+    return min(lhs[0], rhs[0]), max(lhs[1], rhs[1])
+
+
+def _crop(x, have: Tuple[Range, Range], want: Tuple[Range, Range]):
+    if have == want:
+        return x
+    (hr, hc), (wr, wc) = have, want
+    return x[wr[0] - hr[0]:wr[1] - hr[0], wc[0] - hc[0]:wc[1] - hc[0]]
+
+
+class _Context:
+    """Evaluates a graph, each node exactly once over the union of the regions
+    requested by its consumers."""
+
+    def __init__(self, root: _Node):
+        self.plans = {}
+        self.results = {}
+        self.order = self._topological(root)
+        self.regions = {id(root): ((0, root.shape[0]), (0, root.shape[1]))}
+
+        for node in self.order:
+            rows, cols = self.regions[id(node)]
+            for child, child_rows, child_cols in node.inputs(rows, cols):
+                region = self.regions.get(id(child))
+                if region is not None:
+                    child_rows = _union(region[0], child_rows)
+                    child_cols = _union(region[1], child_cols)
+                self.regions[id(child)] = child_rows, child_cols
+
+    @staticmethod
+    def _topological(root: _Node) -> List[_Node]:
+        """The nodes ordered so that each comes before its children."""
+        order, visited = [], set()
+
+        def visit(node):
+            if id(node) not in visited:
+                visited.add(id(node))
+                for child in node.children:
+                    visit(child)
+                order.append(node)
+
+        visit(root)
+        return order[::-1]
+
+    def explain(self) -> str:
+        index = {id(node): i for i, node in enumerate(self.order)}
+        lines = []
+        for i, node in enumerate(self.order):
+            rows, cols = self.regions[id(node)]
+            line = '{}: {} rows={} cols={}'.format(i, node.describe(), rows,
+                                                   cols)
+            if node.children:
+                line += ' <- ' + ', '.join(str(index[id(child)])
+                                           for child in node.children)
+            lines.append(line)
+        return '\n'.join(lines)
+
+    def evaluate(self, node: _Node):
+        if id(node) in self.results:
+            return self.results[id(node)]
+
+        rows, cols = self.regions[id(node)]
+        values = [_crop(self.evaluate(child), self.regions[id(child)],
+                        (child_rows, child_cols))
+                  for child, child_rows, child_cols in node.inputs(rows, cols)]
+
+        if rows[0] == rows[1] or cols[0] == cols[1]:
+            dtype = values[0].dtype if values else node.data.dtype
+            result = csc_matrix((rows[1] - rows[0], cols[1] - cols[0]),
+                                dtype=dtype)
+        else:
+            result = node.apply(values, rows, cols, self)
+
+        self.results[id(node)] = result
+        return result
+
+
+class LazyXic:
+    """A deferred preprocessing pipeline of a Spectre project.
+
+    The operations only record an expression graph. On :meth:`compute` the
+    graph is optimized and evaluated on demand from the requested region:
+
+    * m/z and retention time selections are pushed towards the source, so
+      only the selected columns are processed, while the retention time range
+      of each input is extended by the halo of the windowed operations (the
+      baseline needs whole columns, so it stops the retention time pushdown),
+    * a clipping is fused with a preceding clipping or subtraction into one
+      native clip-and-prune pass,
+    * rolling statistics over the same input share one output structure,
+    * shared subexpressions are computed once, over the union of the regions
+      requested by their consumers.
+
+    Example:
+        >>> pipeline = xic.lazy().preprocess(peak_width=3)
+        >>> result = pipeline.select(mz_range=(200.0, 201.0)).compute()
+    """
+
+    def __init__(self, node: _Node, mz_scales, rt_scales):
+        self._node = node
+        self.mz_scales = mz_scales
+        self.rt_scales = rt_scales
+
+    @classmethod
+    def from_xic(cls, xic: Xic) -> 'LazyXic':
+        return cls(_Source(xic.data), xic.mz_scales, xic.rt_scales)
+
+    @property
+    def shape(self):
+        return self._node.shape
+
+    def _derive(self, node: _Node, mz_scales=None, rt_scales=None):
+        return LazyXic(node,
+                       self.mz_scales if mz_scales is None else mz_scales,
+                       self.rt_scales if rt_scales is None else rt_scales)
+
+    def select(self, mz_range=None, rt_range=None) -> 'LazyXic':
+        """Select an inclusive m/z and/or retention time range."""
+        def bounds(scales, value_range):
+            if value_range is None:
+                return 0, len(scales)
+            lo = int(np.searchsorted(scales, value_range[0], 'left'))
+            hi = int(np.searchsorted(scales, value_range[1], 'right'))
+            return lo, max(lo, hi)
+
+        rows = bounds(self.rt_scales, rt_range)
+        cols = bounds(self.mz_scales, mz_range)
+        return self._derive(_Select(self._node, rows, cols),
+                            self.mz_scales[cols[0]:cols[1]],
+                            self.rt_scales[rows[0]:rows[1]])
+
+    def smooth(self, window: int, degree: int) -> 'LazyXic':
+        """Savitzky-Golay smoothing along the retention time."""
+        return self._derive(_Smooth(self._node, window, degree))
+
+    def rolling(self, stat: str, window: int) -> 'LazyXic':
+        """A rolling 'min', 'max', 'mean', 'median', 'sum' or 'count' along
+        the retention time."""
+        return self._derive(_Rolling(self._node, stat, window))
+
+    def baseline(self, k: int) -> 'LazyXic':
+        """The baseline estimate (see
+        :func:`spectre.sparse.preprocess_cpp.estimate_baseline`)."""
+        return self._derive(_Baseline(self._node, k))
+
+    def clip(self, lower: float = 0, upper: float = np.inf) -> 'LazyXic':
+        """Clip values into `[lower, upper]`, dropping the zeros."""
+        return self._derive(_Clip(self._node, lower, upper))
+
+    def subtract(self, other: 'LazyXic') -> 'LazyXic':
+        return self._derive(_Subtract(self._node, other._node))
+
+    def __sub__(self, other: 'LazyXic') -> 'LazyXic':
+        return self.subtract(other)
+
+    def remove_noise(self, peak_width: float) -> 'LazyXic':
+        """The lazy counterpart of
+        :func:`spectre.sparse.preprocess_cpp.remove_noise`."""
+        peak_width = int(round(peak_width))
+        window = peak_width if (peak_width % 2) else (peak_width + 1)
+        degree = min(3, window - 1)
+        result = self.smooth(window, degree) if degree > 0 else self
+        return result.clip(0)
+
+    def remove_baseline(self, k: int) -> 'LazyXic':
+        """The lazy counterpart of
+        :func:`spectre.sparse.preprocess_cpp.remove_baseline`."""
+        return (self - self.baseline(k)).clip(0)
+
+    def preprocess(self, peak_width: float) -> 'LazyXic':
+        """The lazy counterpart of
+        :func:`spectre.sparse.preprocess_cpp.preprocess`."""
+        return self.remove_noise(peak_width).remove_baseline(
+            int(10 * peak_width))
+
+    def _context(self) -> _Context:
+        return _Context(_fuse(self._node, {}))
+
+    def explain(self) -> str:
+        """The optimized graph with the region computed by each node."""
+        return self._context().explain()
+
+    def compute(self) -> Xic:
+        ctx = self._context()
+        return Xic(ctx.evaluate(ctx.order[0]), self.mz_scales, self.rt_scales)
@@ -117,3 +117,70 @@ def to_pickle(obj: Xic, file: Union[Text, Any]) -> None:
 
     with open(file, 'wb') as f:
         pickle.dump(obj, f)
+
+
+_ARRAYS = ('data', 'indices', 'indptr', 'mz_scales', 'rt_scales')
+
+
+def to_arrays(obj: Xic, directory: Union[Text, Any]) -> None:
+    """Save a Spectre project as a directory of `.npy` arrays.
+
+    The directory holds the compressed sparse arrays of the data, the scales
+    and a `meta.json` of the format and the shape. It is the input and output
+    of the `spectre-preprocess` command line tool.
+
+    Args:
+        obj (Xic): A Spectre project.
+        directory (Union[Text, PathLike]): Path to the directory, created if
+            missing.
+
+    Raises:
+        OSError: An error occurred during writing to the directory.
+    """
+    import json
+    import os
+    from scipy.sparse import isspmatrix_csc
+
+    data = obj.data if isspmatrix_csc(obj.data) else obj.data.tocsr()
+    arrays = {'data': data.data, 'indices': data.indices,
+              'indptr': data.indptr,
+              'mz_scales': np.asarray(obj.mz_scales),
+              'rt_scales': np.asarray(obj.rt_scales)}
+
+    os.makedirs(directory, exist_ok=True)
+    for name, array in arrays.items():
+        np.save(os.path.join(directory, name + '.npy'), array,
+                allow_pickle=False)
+    with open(os.path.join(directory, 'meta.json'), 'w') as f:
+        json.dump({'format': data.format, 'shape': list(data.shape)}, f)
+
+
+def from_arrays(directory: Union[Text, Any], mmap_mode: Any = 'c') -> Xic:
+    """Load a Spectre project from a directory written by :func:`to_arrays`.
+
+    Args:
+        directory (Union[Text, PathLike]): Path to the directory.
+        mmap_mode (Optional[str]): A mode of :func:`numpy.load`, the arrays are
+            copy-on-write memory maps by default.
+
+    Returns:
+        Xic: A Spectre project.
+
+    Raises:
+        OSError: An error occurred during reading the directory.
+    """
+    import json
+    import os
+    from scipy.sparse import csc_matrix, csr_matrix
+
+    with open(os.path.join(directory, 'meta.json')) as f:
+        meta = json.load(f)
+    arrays = {name: np.load(os.path.join(directory, name + '.npy'),
+                            mmap_mode=mmap_mode, allow_pickle=False)
+              for name in _ARRAYS}
+
+    cls = csc_matrix if meta['format'] == 'csc' else csr_matrix
+    data = cls((arrays['data'], arrays['indices'], arrays['indptr']),
+               shape=tuple(meta['shape']), copy=False)
+    return Xic(data=data, mz_scales=arrays['mz_scales'],
+               rt_scales=arrays['rt_scales'])
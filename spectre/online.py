@@ -0,0 +1,329 @@
+from collections import deque
+from typing import Callable, List, Optional, Tuple
+
+import numpy as np
+from scipy.sparse import csr_matrix
+
+from spectre.sparse import _sparse
+from spectre.xic import Xic
+
+Row = Tuple[np.ndarray, np.ndarray]
+
+_INDEX = np.int64
+_EMPTY = (np.empty(0, _INDEX), np.empty(0, np.float64))
+
+
+def _grow(array: np.ndarray, size: int) -> np.ndarray:
+    if size <= array.size:
+        return array
+    result = np.empty(max(size, 2 * array.size), dtype=array.dtype)
+    result[:array.size] = array
+    return result
+
+
+class AppendableXic:
+    """An XIC growing by whole scans, e.g. while they are being acquired.
+
+    The m/z axis is fixed up front by the scan range of the instrument, so
+    appending a scan never touches the previous ones and costs amortized
+    O(scan size). The matrices returned by :func:`AppendableXic.to_xic` are
+    views of the current buffers and stay valid while further scans are
+    appended.
+    """
+
+    def __init__(self, mz_range: Tuple[float, float], sampling: float,
+                 capacity: int = 1024):
+        self.sampling = sampling
+        self._origin = int(round(mz_range[0] / sampling))
+        self.n_cols = int(round(mz_range[1] / sampling)) - self._origin + 1
+        if self.n_cols <= 0:
+            raise ValueError('The m/z range is empty!')
+
+        self.mz_scales = (self._origin + np.arange(self.n_cols)) * sampling
+
+        self._n_rows = 0
+        self._indptr = np.zeros(capacity + 1, dtype=_INDEX)
+        self._indices = np.empty(capacity, dtype=_INDEX)
+        self._data = np.empty(capacity, dtype=np.float64)
+        self._rt = np.empty(capacity, dtype=np.float64)
+
+    def __len__(self):
+        return self._n_rows
+
+    @property
+    def shape(self):
+        return self._n_rows, self.n_cols
+
+    def sample(self, mz: np.ndarray, values: np.ndarray) -> Row:
+        """Sample the peaks of a scan to the m/z columns.
+
+        The peaks falling to the same column are max pooled, like in
+        :func:`spectre.from_spectra`.
+
+        Returns:
+            (numpy.ndarray, numpy.ndarray): The sorted columns and the values.
+        """
+        mz = np.asarray(mz, dtype=np.float64)
+        values = np.asarray(values, dtype=np.float64)
+        if mz.shape != values.shape or mz.ndim != 1:
+            raise ValueError('Expected 1-d m/z values and intensities of the '
+                             'same size!')
+
+        cols = np.round(mz * (1 / self.sampling)).astype(_INDEX) - self._origin
+        if cols.size and (cols.min() < 0 or cols.max() >= self.n_cols):
+            raise ValueError('The scan has peaks outside of the m/z range!')
+
+        order = np.argsort(cols, kind='stable')
+        cols, values = cols[order], values[order]
+        if cols.size:
+            starts = np.flatnonzero(np.r_[True, cols[1:] != cols[:-1]])
+            cols, values = cols[starts], np.maximum.reduceat(values, starts)
+        return cols, values
+
+    def append_scan(self, rt: float, mz: np.ndarray, values: np.ndarray):
+        """Append a scan given by its m/z values and intensities."""
+        self.append_row(rt, *self.sample(mz, values))
+
+    def append_row(self, rt: float, cols: np.ndarray, values: np.ndarray):
+        """Append an already sampled scan with sorted unique columns."""
+        if self._n_rows and not rt > self._rt[self._n_rows - 1]:
+            raise ValueError('Scans are not sorted by retention times!')
+
+        n, nnz = self._n_rows, self._indptr[self._n_rows]
+        size = nnz + len(cols)
+
+        self._indptr = _grow(self._indptr, n + 2)
+        self._rt = _grow(self._rt, n + 1)
+        self._indices = _grow(self._indices, size)
+        self._data = _grow(self._data, size)
+
+        self._indices[nnz:size] = cols
+        self._data[nnz:size] = values
+        self._indptr[n + 1] = size
+        self._rt[n] = rt
+        self._n_rows = n + 1
+
+    def row(self, i: int) -> Row:
+        a, b = self._indptr[i], self._indptr[i + 1]
+        return self._indices[a:b], self._data[a:b]
+
+    def to_xic(self) -> Xic:
+        n = self._n_rows
+        nnz = self._indptr[n]
+        data = csr_matrix((self._data[:nnz], self._indices[:nnz],
+                           self._indptr[:n + 1]), shape=(n, self.n_cols),
+                          copy=False)
+        return Xic(data=data, mz_scales=self.mz_scales,
+                   rt_scales=self._rt[:n])
+
+
+class _Window:
+    """A centered window of `size` rows sliding over a stream of rows.
+
+    Each pushed row yields the output of the row `size // 2` rows back, the
+    rows before the first one and after the last one are empty, like the
+    zero padding of the batch rolling operations.
+    """
+
+    def __init__(self, size: int, func: Callable[[List[Row]], Row]):
+        self.size = size
+        self.func = func
+        self._rows = deque([_EMPTY] * ((size - 1) // 2))
+
+    @property
+    def latency(self):
+        return self.size // 2
+
+    def push(self, row: Row) -> Optional[Row]:
+        self._rows.append(row)
+        if len(self._rows) < self.size:
+            return None
+        result = self.func(list(self._rows))
+        self._rows.popleft()
+        return result
+
+    def finish(self) -> List[Row]:
+        results = (self.push(_EMPTY) for _ in range(self.latency))
+        return [result for result in results if result is not None]
+
+
+def _stack(rows: List[Row]):
+    indptr = np.zeros(len(rows) + 1, dtype=_INDEX)
+    np.cumsum([len(cols) for cols, _ in rows], out=indptr[1:])
+    indices = np.concatenate([cols for cols, _ in rows])
+    data = np.concatenate([values for _, values in rows])
+    return indptr, indices, data
+
+
+def _rolling_scan(stat: str):
+    kernel = getattr(_sparse, 'rolling_scan_{}_csr'.format(stat))
+
+    def func(rows: List[Row]) -> Row:
+        indptr, indices, data = _stack(rows)
+        cols, values = np.empty_like(indices), np.empty_like(data)
+        size = kernel(indptr, indices, data, cols, values)
+        return cols[:size], values[:size]
+    return func
+
+
+def _convolve_scan(coeffs: np.ndarray):
+    coeffs = np.ascontiguousarray(coeffs, dtype=np.float64)
+
+    def func(rows: List[Row]) -> Row:
+        indptr, indices, data = _stack(rows)
+        cols, values = np.empty_like(indices), np.empty_like(data)
+        size = _sparse.convolve_scan_csr(indptr, indices, data, coeffs, cols,
+                                         values)
+        return cols[:size], values[:size]
+    return func
+
+
+def _positive(row: Row) -> Row:
+    cols, values = row
+    mask = values > 0
+    return cols[mask], values[mask]
+
+
+def _lookup(row: Row, cols: np.ndarray) -> np.ndarray:
+    """The values of `row` at the sorted `cols`, zero where it has none."""
+    row_cols, row_values = row
+    index = np.searchsorted(row_cols, cols)
+    found = index < row_cols.size
+    found[found] = row_cols[index[found]] == cols[found]
+    result = np.zeros(cols.size, dtype=np.float64)
+    result[found] = row_values[index[found]]
+    return result
+
+
+class OnlinePreprocessor:
+    """The :func:`spectre.preprocess.cpp.preprocess` of a run being acquired.
+
+    Every m/z column keeps its rolling state along the retention time, i.e.
+    the smoothing window and the minimum, median and mean windows of the
+    baseline, and a scan is finalized as soon as it has left all of their
+    trailing halves. So appending a scan costs time bounded by the window
+    sizes times the scan size, regardless of the length of the run, and the
+    preprocessed scans lag `latency` scans behind the appended ones.
+
+    The result equals the batch preprocessing, except that the clipping of
+    the median baseline uses the standard deviation of the rolling minimum
+    over the scans finalized so far instead of the whole run, and that runs
+    shorter than the baseline window do not shorten the median window.
+    """
+
+    def __init__(self, mz_range: Tuple[float, float], sampling: float,
+                 peak_width: float):
+        from scipy.signal import savgol_coeffs
+
+        self.result = AppendableXic(mz_range, sampling)
+
+        width = int(round(peak_width))
+        window = width if (width % 2) else (width + 1)
+        degree = min(3, window - 1)
+        self._smooth = (_Window(window, _convolve_scan(
+            savgol_coeffs(window, degree))) if degree > 0 else None)
+
+        k = int(10 * peak_width)
+        k_med = k if (k % 2) else (k - 1)
+        if k_med < 1:
+            raise ValueError('The peak width is too small!')
+        self._min = _Window(k, _rolling_scan('min'))
+        self._median = _Window(k_med, _rolling_scan('median'))
+        self._mean = _Window(k, _rolling_scan('mean'))
+
+        # running moments of the rolling minimum of each column
+        self._n_min = 0
+        self._sum = np.zeros(self.result.n_cols, dtype=np.float64)
+        self._sum2 = np.zeros(self.result.n_cols, dtype=np.float64)
+
+        self._rt = deque()
+        self._smoothed = deque()
+        self._mins = deque()
+        self._medians = deque()
+
+    @property
+    def latency(self) -> int:
+        """A number of scans appended but not finalized yet."""
+        smooth = self._smooth.latency if self._smooth else 0
+        return (smooth + max(self._min.latency, self._median.latency) +
+                self._mean.latency)
+
+    def append_scan(self, rt: float, mz: np.ndarray,
+                    values: np.ndarray) -> int:
+        """Append a raw scan.
+
+        Returns:
+            int: A number of scans finalized to `result` by the call.
+        """
+        if self._rt and not rt > self._rt[-1]:
+            raise ValueError('Scans are not sorted by retention times!')
+
+        n_rows = len(self.result)
+        self._rt.append(rt)
+        self._push_raw(self.result.sample(mz, values))
+        return len(self.result) - n_rows
+
+    def finish(self) -> Xic:
+        """Finalize the remaining scans, no scan may be appended afterwards.
+
+        Returns:
+            Xic: The preprocessed run.
+        """
+        if self._smooth:
+            for row in self._smooth.finish():
+                self._push_smoothed(_positive(row))
+        for row in self._min.finish():
+            self._push_min(row)
+        for row in self._median.finish():
+            self._push_median(row)
+        for row in self._mean.finish():
+            self._push_baseline(row)
+        return self.result.to_xic()
+
+    def _push_raw(self, row: Row):
+        if self._smooth is None:
+            self._push_smoothed(_positive(row))
+        else:
+            smoothed = self._smooth.push(row)
+            if smoothed is not None:
+                self._push_smoothed(_positive(smoothed))
+
+    def _push_smoothed(self, row: Row):
+        self._smoothed.append(row)
+        data_min = self._min.push(row)
+        if data_min is not None:
+            self._push_min(data_min)
+        median = self._median.push(row)
+        if median is not None:
+            self._push_median(median)
+
+    def _push_min(self, row: Row):
+        cols, values = row
+        self._n_min += 1
+        self._sum[cols] += values
+        self._sum2[cols] += values * values
+        self._mins.append(row)
+        self._clip_medians()
+
+    def _push_median(self, row: Row):
+        self._medians.append(row)
+        self._clip_medians()
+
+    def _clip_medians(self):
+        while self._mins and self._medians:
+            data_min = self._mins.popleft()
+            cols, values = self._medians.popleft()
+
+            mean = self._sum[cols] / self._n_min
+            var = self._sum2[cols] / self._n_min - mean * mean
+            limit = _lookup(data_min, cols) + np.sqrt(np.maximum(var, 0))
+
+            baseline = self._mean.push((cols, np.minimum(values, limit)))
+            if baseline is not None:
+                self._push_baseline(baseline)
+
+    def _push_baseline(self, baseline: Row):
+        cols, values = self._smoothed.popleft()
+        values = values - _lookup(baseline, cols)
+        mask = values > 0
+        self.result.append_row(self._rt.popleft(), cols[mask], values[mask])
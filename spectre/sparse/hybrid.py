@@ -0,0 +1,202 @@
+"""A density-adaptive layout of the projects.
+
+Most m/z columns hold a few peaks, but some (solvent ions, background masses,
+the lock mass) are nonzero in almost every scan. A :class:`HybridMatrix`
+stores the columns denser than a threshold as contiguous arrays and the rest
+as CSC, and its kernels run every column through the dense or the sparse
+code. The results equal those of :mod:`spectre.sparse.preprocess_cpp` along
+`axis=0`, up to the rounding of the sums.
+"""
+from typing import Union
+
+import numpy as np
+from scipy.sparse import coo_matrix, csc_matrix, csr_matrix
+
+from spectre.sparse import _sparse
+from spectre.sparse.preprocess_cpp import _output_index_type, canonicalize
+from spectre.xic import Xic
+
+
+class HybridMatrix:
+    """A matrix of scans by m/z columns, some of which are stored densely.
+
+    Args:
+        sparse (csc_matrix): The matrix, the dense columns of which are empty.
+        dense (numpy.ndarray): The values of the dense columns, one row per
+            column.
+        columns (numpy.ndarray): The ascending indices of the dense columns.
+    """
+
+    def __init__(self, sparse: csc_matrix, dense: np.ndarray,
+                 columns: np.ndarray):
+        if dense.shape != (len(columns), sparse.shape[0]):
+            raise ValueError('The dense values do not match the columns!')
+        self.sparse = sparse
+        self.dense = np.ascontiguousarray(dense, dtype=sparse.dtype)
+        self.columns = np.asarray(columns, dtype=sparse.indices.dtype)
+
+    @classmethod
+    def from_sparse(cls, x: Union[coo_matrix, csr_matrix, csc_matrix],
+                    threshold: float = 0.5) -> 'HybridMatrix':
+        """Split a matrix into the dense and the sparse columns.
+
+        Args:
+            x (Union[coo_matrix, csr_matrix, csc_matrix]): A matrix of scans
+                by m/z columns.
+            threshold (float): The fraction of nonzero scans from which a
+                column is stored densely. At 0.5 a dense column of 32-bit
+                values takes as much memory as a sparse one with 32-bit
+                indices.
+        """
+        x = canonicalize(x.tocsc())
+        if x.dtype not in (np.float32, np.float64):
+            x = x.astype(np.float64)
+
+        counts = np.diff(x.indptr)
+        columns = np.flatnonzero(counts >= threshold * max(x.shape[0], 1))
+        dense = x[:, columns].toarray().T
+
+        keep = np.ones(x.shape[1], dtype=bool)
+        keep[columns] = False
+        indptr = np.zeros_like(x.indptr)
+        np.cumsum(counts * keep, out=indptr[1:])
+        mask = np.repeat(keep, counts)
+        sparse = csc_matrix((x.data[mask], x.indices[mask], indptr), x.shape)
+        return cls(sparse, dense, columns)
+
+    @property
+    def shape(self):
+        return self.sparse.shape
+
+    @property
+    def dtype(self):
+        return self.sparse.dtype
+
+    def tocsc(self) -> csc_matrix:
+        """The whole matrix in CSC, without the zeros of the dense columns."""
+        rows, cols = np.nonzero(self.dense.T)
+        dense = coo_matrix((self.dense.T[rows, cols],
+                            (rows, self.columns[cols])), self.shape)
+        return (self.sparse + dense).tocsc()
+
+    def toarray(self) -> np.ndarray:
+        result = self.sparse.toarray()
+        result[:, self.columns] = self.dense.T
+        return result
+
+    def _arrays(self):
+        return (self.sparse.indptr, self.sparse.indices, self.sparse.data,
+                self.dense.ravel())
+
+    def _rolling_output(self, window: int):
+        """An output of a rolling operation, with its sparse structure."""
+        index_type = _output_index_type(self.sparse, window)
+        indptr = np.empty(self.sparse.indptr.shape, dtype=index_type)
+        size = _sparse.rolling_alloc_csr(self.sparse.indptr,
+                                         self.sparse.indices, indptr,
+                                         self.shape[0], window)
+        indices = np.empty(size, dtype=index_type)
+        data = np.empty(size, dtype=self.dtype)
+        dense = np.empty_like(self.dense)
+        return indptr, indices, data, dense
+
+    def _with(self, indptr, indices, data, dense) -> 'HybridMatrix':
+        sparse = csc_matrix((data, indices, indptr), self.shape, copy=False)
+        return HybridMatrix(sparse, dense, self.columns)
+
+
+class HybridXic:
+    """An :class:`Xic` whose data is a :class:`HybridMatrix`."""
+
+    def __init__(self, data: HybridMatrix, mz_scales, rt_scales):
+        self.data = data
+        self.mz_scales = mz_scales
+        self.rt_scales = rt_scales
+
+    @classmethod
+    def from_xic(cls, xic: Xic, threshold: float = 0.5) -> 'HybridXic':
+        """See :meth:`HybridMatrix.from_sparse` for the `threshold`."""
+        return cls(HybridMatrix.from_sparse(xic.data, threshold),
+                   xic.mz_scales, xic.rt_scales)
+
+    def to_xic(self) -> Xic:
+        return Xic(self.data.tocsc(), self.mz_scales, self.rt_scales)
+
+
+def _rolling(name: str, x: HybridMatrix, window: int, n_threads: int):
+    indptr, indices, data, dense = x._rolling_output(window)
+    getattr(_sparse, name)(*x._arrays(), x.columns, indptr, indices, data,
+                           dense.ravel(), x.shape[0], window, n_threads)
+    return x._with(indptr, indices, data, dense)
+
+
+def rolling_min(x: HybridMatrix, window: int, n_threads: int = 0):
+    return _rolling('rolling_min_hybrid', x, window, n_threads)
+
+
+def rolling_max(x: HybridMatrix, window: int, n_threads: int = 0):
+    return _rolling('rolling_max_hybrid', x, window, n_threads)
+
+
+def rolling_mean(x: HybridMatrix, window: int, n_threads: int = 0):
+    return _rolling('rolling_mean_hybrid', x, window, n_threads)
+
+
+def rolling_median(x: HybridMatrix, window: int, n_threads: int = 0):
+    return _rolling('rolling_median_hybrid', x, window, n_threads)
+
+
+def rolling_sum(x: HybridMatrix, window: int, n_threads: int = 0):
+    return _rolling('rolling_sum_hybrid', x, window, n_threads)
+
+
+def rolling_count(x: HybridMatrix, window: int, n_threads: int = 0):
+    """The number of the nonzero values within each window."""
+    return _rolling('rolling_count_hybrid', x, window, n_threads)
+
+
+def convolve(x: HybridMatrix, coeffs: np.ndarray, n_threads: int = 0):
+    coeffs = np.ascontiguousarray(coeffs, dtype=x.dtype)
+    indptr, indices, data, dense = x._rolling_output(coeffs.shape[0])
+    _sparse.convolve_hybrid(*x._arrays(), x.columns, coeffs, indptr, indices,
+                            data, dense.ravel(), x.shape[0], n_threads)
+    return x._with(indptr, indices, data, dense)
+
+
+def savgol_filter(x: HybridMatrix, window: int, degree: int,
+                  n_threads: int = 0):
+    from scipy.signal import savgol_coeffs
+    return convolve(x, savgol_coeffs(window, degree), n_threads)
+
+
+def std(x: HybridMatrix, n_threads: int = 0) -> np.ndarray:
+    """The standard deviation of each column, counting the zeros."""
+    result = np.empty(x.shape[1], dtype=x.dtype)
+    _sparse.std_hybrid(*x._arrays(), x.columns, x.shape[0], result, n_threads)
+    return result
+
+
+def max_clip_spmat_plus_dvec(a: HybridMatrix, b: HybridMatrix,
+                             c: np.ndarray, n_threads: int = 0):
+    """Compute `a = min(a, b + c)` in place, where `c` holds one value per
+    column. Both matrices must share their dense columns."""
+    if a.shape != b.shape or not np.array_equal(a.columns, b.columns):
+        raise ValueError('The matrices must share their dense columns!')
+    c = np.ascontiguousarray(c, dtype=a.dtype)
+    b_arrays = (b.sparse.indptr.astype(a.sparse.indptr.dtype, copy=False),
+                b.sparse.indices.astype(a.sparse.indices.dtype, copy=False),
+                b.sparse.data, b.dense.ravel())
+    _sparse.maxclip_hybrid(*a._arrays(), *b_arrays, c, a.columns, a.shape[0],
+                           n_threads)
+
+
+def estimate_baseline(x: HybridMatrix, k: int, n_threads: int = 0):
+    """:func:`spectre.sparse.preprocess_cpp.estimate_baseline` of a hybrid
+    matrix."""
+    k_med = min(k, x.shape[0] - 1)
+    k_med = k_med if (k_med % 2) else (k_med - 1)
+
+    x_min = rolling_min(x, k, n_threads)
+    x_base = rolling_median(x, k_med, n_threads)
+    max_clip_spmat_plus_dvec(x_base, x_min, std(x_min, n_threads), n_threads)
+    return rolling_mean(x_base, k, n_threads)
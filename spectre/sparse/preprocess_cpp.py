@@ -1,22 +1,60 @@
-from typing import Union
+from collections import namedtuple
+from typing import List, Optional, Sequence, Union
 
 import numpy as np
 from scipy.sparse import coo_matrix, csr_matrix, csc_matrix
 from scipy.sparse import isspmatrix_coo, isspmatrix_csr, isspmatrix_csc
 
+from spectre.tracing import span
 from spectre.xic import Xic
 from spectre.sparse import _sparse
 
 
-def is_canonical(x: Union[coo_matrix, csr_matrix, csc_matrix]):
+def is_canonical(x: Union[coo_matrix, csr_matrix, csc_matrix],
+                 n_threads: int = 0):
+    """Whether the indices are sorted and unique. The check runs in parallel
+    and stops at the first violation."""
     if isspmatrix_coo(x):
-        return _sparse.is_canonical_coo(x.row, x.col)
+        return _sparse.is_canonical_coo(x.row, x.col, n_threads)
     elif isspmatrix_csr(x) or isspmatrix_csc(x):
-        return _sparse.is_canonical_csr(x.indptr, x.indices)
+        return _sparse.is_canonical_csr(x.indptr, x.indices, n_threads)
     else:
         raise TypeError("unsupported type given '{}'".format(type(x)))
 
 
+def canonicalize(x: Union[csr_matrix, csc_matrix], op: str = 'sum',
+                 n_threads: int = 0):
+    """Sort the indices of `x` and merge the duplicates in place.
+
+    A native `sum_duplicates` that returns at once when `x` is already
+    canonical. The rows (or columns of CSC) are sorted in parallel, the values
+    of the duplicate indices are merged by `op`, one of 'sum', 'max' and 'min'.
+    """
+    if not (isspmatrix_csr(x) or isspmatrix_csc(x)):
+        raise TypeError("unsupported type given '{}'".format(type(x)))
+    if op not in ('sum', 'max', 'min'):
+        raise ValueError('Unsupported duplicate op "{}"'.format(op))
+
+    if not is_canonical(x, n_threads):
+        if x.dtype in (np.float32, np.float64):
+            # the native kernel sorts writable arrays of one index type
+            index_type = np.result_type(x.indptr, x.indices)
+            x.indptr = np.require(x.indptr, index_type, ['C', 'W'])
+            x.indices = np.require(x.indices, index_type, ['C', 'W'])
+            x.data = np.require(x.data, None, ['C', 'W'])
+            size = _sparse.canonicalize_csr(x.indptr, x.indices, x.data, op,
+                                            n_threads)
+            x.indices = x.indices[:size]
+            x.data = x.data[:size]
+        elif op == 'sum':
+            x.sum_duplicates()
+        else:
+            raise TypeError('The duplicate op "{}" needs floating values'
+                            .format(op))
+    x.has_canonical_format = True
+    return x
+
+
 def std(x: Union[csr_matrix, csc_matrix], axis: int):
     if axis not in (0, 1):
         raise ValueError(
@@ -29,42 +67,213 @@ def std(x: Union[csr_matrix, csc_matrix], axis: int):
     return y
 
 
-def rolling(func, x: Union[csr_matrix, csc_matrix], window: int, axis: int):
-    x = x.tocsr() if axis else x.tocsc()
-    x.sum_duplicates()
-    minor_size = x.shape[1] if axis else x.shape[0]
-
+def _output_index_type(x: Union[csr_matrix, csc_matrix], window: int):
+    """The narrowest signed index type of an output of a rolling operation."""
     needs_64bit = min(np.prod(x.shape), x.nnz * window) > np.iinfo(np.int32).max
-    index_type = np.int64 if needs_64bit else x.indptr.dtype
-
-    pointers = np.empty(x.indptr.shape, dtype=index_type)
-    size = _sparse.rolling_alloc_csr(x.indptr, x.indices, pointers, minor_size,
-                                     window)
-    data = np.zeros(size, dtype=x.data.dtype)
-    indices = np.zeros(size, dtype=index_type)
-
-    func(x.indptr, x.indices, x.data, indices, data, minor_size, window)
-
-    if axis:
-        return csr_matrix((data, indices, pointers), x.shape)
-    else:
-        return csc_matrix((data, indices, pointers), x.shape)
+    if needs_64bit or not np.can_cast(x.indices.dtype, np.int32):
+        return np.int64
+    return np.int32
+
+
+class RollingPlan:
+    """Output structure of rolling operations over one sparsity pattern.
+
+    The output indices of a rolling operation depend only on the sparsity
+    pattern of the input and on the window, so the plan computes them once
+    and every kernel run against it only writes values (in parallel over the
+    rows). The results of all runs share the index arrays of the plan, they
+    are read-only views of it, so copy a result (`result.copy()`) before
+    changing its structure in place, e.g. by `eliminate_zeros`. A matrix run
+    against the plan must have exactly the pattern of `x`, otherwise
+    `ValueError` is raised. The native plan owns the scratch space of the
+    kernels, reused by every run. Pass `out` to write the values to a buffer
+    of your own, or `reuse=True` to write them to the one the plan owns for
+    the dtype, which the next such run overwrites.
+
+    Args:
+        x (Union[csr_matrix, csc_matrix]): A matrix defining the pattern.
+        window (int): A size of the rolling window.
+        axis (int): An axis to roll along.
+        n_threads (int): A number of threads, 0 means all hardware threads.
+    """
+
+    def __init__(self, x: Union[csr_matrix, csc_matrix], window: int,
+                 axis: int, n_threads: int = 0):
+        x = self._canonical(x, axis)
+        minor_size = x.shape[1] if axis else x.shape[0]
+
+        self.axis = axis
+        self.shape = x.shape
+        self._outputs = {}
+        self._plan = _sparse.RollingPlan(x.indptr, x.indices, minor_size,
+                                         window, _output_index_type(x, window),
+                                         n_threads)
+
+    @staticmethod
+    def _canonical(x, axis):
+        return canonicalize(x.tocsr() if axis else x.tocsc())
+
+    def _execute(self, func, x, out, reuse):
+        x = self._canonical(x, self.axis)
+        if out is None and reuse:
+            out = self._outputs.get(x.data.dtype)
+            if out is None:
+                out = self._outputs[x.data.dtype] = np.empty(
+                    self._plan.indices.shape, dtype=x.data.dtype)
+        elif out is None:
+            out = np.empty(self._plan.indices.shape, dtype=x.data.dtype)
+
+        func(x.indptr, x.indices, x.data, out)
+
+        cls = csr_matrix if self.axis else csc_matrix
+        return cls((out, self._plan.indices, self._plan.indptr), self.shape,
+                   copy=False)
+
+    def min(self, x, out: np.ndarray = None, reuse: bool = False):
+        return self._execute(self._plan.min, x, out, reuse)
+
+    def max(self, x, out: np.ndarray = None, reuse: bool = False):
+        return self._execute(self._plan.max, x, out, reuse)
+
+    def mean(self, x, out: np.ndarray = None, reuse: bool = False):
+        return self._execute(self._plan.mean, x, out, reuse)
+
+    def median(self, x, out: np.ndarray = None, reuse: bool = False):
+        return self._execute(self._plan.median, x, out, reuse)
+
+    def sum(self, x, out: np.ndarray = None, reuse: bool = False):
+        return self._execute(self._plan.sum, x, out, reuse)
+
+    def count(self, x, out: np.ndarray = None, reuse: bool = False):
+        """The number of the nonzero values in each window."""
+        return self._execute(self._plan.count, x, out, reuse)
+
+
+def _rolling(op: str, x: Union[csr_matrix, csc_matrix], window: int,
+             axis: int):
+    """A single run of a plan, the result owns writable index arrays."""
+    result = getattr(RollingPlan(x, window, axis), op)(x)
+    result.indices = result.indices.copy()
+    result.indptr = result.indptr.copy()
+    return result
 
 
 def rolling_min(x: Union[csr_matrix, csc_matrix], window: int, axis: int):
-    return rolling(_sparse.rolling_min_csr, x, window, axis)
+    return _rolling('min', x, window, axis)
 
 
 def rolling_max(x: Union[csr_matrix, csc_matrix], window: int, axis: int):
-    return rolling(_sparse.rolling_max_csr, x, window, axis)
+    return _rolling('max', x, window, axis)
 
 
 def rolling_mean(x: Union[csr_matrix, csc_matrix], window: int, axis: int):
-    return rolling(_sparse.rolling_mean_csr, x, window, axis)
+    return _rolling('mean', x, window, axis)
 
 
 def rolling_median(x: Union[csr_matrix, csc_matrix], window: int, axis: int):
-    return rolling(_sparse.rolling_median_csr, x, window, axis)
+    return _rolling('median', x, window, axis)
+
+
+def rolling_sum(x: Union[csr_matrix, csc_matrix], window: int, axis: int):
+    return _rolling('sum', x, window, axis)
+
+
+def rolling_count(x: Union[csr_matrix, csc_matrix], window: int, axis: int):
+    return _rolling('count', x, window, axis)
+
+
+def rolling_windows(x: Union[csr_matrix, csc_matrix], windows: Sequence[int],
+                    stat: str, axis: int, n_threads: int = 0
+                    ) -> List[Union[csr_matrix, csc_matrix]]:
+    """A rolling statistic for several window sizes in one pass.
+
+    Each row (or column when rolling along the rows) is read once and its
+    prefix sums or a sparse table of its extrema answer the windows of all
+    sizes, so e.g. tuning a window over a grid costs about a single run.
+
+    Args:
+        x (Union[csr_matrix, csc_matrix]): A matrix to filter.
+        windows (Sequence[int]): Sizes of the rolling windows.
+        stat (str): Either 'min', 'max', 'mean', 'sum' or 'count'.
+        axis (int): An axis to roll along.
+        n_threads (int): A number of threads, 0 means all hardware threads.
+
+    Returns:
+        List[Union[csr_matrix, csc_matrix]]: A result for each window, equal to
+        the one of the corresponding single window operation.
+    """
+    if stat not in ('min', 'max', 'mean', 'sum', 'count'):
+        raise ValueError('Unsupported rolling statistic "{}"'.format(stat))
+    if any(window < 1 for window in windows):
+        raise ValueError('Window sizes must be positive')
+
+    x = x.tocsr() if axis else x.tocsc()
+    canonicalize(x)
+    if x.dtype not in (np.float32, np.float64):
+        x = x.astype(np.float64)
+
+    minor_size = x.shape[1] if axis else x.shape[0]
+    index_type = _output_index_type(x, max(windows, default=1))
+    windows = np.asarray(windows, dtype=index_type)
+
+    pointers = np.empty((windows.size, x.indptr.size), dtype=index_type)
+    size = _sparse.rolling_windows_alloc_csr(x.indptr, x.indices, windows,
+                                             pointers.ravel(), minor_size)
+    data = np.empty(size, dtype=x.data.dtype)
+    indices = np.empty(size, dtype=index_type)
+
+    kernel = getattr(_sparse, 'rolling_windows_{}_csr'.format(stat))
+    kernel(x.indptr, x.indices, x.data, windows, pointers.ravel(), indices,
+           data, minor_size, n_threads)
+
+    cls = csr_matrix if axis else csc_matrix
+    return [cls((data[rows[0]:rows[-1]], indices[rows[0]:rows[-1]],
+                 rows - rows[0]), x.shape, copy=False)
+            for rows in pointers]
+
+
+def rolling_median_approx(x: Union[csr_matrix, csc_matrix], window: int,
+                          axis: int, eps: float = 0.01):
+    """A rolling median with a bounded error, for large windows.
+
+    Each window is counted into a histogram of `ceil(1 / eps)` buckets spanning
+    the values of its row (or column when rolling along the rows) and zero,
+    instead of being sorted. So every value differs from the exact rolling
+    median by at most `eps` times that range, runs of zeros stay exact and a
+    window costs O(window + 1 / eps) regardless of its size.
+
+    Args:
+        x (Union[csr_matrix, csc_matrix]): A matrix to filter.
+        window (int): A size of the rolling window.
+        axis (int): An axis to roll along.
+        eps (float): A bound of the error relative to the range, in (0, 1].
+
+    Returns:
+        Union[csr_matrix, csc_matrix]: A result with the structure of
+        :func:`rolling_median`.
+    """
+    if not 0 < eps <= 1:
+        raise ValueError('eps must be in (0, 1], got {}'.format(eps))
+
+    x = x.tocsr() if axis else x.tocsc()
+    canonicalize(x)
+    if x.dtype not in (np.float32, np.float64):
+        x = x.astype(np.float64)
+
+    minor_size = x.shape[1] if axis else x.shape[0]
+    index_type = _output_index_type(x, window)
+
+    pointers = np.empty(x.indptr.shape, dtype=index_type)
+    size = _sparse.rolling_alloc_csr(x.indptr, x.indices, pointers, minor_size,
+                                     window)
+    data = np.empty(size, dtype=x.data.dtype)
+    indices = np.empty(size, dtype=index_type)
+
+    _sparse.rolling_median_approx_csr(x.indptr, x.indices, x.data, indices,
+                                      data, minor_size, window, eps)
+
+    cls = csr_matrix if axis else csc_matrix
+    return cls((data, indices, pointers), x.shape, copy=False)
 
 
 def max_clip_spmat_plus_dvec(a_mat: Union[csr_matrix, csc_matrix],
@@ -83,15 +292,73 @@ def max_clip_spmat_plus_dvec(a_mat: Union[csr_matrix, csc_matrix],
                                                     c_vec)
 
 
-def savgol_filter(x: Union[csr_matrix, csc_matrix], window: int, degree: int,
-                  axis: int):
+def clip(x: Union[csr_matrix, csc_matrix], lower: float = 0,
+         upper: float = np.inf, axis: int = 0):
+    """Clip the values into `[lower, upper]` and drop the resulting zeros.
+
+    Both happen in a single native pass over a canonical copy of the matrix
+    laid out along `axis` (CSC for 0, CSR for 1). The implicit zeros are kept,
+    so the range must contain zero.
+    """
+    if not lower <= 0 <= upper:
+        raise ValueError('The clipping range must contain zero!')
+
+    x = x.tocsr(copy=True) if axis else x.tocsc(copy=True)
+    canonicalize(x)
+    if x.dtype not in (np.float32, np.float64):
+        x = x.astype(np.float64)
+
+    size = _sparse.clip_prune_csr(x.indptr, x.indices, x.data, lower, upper)
+    cls = csr_matrix if axis else csc_matrix
+    return cls((x.data[:size], x.indices[:size], x.indptr), x.shape,
+               copy=False)
+
+
+def subtract_clip(a: Union[csr_matrix, csc_matrix],
+                  b: Union[csr_matrix, csc_matrix], lower: float = 0,
+                  upper: float = np.inf, axis: int = 0):
+    """Clip the difference `a - b` into `[lower, upper]`, dropping the zeros.
+
+    The same as `clip(a - b, lower, upper, axis)`, but a single native pass
+    merges the operands laid out along `axis` (CSC for 0, CSR for 1) without
+    forming the difference.
+    """
+    if not lower <= 0 <= upper:
+        raise ValueError('The clipping range must contain zero!')
+    if a.shape != b.shape:
+        raise ValueError('Shapes {} and {} do not match'.format(a.shape,
+                                                                b.shape))
+
+    dtype = np.result_type(a.dtype, b.dtype, np.float32)
+    if dtype not in (np.float32, np.float64):
+        dtype = np.float64
+    a, b = [canonicalize(x.tocsr(copy=True) if axis else x.tocsc(copy=True))
+            for x in (a, b)]
+    needs_64bit = max(a.nnz + b.nnz, *a.shape) > np.iinfo(np.int32).max
+    index_type = np.int64 if needs_64bit else np.int32
+    a_arrays, b_arrays = [
+        (x.indptr.astype(index_type, copy=False),
+         x.indices.astype(index_type, copy=False),
+         x.data.astype(dtype, copy=False)) for x in (a, b)]
+
+    indptr = np.empty(a.indptr.shape, dtype=index_type)
+    indices = np.empty(a.nnz + b.nnz, dtype=index_type)
+    data = np.empty(a.nnz + b.nnz, dtype=dtype)
+    size = _sparse.subtract_clip_csr(*a_arrays, *b_arrays, indptr, indices,
+                                     data, lower, upper)
+    cls = csr_matrix if axis else csc_matrix
+    return cls((data[:size], indices[:size], indptr), a.shape, copy=False)
+
+
+def convolve(x: Union[csr_matrix, csc_matrix], coeffs: np.ndarray,
+             axis: int):
     x = x.tocsr() if axis else x.tocsc()
-    x.sum_duplicates()
+    canonicalize(x)
 
+    window = coeffs.shape[0]
     minor_size = x.shape[1] if axis else x.shape[0]
 
-    needs_64bit = min(np.prod(x.shape), x.nnz * window) > np.iinfo(np.int32).max
-    index_type = np.int64 if needs_64bit else x.indptr.dtype
+    index_type = _output_index_type(x, window)
 
     pointers = np.empty(x.indptr.shape, dtype=index_type)
     size = _sparse.rolling_alloc_csr(x.indptr, x.indices, pointers, minor_size,
@@ -99,8 +366,7 @@ def savgol_filter(x: Union[csr_matrix, csc_matrix], window: int, degree: int,
     data = np.zeros(size, dtype=x.data.dtype)
     indices = np.zeros(size, dtype=index_type)
 
-    from scipy.signal import savgol_coeffs
-    coeffs = savgol_coeffs(window, degree)
+    coeffs = coeffs.astype(x.data.dtype, copy=False)
     _sparse.convolve_csr_dv(x.indptr, x.indices, x.data, coeffs, indices, data,
                             minor_size)
 
@@ -110,40 +376,184 @@ def savgol_filter(x: Union[csr_matrix, csc_matrix], window: int, degree: int,
         return csc_matrix((data, indices, pointers), x.shape)
 
 
+def convolve_many(x: Union[csr_matrix, csc_matrix], coeffs: np.ndarray,
+                  axis: int) -> List[Union[csr_matrix, csc_matrix]]:
+    """Convolve a matrix with several kernels of the same size in one pass.
+
+    The input is read once and the output positions, which do not depend on
+    the coefficients, are computed once for all the kernels.
+
+    Args:
+        x (Union[csr_matrix, csc_matrix]): A matrix to convolve.
+        coeffs (numpy.ndarray): A (kernels x window) array of coefficients.
+        axis (int): An axis to convolve along.
+
+    Returns:
+        List[Union[csr_matrix, csc_matrix]]: A result for each kernel.
+    """
+    x = x.tocsr() if axis else x.tocsc()
+    canonicalize(x)
+
+    coeffs = np.ascontiguousarray(np.atleast_2d(coeffs), dtype=x.data.dtype)
+    n_outputs, window = coeffs.shape
+    minor_size = x.shape[1] if axis else x.shape[0]
+    index_type = _output_index_type(x, window)
+
+    pointers = np.empty(x.indptr.shape, dtype=index_type)
+    size = _sparse.rolling_alloc_csr(x.indptr, x.indices, pointers, minor_size,
+                                     window)
+    data = np.zeros((n_outputs, size), dtype=x.data.dtype)
+    indices = np.zeros(size, dtype=index_type)
+
+    _sparse.convolve_csr_dm(x.indptr, x.indices, x.data, coeffs.ravel(),
+                            n_outputs, indices, data.ravel(), minor_size)
+
+    cls = csr_matrix if axis else csc_matrix
+    return [cls((values, indices, pointers), x.shape, copy=False)
+            for values in data]
+
+
+def savgol_filter(x: Union[csr_matrix, csc_matrix], window: int, degree: int,
+                  axis: int):
+    from scipy.signal import savgol_coeffs
+    return convolve(x, savgol_coeffs(window, degree), axis)
+
+
+def savgol_filters(x: Union[csr_matrix, csc_matrix], window: int, degree: int,
+                   derivs: Sequence[int], axis: int, delta: float = 1.0):
+    """Savitzky-Golay smoothing and derivatives computed in one pass.
+
+    Args:
+        x (Union[csr_matrix, csc_matrix]): A matrix to filter.
+        window (int): A length of the filter window.
+        degree (int): A degree of the fitted polynomial.
+        derivs (Sequence[int]): Orders of the derivatives, 0 is the smoothing.
+        axis (int): An axis to filter along.
+        delta (float): A spacing of the samples, used for the derivatives.
+
+    Returns:
+        List[Union[csr_matrix, csc_matrix]]: A result for each order in
+        `derivs`, all with the same sparsity pattern.
+    """
+    from scipy.signal import savgol_coeffs
+    coeffs = np.array([savgol_coeffs(window, degree, deriv=d, delta=delta)
+                       for d in derivs])
+    return convolve_many(x, coeffs, axis)
+
+
+def matched_filter(x: Union[csr_matrix, csc_matrix], peak_width: float,
+                   axis: int):
+    from spectre.dense.deconvolve import gaussian_kernel
+    coeffs = gaussian_kernel(peak_width)
+    return convolve(x, coeffs / coeffs.sum(), axis)
+
+
+Features = namedtuple('Features', ['mz', 'rt', 'height', 'prominence', 'area',
+                                   'width'])
+
+
+def find_peaks(xic: Xic, peak_width: float, prominence: float = 0,
+               min_width: float = 0, n_threads: int = 0) -> Features:
+    """Detect chromatographic peaks in each m/z column of a sparse XIC.
+
+    The columns are smoothed by a gaussian matched filter of the expected peak
+    width, then local maxima are searched only within the runs of nonzero
+    values, so the matrix is never densified.
+
+    Args:
+        xic (Xic): A preprocessed Spectre project.
+        peak_width (float): An expected peak width in scans.
+        prominence (float): A minimal prominence of reported peaks.
+        min_width (float): A minimal width at half prominence in scans.
+        n_threads (int): A number of threads, 0 means all hardware threads.
+
+    Returns:
+        Features: A feature table with one entry per peak, where `rt` is the
+        retention time of the apex, `width` the width at half prominence in
+        retention time units and `area` the area between the peak bases.
+    """
+    data = matched_filter(xic.data, peak_width, axis=0)
+    n_rows = data.shape[0]
+
+    pointers = np.empty(data.indptr.shape, dtype=data.indptr.dtype)
+    size = _sparse.peaks_alloc_csr(data.indptr, data.indices, data.data,
+                                   pointers, n_rows, prominence, min_width,
+                                   n_threads)
+
+    apex = np.empty(size, dtype=data.indptr.dtype)
+    height, prom, area, left, right = (np.empty(size, dtype=data.dtype)
+                                       for _ in range(5))
+    _sparse.peaks_csr(data.indptr, data.indices, data.data, pointers, apex,
+                      height, prom, area, left, right, n_rows, prominence,
+                      min_width, n_threads)
+
+    scans = np.arange(n_rows)
+    spacing = np.gradient(xic.rt_scales) if n_rows > 1 else np.ones(n_rows)
+    columns = np.repeat(np.arange(data.shape[1]), np.diff(pointers))
+
+    return Features(mz=xic.mz_scales[columns],
+                    rt=xic.rt_scales[apex],
+                    height=height,
+                    prominence=prom,
+                    area=area * spacing[apex],
+                    width=(np.interp(right, scans, xic.rt_scales) -
+                           np.interp(left, scans, xic.rt_scales)))
+
+
 def remove_noise(data: Union[csr_matrix, csc_matrix], peak_width: float):
     peak_width = int(round(peak_width))
     window = peak_width if (peak_width % 2) else (peak_width + 1)
     degree = min(3, window - 1)
 
-    if degree > 0:
-        data = savgol_filter(data, window, degree, axis=0)
+    with span('remove_noise'):
+        if degree > 0:
+            data = savgol_filter(data, window, degree, axis=0)
+        return clip(data, 0, axis=0)
 
-    # IDEA: implement clipping of items <0 and then pruning of an array in
-    # 1-pass algorithm (currently at least 3 pass)
-    data[data < 0] = 0
-    data.eliminate_zeros()
-    data.sum_duplicates()
-    return data
 
+def estimate_baseline(data: Union[csr_matrix, csc_matrix], k: int,
+                      median_eps: Optional[float] = None):
+    """The baseline of every m/z column from rolling statistics along RT.
 
-def remove_baseline(data: Union[csr_matrix, csc_matrix], k: int):
+    A given `median_eps` opts in to :func:`rolling_median_approx` with that
+    error bound, which is much faster than the exact median for large `k`.
+    """
     k_med = min(k, data.shape[0] - 1)
     k_med = k_med if (k_med % 2) else (k_med - 1)
 
-    data_min = rolling_min(data, window=k, axis=0)
+    with span('estimate_baseline'):
+        with span('estimate_baseline.tocsc'):
+            data = canonicalize(data.tocsc())
+
+        # the minimum and the median share one output structure unless the
+        # median window had to be shortened
+        plan = RollingPlan(data, window=k, axis=0)
+        data_min = plan.min(data)
+
+        if median_eps is not None:
+            data_base = rolling_median_approx(data, k_med, axis=0,
+                                              eps=median_eps)
+        else:
+            if k_med != k:
+                plan = RollingPlan(data, window=k_med, axis=0)
+            data_base = plan.median(data)
+        max_clip_spmat_plus_dvec(data_base, data_min, std(data_min, axis=0))
+        return rolling_mean(data_base, window=k, axis=0)
 
-    data_base = rolling_median(data, window=k_med, axis=0)
-    max_clip_spmat_plus_dvec(data_base, data_min, std(data_min, axis=0))
-    data_base = rolling_mean(data_base, window=k, axis=0)
 
-    data = data - data_base
-    data[data < 0] = 0
-    data.eliminate_zeros()
-    data.sum_duplicates()
-    return data
+def remove_baseline(data: Union[csr_matrix, csc_matrix], k: int,
+                    median_eps: Optional[float] = None):
+    with span('remove_baseline'):
+        data = data.tocsc()
+        baseline = estimate_baseline(data, k, median_eps)
+        with span('remove_baseline.subtract'):
+            data = data - baseline
+        return clip(data, 0, axis=0)
 
 
 def preprocess(xic: Xic, peak_width: float) -> Xic:
-    xic.data = remove_noise(xic.data, peak_width)
-    xic.data = remove_baseline(xic.data.tocoo(copy=False), int(10 * peak_width))
+    with span('preprocess'):
+        xic.data = remove_noise(xic.data, peak_width)
+        xic.data = remove_baseline(xic.data.tocoo(copy=False),
+                                   int(10 * peak_width))
     return xic
@@ -18,7 +18,7 @@ def std(x: SparseMatrix, axis: int) -> np.ndarray:
 
     for i in range(x.shape[1 - axis]):
         xa = x.getcol(i) if axis == 0 else x.getrow(i)
-        y[i] = np.std(np.squeeze(xa.toarray()))
+        y[i] = np.std(np.ravel(xa.toarray()))
     return y
 
 
@@ -34,7 +34,7 @@ def _apply(x: SparseMatrix, axis: int, func: Callable) -> SparseMatrix:
 
     for i in range(n if axis == 0 else m):
         xa = x.getcol(i) if axis == 0 else x.getrow(i)
-        xa = func(np.squeeze(xa.toarray()))
+        xa = func(np.ravel(xa.toarray()))
         xi = np.flatnonzero(xa)
         xn = max(xn, xa.shape[0])
 
@@ -71,10 +71,11 @@ def rolling_median(x: SparseMatrix, k: int, axis: int = 0,
     return _apply(x, axis, lambda a: rolling_median(a, k=k, axis=0, mode=mode))
 
 
-def savgol_filter(x: SparseMatrix, window: int, degree: int,
-                  axis: int) -> SparseMatrix:
+def savgol_filter(x: SparseMatrix, window: int, degree: int, axis: int,
+                  mode: str = 'interp') -> SparseMatrix:
     from scipy.signal import savgol_filter
-    return _apply(x, axis, lambda a: savgol_filter(a, window, degree))
+    return _apply(x, axis,
+                  lambda a: savgol_filter(a, window, degree, mode=mode))
 
 
 def remove_noise(data: SparseMatrix, peak_width: float) -> SparseMatrix:
@@ -59,7 +59,8 @@ def rolling_min(a: coo_matrix, k: Tuple[int, ...],
     order = np.lexsort((ci, cj))
     ci, cj, cx = ci[order], cj[order], cx[order]
 
-    unique = np.r_[True, (ci[1:] != ci[:-1]) | (cj[1:] != cj[:-1])]
+    unique = np.ones(ci.shape, dtype=bool)
+    unique[1:] = (ci[1:] != ci[:-1]) | (cj[1:] != cj[:-1])
     indices = np.flatnonzero(unique)
     counts = np.add.reduceat(np.broadcast_to(1, unique.shape), indices)
 
@@ -97,12 +98,13 @@ def rolling_mean(a: coo_matrix, k: Tuple[int, ...],
     order = np.lexsort((ci, cj))
     ci, cj, cx = ci[order], cj[order], cx[order]
 
-    unique = np.r_[True, (ci[1:] != ci[:-1]) | (cj[1:] != cj[:-1])]
+    unique = np.ones(ci.shape, dtype=bool)
+    unique[1:] = (ci[1:] != ci[:-1]) | (cj[1:] != cj[:-1])
     indices = np.flatnonzero(unique)
-    counts = np.add.reduceat(np.broadcast_to(1, unique.shape), indices)
 
+    # the implicit zeros of a window count too
     ci, cj, cx = ci[unique], cj[unique], np.add.reduceat(cx, indices)
-    np.divide(cx, counts, out=cx)
+    np.divide(cx, np.prod(k), out=cx)
 
     if mode == 'full':
         return coo_matrix((cx, (ci, cj)), np.add(a.shape, k) - 1)
@@ -132,10 +134,11 @@ def rolling_median(a: coo_matrix, k: Tuple[int, ...],
     cj = np.ravel(np.sum(np.meshgrid(aj, bj), axis=0))
     cx = np.tile(ax, np.prod(k))
 
-    order = np.lexsort((ci, cj, cx))
+    order = np.lexsort((cx, ci, cj))
     ci, cj, cx = ci[order], cj[order], cx[order]
 
-    unique = np.r_[True, (ci[1:] != ci[:-1]) | (cj[1:] != cj[:-1])]
+    unique = np.ones(ci.shape, dtype=bool)
+    unique[1:] = (ci[1:] != ci[:-1]) | (cj[1:] != cj[:-1])
     indices = np.flatnonzero(unique)
 
     n_negative = np.add.reduceat(cx < 0, indices)
@@ -148,7 +151,7 @@ def rolling_median(a: coo_matrix, k: Tuple[int, ...],
     result = np.zeros(np.sum(unique), cx.dtype)
     result[neg_mask] = cx[indices[neg_mask] + mid]
     result[pos_mask] = cx[
-        (indices + mid - np.prod(k) - n_negative - n_positive)[pos_mask]]
+        (indices + mid - np.prod(k) + n_negative + n_positive)[pos_mask]]
 
     ci, cj, cx = ci[unique], cj[unique], result
 
@@ -182,14 +185,16 @@ def std(a: coo_matrix, axis: int) -> coo_matrix:
     (major, minor), data = ((a.row, a.col) if axis else (a.col, a.row)), a.data
     major, minor, data = np.copy(major), np.copy(minor), np.copy(data)
 
-    order = np.lexsort((major, minor))
+    order = np.argsort(major, kind='stable')
     major, data = major[order], data[order]
 
-    unique = np.flatnonzero(np.r_[True, major[1:] != major[:-1]])
-    major, minor = major[unique], np.zeros_like(minor)
+    unique = np.flatnonzero(np.r_[major.size > 0, major[1:] != major[:-1]])
+    major = major[unique]
+    minor = np.zeros_like(major)
 
     mean = np.add.reduceat(data, unique) / a.shape[axis]
     var = (np.add.reduceat(data * data, unique) / a.shape[axis]) - (mean * mean)
+    np.maximum(var, 0, out=var)
 
     coords = (major, minor) if axis else (minor, major)
     shape = (a.shape[0], 1) if axis else (1, a.shape[1])
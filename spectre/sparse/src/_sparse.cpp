@@ -1,15 +1,516 @@
+#include "align.h"
 #include "canonical.h"
-#include "convolve.h"
-#include "maxclip.h"
+#include "core.h"
+#include "dispatch.h"
+#include "hybrid.h"
+#include "kernels.h"
+#include "nmf.h"
+#include "peaks.h"
+#include "plan.h"
 #include "python.h"
-#include "rolling.h"
+#include "query.h"
 #include "stdev.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdint>
 #include <pybind11/pybind11.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
 
 using i32 = npy_int32;
 using i64 = npy_int64;
-using f32 = npy_float32;
-using f64 = npy_float64;
+
+using pybind11::handle;
+using namespace pybind11::literals;
+
+using rolling_plan_t =
+    std::variant<spectre::rolling_plan<i32>, spectre::rolling_plan<i64>>;
+
+// The kernels of the level selected when the module is imported
+spectre::kernel_tables const *active_kernels = nullptr;
+
+template <typename I, typename J>
+pybind11::type_error narrowing_error(char const *const name)
+{
+  return pybind11::type_error{std::string{"the indices of dtype "} +
+                              spectre::py_dtype<I>::name +
+                              " do not fit the output '" + name +
+                              "' of dtype " + spectre::py_dtype<J>::name};
+}
+
+// Throws unless `rows` are the ascending row offsets, from 0, into an array
+// of `size` indices, so no row of a kernel reaches past its end
+template <typename I>
+void check_rows(spectre::span<I> const rows, std::size_t const size,
+                char const *const name)
+{
+  if (rows.empty() || rows.front() != 0 ||
+      static_cast<std::size_t>(rows.back()) > size ||
+      !std::is_sorted(rows.begin(), rows.end()))
+    throw pybind11::value_error(std::string{name} +
+                                ": expected ascending row offsets from 0 "
+                                "within the indices");
+}
+
+// Throws unless the arrays are a CSR matrix, `names` lists them for the error
+template <typename I, typename D>
+void check_csr(spectre::span<I> const rows, spectre::span<I> const cols,
+               spectre::span<D> const data, char const *const names)
+{
+  if (rows.empty() || rows.front() != 0 || cols.size() != data.size() ||
+      static_cast<std::size_t>(rows.back()) > cols.size() ||
+      !std::is_sorted(rows.begin(), rows.end()))
+    throw pybind11::value_error(std::string{names} +
+                                ": expected a CSR matrix");
+}
+
+// Throws unless the caller-provided output `out` has the `size` computed by
+// its allocation step, the kernels write the whole of it and no more
+template <typename T>
+void check_size(spectre::span<T> const out, std::size_t const size,
+                char const *const name)
+{
+  if (out.size() != size)
+    throw pybind11::value_error(std::string{name} + ": expected " +
+                                std::to_string(size) + " elements, got " +
+                                std::to_string(out.size()));
+}
+
+auto rolling_binding(spectre::rolling_op const op, char const *const name)
+{
+  using namespace spectre;
+
+  return [op, name](handle A_rows, handle A_cols, handle A_data, handle B_cols,
+            handle B_data, std::int64_t A_n_cols, std::int64_t window,
+            bool copy) {
+    py_args args{copy};
+    dispatch(
+        [&](auto i, auto j, auto d) {
+          using I = type_of<decltype(i)>;
+          using J = type_of<decltype(j)>;
+          using D = type_of<decltype(d)>;
+
+          if constexpr (!widens_v<I, J>)
+            throw narrowing_error<I, J>("B_cols");
+          else {
+            auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+            auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+            auto const A_data_ = args.get<D const>(A_data, "A_data");
+            auto const B_cols_ = args.get<J>(B_cols, "B_cols");
+            auto const B_data_ = args.get<D>(B_data, "B_data");
+
+            check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+            auto const size = static_cast<std::size_t>(
+                rolling_size_csr(A_rows_, A_cols_, static_cast<I>(A_n_cols),
+                                 static_cast<J>(window)));
+            check_size(B_cols_, size, "B_cols");
+            check_size(B_data_, size, "B_data");
+
+            pybind11::gil_scoped_release release;
+            trace::scope span{name, A_data_.size()};
+            get_kernels<I, J, D>(*active_kernels).rolling[op](
+                A_rows_, A_cols_, A_data_, B_cols_, B_data_,
+                static_cast<I>(A_n_cols), static_cast<J>(window));
+            span.output(B_data_.size(), trace::bytes_of(B_cols_, B_data_));
+          }
+        },
+        dtype_of<index_types>(A_rows, "A_rows"),
+        dtype_of<pointer_types>(B_cols, "B_cols"),
+        dtype_of<value_types>(A_data, "A_data"));
+  };
+}
+
+auto windows_binding(spectre::rolling_op const op, char const *const name)
+{
+  using namespace spectre;
+
+  return [op, name](handle A_rows, handle A_cols, handle A_data, handle windows,
+            handle B_rows, handle B_cols, handle B_data, std::int64_t A_n_cols,
+            unsigned n_threads, bool copy) {
+    py_args args{copy};
+    dispatch(
+        [&](auto i, auto j, auto d) {
+          using I = type_of<decltype(i)>;
+          using J = type_of<decltype(j)>;
+          using D = type_of<decltype(d)>;
+
+          if constexpr (!widens_v<I, J>)
+            throw narrowing_error<I, J>("B_cols");
+          else {
+            auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+            auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+            auto const A_data_ = args.get<D const>(A_data, "A_data");
+            auto const windows_ = args.get<J const>(windows, "windows");
+            auto const B_rows_ = args.get<J const>(B_rows, "B_rows");
+            auto const B_cols_ = args.get<J>(B_cols, "B_cols");
+            auto const B_data_ = args.get<D>(B_data, "B_data");
+
+            check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+
+            pybind11::gil_scoped_release release;
+            trace::scope span{name, A_data_.size()};
+            rolling_windows_csr(
+                get_kernels<I, J, D>(*active_kernels).rolling_windows[op],
+                A_rows_, A_cols_, A_data_, windows_, B_rows_, B_cols_, B_data_,
+                static_cast<I>(A_n_cols), n_threads);
+            span.output(B_data_.size(), trace::bytes_of(B_cols_, B_data_));
+          }
+        },
+        dtype_of<index_types>(A_rows, "A_rows"),
+        dtype_of<pointer_types>(B_cols, "B_cols"),
+        dtype_of<value_types>(A_data, "A_data"));
+  };
+}
+
+auto scan_binding(spectre::rolling_op const op, char const *const name)
+{
+  using namespace spectre;
+
+  return [op, name](handle A_rows, handle A_cols, handle A_data, handle B_cols,
+            handle B_data, bool copy) {
+    py_args args{copy};
+    return dispatch(
+        [&](auto i, auto d) -> std::int64_t {
+          using I = type_of<decltype(i)>;
+          using D = type_of<decltype(d)>;
+          auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+          auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+          auto const A_data_ = args.get<D const>(A_data, "A_data");
+          auto const B_cols_ = args.get<I>(B_cols, "B_cols");
+          auto const B_data_ = args.get<D>(B_data, "B_data");
+
+          if (A_rows_.size() < 2)
+            throw pybind11::value_error("A_rows: expected at least one row");
+          check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+          if (B_cols_.size() < static_cast<std::size_t>(A_rows_.back() -
+                                                        A_rows_.front()) ||
+              B_data_.size() < B_cols_.size())
+            throw pybind11::value_error(
+                "B_cols, B_data: expected room for every nonzero of A");
+
+          pybind11::gil_scoped_release release;
+          trace::scope span{name, A_data_.size()};
+          auto const size = get_kernels<I, i64, D>(*active_kernels)
+                                .rolling_scan[op](A_rows_, A_cols_, A_data_,
+                                                  B_cols_, B_data_);
+          span.output(static_cast<std::size_t>(size),
+                      trace::bytes_of(B_cols_, B_data_));
+          return size;
+        },
+        dtype_of<index_types>(A_rows, "A_rows"),
+        dtype_of<value_types>(A_data, "A_data"));
+  };
+}
+
+auto plan_binding(spectre::rolling_op const op, char const *const name)
+{
+  using namespace spectre;
+
+  return [op, name](rolling_plan_t const &self, handle A_rows, handle A_cols,
+            handle A_data, handle B_data, bool copy) {
+    py_args args{copy};
+    std::visit(
+        [&](auto const &plan) {
+          using J = typename std::decay_t<decltype(plan)>::index_type;
+
+          dispatch(
+              [&](auto i, auto d) {
+                using I = type_of<decltype(i)>;
+                using D = type_of<decltype(d)>;
+
+                if constexpr (!widens_v<I, J>)
+                  throw narrowing_error<I, J>("indices");
+                else {
+                  auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+                  auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+                  auto const A_data_ = args.get<D const>(A_data, "A_data");
+                  auto const B_data_ = args.get<D>(B_data, "B_data");
+                  check_csr(A_rows_, A_cols_, A_data_,
+                            "A_rows, A_cols, A_data");
+
+                  pybind11::gil_scoped_release release;
+                  trace::scope span{name, A_data_.size()};
+                  auto const &table = get_kernels<I, J, D>(*active_kernels);
+                  plan.execute(table.rolling_rows[op], A_rows_, A_cols_,
+                               A_data_, B_data_);
+                  span.output(B_data_.size(), trace::bytes_of(B_data_));
+                }
+              },
+              dtype_of<index_types>(A_rows, "A_rows"),
+              dtype_of<value_types>(A_data, "A_data"));
+        },
+        self);
+  };
+}
+
+auto hybrid_binding(spectre::rolling_op const op, char const *const name)
+{
+  using namespace spectre;
+
+  return [op, name](handle A_rows, handle A_cols, handle A_data,
+                    handle A_dense, handle dense_majors, handle B_rows,
+                    handle B_cols, handle B_data, handle B_dense,
+                    std::int64_t n_minor, std::int64_t window,
+                    unsigned n_threads, bool copy) {
+    py_args args{copy};
+    dispatch(
+        [&](auto i, auto j, auto d) {
+          using I = type_of<decltype(i)>;
+          using J = type_of<decltype(j)>;
+          using D = type_of<decltype(d)>;
+
+          if constexpr (!widens_v<I, J>)
+            throw narrowing_error<I, J>("B_cols");
+          else {
+            hybrid_span<I const, D const> const A_{
+                args.get<I const>(A_rows, "A_rows"),
+                args.get<I const>(A_cols, "A_cols"),
+                args.get<D const>(A_data, "A_data"),
+                args.get<D const>(A_dense, "A_dense")};
+            hybrid_span<J, D> const B_{args.get<J>(B_rows, "B_rows"),
+                                       args.get<J>(B_cols, "B_cols"),
+                                       args.get<D>(B_data, "B_data"),
+                                       args.get<D>(B_dense, "B_dense")};
+            auto const dense_majors_ =
+                args.get<I const>(dense_majors, "dense_majors");
+
+            pybind11::gil_scoped_release release;
+            trace::scope span{name, A_.data.size() + A_.dense.size()};
+            rolling_hybrid(get_kernels<I, J, D>(*active_kernels), op, A_, B_,
+                           dense_majors_, static_cast<I>(n_minor),
+                           static_cast<J>(window), n_threads);
+            span.output(B_.data.size() + B_.dense.size(),
+                        trace::bytes_of(B_.indices, B_.data, B_.dense));
+          }
+        },
+        dtype_of<index_types>(A_rows, "A_rows"),
+        dtype_of<pointer_types>(B_cols, "B_cols"),
+        dtype_of<value_types>(A_data, "A_data"));
+  };
+}
+
+// The kernels of the hybrid matrices, whose dense majors are listed in
+// `dense_majors` and hold `n_minor` values each in the `*_dense` arrays
+void def_hybrid(pybind11::module &m)
+{
+  using namespace spectre;
+
+  auto const rolling_args = std::make_tuple(
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "A_dense"_a, "dense_majors"_a,
+      "B_rows"_a, "B_cols"_a, "B_data"_a, "B_dense"_a, "n_minor"_a,
+      "window"_a, "n_threads"_a = 0, "copy"_a = false);
+  auto def_rolling = [&](char const *const name, rolling_op const op) {
+    std::apply(
+        [&](auto const &...a) { m.def(name, hybrid_binding(op, name), a...); },
+        rolling_args);
+  };
+  def_rolling("rolling_min_hybrid", rolling_min);
+  def_rolling("rolling_max_hybrid", rolling_max);
+  def_rolling("rolling_mean_hybrid", rolling_mean);
+  def_rolling("rolling_median_hybrid", rolling_median);
+  def_rolling("rolling_sum_hybrid", rolling_sum);
+  def_rolling("rolling_count_hybrid", rolling_count);
+
+  m.def(
+      "convolve_hybrid",
+      [](handle A_rows, handle A_cols, handle A_data, handle A_dense,
+         handle dense_majors, handle coeffs, handle B_rows, handle B_cols,
+         handle B_data, handle B_dense, std::int64_t n_minor,
+         unsigned n_threads, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto j, auto d) {
+              using I = type_of<decltype(i)>;
+              using J = type_of<decltype(j)>;
+              using D = type_of<decltype(d)>;
+
+              if constexpr (!widens_v<I, J>)
+                throw narrowing_error<I, J>("B_cols");
+              else {
+                hybrid_span<I const, D const> const A_{
+                    args.get<I const>(A_rows, "A_rows"),
+                    args.get<I const>(A_cols, "A_cols"),
+                    args.get<D const>(A_data, "A_data"),
+                    args.get<D const>(A_dense, "A_dense")};
+                hybrid_span<J, D> const B_{args.get<J>(B_rows, "B_rows"),
+                                           args.get<J>(B_cols, "B_cols"),
+                                           args.get<D>(B_data, "B_data"),
+                                           args.get<D>(B_dense, "B_dense")};
+                auto const dense_majors_ =
+                    args.get<I const>(dense_majors, "dense_majors");
+                auto const coeffs_ = args.get<D const>(coeffs, "coeffs");
+                if (coeffs_.size() == 0)
+                  throw pybind11::value_error{"the coefficients must not be "
+                                              "empty"};
+
+                pybind11::gil_scoped_release release;
+                trace::scope span{"convolve_hybrid",
+                                  A_.data.size() + A_.dense.size()};
+                convolve_hybrid(get_kernels<I, J, D>(*active_kernels), A_,
+                                coeffs_, B_, dense_majors_,
+                                static_cast<I>(n_minor), n_threads);
+                span.output(B_.data.size() + B_.dense.size(),
+                            trace::bytes_of(B_.indices, B_.data, B_.dense));
+              }
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<pointer_types>(B_cols, "B_cols"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "A_dense"_a, "dense_majors"_a,
+      "coeffs"_a, "B_rows"_a, "B_cols"_a, "B_data"_a, "B_dense"_a,
+      "n_minor"_a, "n_threads"_a = 0, "copy"_a = false);
+
+  m.def(
+      "std_hybrid",
+      [](handle A_rows, handle A_cols, handle A_data, handle A_dense,
+         handle dense_majors, std::int64_t n_minor, handle result,
+         unsigned n_threads, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              hybrid_span<I const, D const> const A_{
+                  args.get<I const>(A_rows, "A_rows"),
+                  args.get<I const>(A_cols, "A_cols"),
+                  args.get<D const>(A_data, "A_data"),
+                  args.get<D const>(A_dense, "A_dense")};
+              auto const dense_majors_ =
+                  args.get<I const>(dense_majors, "dense_majors");
+              auto const result_ = args.get<D>(result, "result");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"std_hybrid",
+                                A_.data.size() + A_.dense.size()};
+              stdev_hybrid(get_kernels<I, i64, D>(*active_kernels), A_,
+                           dense_majors_, static_cast<I>(n_minor), result_,
+                           n_threads);
+              span.output(result_.size(), trace::bytes_of(result_));
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "A_dense"_a, "dense_majors"_a,
+      "n_minor"_a, "result"_a, "n_threads"_a = 0, "copy"_a = false);
+
+  m.def(
+      "maxclip_hybrid",
+      [](handle A_rows, handle A_cols, handle A_data, handle A_dense,
+         handle B_rows, handle B_cols, handle B_data, handle B_dense,
+         handle C_data, handle dense_majors, std::int64_t n_minor,
+         unsigned n_threads, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              hybrid_span<I const, D> const A_{
+                  args.get<I const>(A_rows, "A_rows"),
+                  args.get<I const>(A_cols, "A_cols"),
+                  args.get<D>(A_data, "A_data"),
+                  args.get<D>(A_dense, "A_dense")};
+              hybrid_span<I const, D const> const B_{
+                  args.get<I const>(B_rows, "B_rows"),
+                  args.get<I const>(B_cols, "B_cols"),
+                  args.get<D const>(B_data, "B_data"),
+                  args.get<D const>(B_dense, "B_dense")};
+              auto const C_data_ = args.get<D const>(C_data, "C_data");
+              auto const dense_majors_ =
+                  args.get<I const>(dense_majors, "dense_majors");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"maxclip_hybrid",
+                                A_.data.size() + A_.dense.size() +
+                                    B_.data.size() + B_.dense.size()};
+              maxclip_hybrid(get_kernels<I, i64, D>(*active_kernels), A_, B_,
+                             C_data_, dense_majors_, static_cast<I>(n_minor),
+                             n_threads);
+              span.output(A_.data.size() + A_.dense.size(), 0);
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "A_dense"_a, "B_rows"_a,
+      "B_cols"_a, "B_data"_a, "B_dense"_a, "C_data"_a, "dense_majors"_a,
+      "n_minor"_a, "n_threads"_a = 0, "copy"_a = false);
+}
+
+void def_rolling_plan(pybind11::module &m)
+{
+  using namespace spectre;
+
+  auto const plan_args = std::make_tuple("A_rows"_a, "A_cols"_a, "A_data"_a,
+                                         "B_data"_a, "copy"_a = false);
+
+  auto cls = pybind11::class_<rolling_plan_t>(m, "RollingPlan");
+  cls.def(pybind11::init([](handle A_rows, handle A_cols,
+                            std::int64_t A_n_cols, std::int64_t window,
+                            handle index_dtype, unsigned n_threads,
+                            bool copy) {
+            py_args args{copy};
+            return dispatch(
+                [&](auto i, auto j) -> rolling_plan_t {
+                  using I = type_of<decltype(i)>;
+                  using J = type_of<decltype(j)>;
+
+                  if constexpr (!widens_v<I, J>)
+                    throw narrowing_error<I, J>("indices");
+                  else {
+                    auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+                    auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+
+                    pybind11::gil_scoped_release release;
+                    trace::scope span{"RollingPlan", A_cols_.size()};
+                    rolling_plan<J> plan{A_rows_, A_cols_,
+                                         static_cast<I>(A_n_cols),
+                                         static_cast<J>(window), n_threads};
+                    span.output(plan.cols().size(),
+                                trace::bytes_of(plan.rows(), plan.cols()));
+                    return rolling_plan_t{std::move(plan)};
+                  }
+                },
+                dtype_of<index_types>(A_rows, "A_rows"),
+                dtype_from<pointer_types>(index_dtype, "index_dtype"));
+          }),
+          "A_rows"_a, "A_cols"_a, "A_n_cols"_a, "window"_a,
+          "index_dtype"_a = "int64", "n_threads"_a = 0, "copy"_a = false);
+
+  cls.def_property_readonly("indptr", [](pybind11::object const self) {
+    auto const view = [&](auto const &plan) {
+      return py_view(plan.rows(), self);
+    };
+    return std::visit(view, self.cast<rolling_plan_t const &>());
+  });
+  cls.def_property_readonly("indices", [](pybind11::object const self) {
+    auto const view = [&](auto const &plan) {
+      return py_view(plan.cols(), self);
+    };
+    return std::visit(view, self.cast<rolling_plan_t const &>());
+  });
+  cls.def_property_readonly("window", [](rolling_plan_t const &self) {
+    auto const window = [](auto const &plan) {
+      return static_cast<std::int64_t>(plan.window());
+    };
+    return std::visit(window, self);
+  });
+
+  auto def_kernel = [&](char const *const name, char const *const traced,
+                        rolling_op const op) {
+    std::apply(
+        [&](auto const &...a) { cls.def(name, plan_binding(op, traced), a...); },
+        plan_args);
+  };
+  def_kernel("min", "RollingPlan.min", rolling_min);
+  def_kernel("max", "RollingPlan.max", rolling_max);
+  def_kernel("mean", "RollingPlan.mean", rolling_mean);
+  def_kernel("median", "RollingPlan.median", rolling_median);
+  def_kernel("sum", "RollingPlan.sum", rolling_sum);
+  def_kernel("count", "RollingPlan.count", rolling_count);
+}
 
 PYBIND11_MODULE(_sparse, m)
 {
@@ -17,62 +518,846 @@ PYBIND11_MODULE(_sparse, m)
 
   spectre::import_numpy();
 
-  m.def("is_canonical_coo", is_canonical_coo<i32>);
-  m.def("is_canonical_coo", is_canonical_coo<i64>);
-  m.def("is_canonical_csr", is_canonical_csr<i32>);
-  m.def("is_canonical_csr", is_canonical_csr<i64>);
-
-  m.def("rolling_alloc_csr", rolling_alloc_csr<i32, i32>);
-  m.def("rolling_alloc_csr", rolling_alloc_csr<i32, i64>);
-  m.def("rolling_alloc_csr", rolling_alloc_csr<i64, i32>);
-  m.def("rolling_alloc_csr", rolling_alloc_csr<i64, i64>);
-
-  m.def("rolling_min_csr", rolling_csr<i32, i32, f32, min_kernel>);
-  m.def("rolling_min_csr", rolling_csr<i32, i32, f64, min_kernel>);
-  m.def("rolling_min_csr", rolling_csr<i32, i64, f32, min_kernel>);
-  m.def("rolling_min_csr", rolling_csr<i32, i64, f64, min_kernel>);
-  m.def("rolling_min_csr", rolling_csr<i64, i64, f32, min_kernel>);
-  m.def("rolling_min_csr", rolling_csr<i64, i64, f64, min_kernel>);
-
-  m.def("rolling_max_csr", rolling_csr<i32, i32, f32, max_kernel>);
-  m.def("rolling_max_csr", rolling_csr<i32, i32, f64, max_kernel>);
-  m.def("rolling_max_csr", rolling_csr<i32, i64, f32, max_kernel>);
-  m.def("rolling_max_csr", rolling_csr<i32, i64, f64, max_kernel>);
-  m.def("rolling_max_csr", rolling_csr<i64, i64, f32, max_kernel>);
-  m.def("rolling_max_csr", rolling_csr<i64, i64, f64, max_kernel>);
-
-  m.def("rolling_mean_csr", rolling_csr<i32, i32, f32, mean_kernel>);
-  m.def("rolling_mean_csr", rolling_csr<i32, i32, f64, mean_kernel>);
-  m.def("rolling_mean_csr", rolling_csr<i32, i64, f32, mean_kernel>);
-  m.def("rolling_mean_csr", rolling_csr<i32, i64, f64, mean_kernel>);
-  m.def("rolling_mean_csr", rolling_csr<i64, i64, f32, mean_kernel>);
-  m.def("rolling_mean_csr", rolling_csr<i64, i64, f64, mean_kernel>);
-
-  m.def("rolling_median_csr", rolling_csr<i32, i32, f32, median_kernel>);
-  m.def("rolling_median_csr", rolling_csr<i32, i32, f64, median_kernel>);
-  m.def("rolling_median_csr", rolling_csr<i32, i64, f32, median_kernel>);
-  m.def("rolling_median_csr", rolling_csr<i32, i64, f64, median_kernel>);
-  m.def("rolling_median_csr", rolling_csr<i64, i64, f32, median_kernel>);
-  m.def("rolling_median_csr", rolling_csr<i64, i64, f64, median_kernel>);
-
-  m.def("std_csr", stdev_csr<i32, f32>);
-  m.def("std_csr", stdev_csr<i32, f64>);
-  m.def("std_csr", stdev_csr<i64, f32>);
-  m.def("std_csr", stdev_csr<i64, f64>);
-
-  m.def("convolve_csr_dv", convolve_csr_dv<i32, i32, f32>);
-  m.def("convolve_csr_dv", convolve_csr_dv<i32, i32, f64>);
-  m.def("convolve_csr_dv", convolve_csr_dv<i32, i64, f32>);
-  m.def("convolve_csr_dv", convolve_csr_dv<i32, i64, f64>);
-  m.def("convolve_csr_dv", convolve_csr_dv<i64, i64, f32>);
-  m.def("convolve_csr_dv", convolve_csr_dv<i64, i64, f64>);
-
-  m.def("maxclip_csr_spmat_plus_dvec_nonnegative",
-        maxclip_csr_spmat_plus_dvec_nonnegative<i32, f32>);
-  m.def("maxclip_csr_spmat_plus_dvec_nonnegative",
-        maxclip_csr_spmat_plus_dvec_nonnegative<i32, f64>);
-  m.def("maxclip_csr_spmat_plus_dvec_nonnegative",
-        maxclip_csr_spmat_plus_dvec_nonnegative<i64, f32>);
-  m.def("maxclip_csr_spmat_plus_dvec_nonnegative",
-        maxclip_csr_spmat_plus_dvec_nonnegative<i64, f64>);
+  auto const &isa = spectre::select_isa();
+  active_kernels = &isa.kernels();
+  m.attr("isa") = isa.name;
+
+  m.def("trace_enable", &trace::enable, "enabled"_a);
+  m.def("trace_enabled", &trace::enabled);
+  m.def("trace_clock", &trace::now);
+  m.def("trace_drain", [] {
+    std::uint64_t dropped = 0;
+    auto const events = trace::drain(&dropped);
+
+    pybind11::list result;
+    for (auto const &e : events)
+      result.append(pybind11::make_tuple(e.name, e.begin, e.end, e.thread,
+                                         e.nnz_in, e.nnz_out, e.bytes,
+                                         e.n_threads, e.busy));
+    return pybind11::make_tuple(result, dropped);
+  });
+
+  m.def(
+      "is_canonical_coo",
+      [](handle A_rows, handle A_cols, unsigned n_threads, bool copy) {
+        py_args args{copy};
+        return dispatch(
+            [&](auto i) {
+              using I = type_of<decltype(i)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"is_canonical_coo", A_cols_.size()};
+              return is_canonical_coo<I>(A_rows_, A_cols_, n_threads);
+            },
+            dtype_of<index_types>(A_rows, "A_rows"));
+      },
+      "A_rows"_a, "A_cols"_a, "n_threads"_a = 0, "copy"_a = false);
+
+  m.def(
+      "is_canonical_csr",
+      [](handle A_rows, handle A_cols, unsigned n_threads, bool copy) {
+        py_args args{copy};
+        return dispatch(
+            [&](auto i) {
+              using I = type_of<decltype(i)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"is_canonical_csr", A_cols_.size()};
+              return is_canonical_csr<I>(A_rows_, A_cols_, n_threads);
+            },
+            dtype_of<index_types>(A_rows, "A_rows"));
+      },
+      "A_rows"_a, "A_cols"_a, "n_threads"_a = 0, "copy"_a = false);
+
+  m.def(
+      "canonicalize_csr",
+      [](handle A_rows, handle A_cols, handle A_data, std::string const &op,
+         unsigned n_threads) {
+        auto const op_ = op == "sum"   ? duplicate_sum
+                         : op == "max" ? duplicate_max
+                         : op == "min" ? duplicate_min
+                                       : throw pybind11::value_error(
+                                             "op: expected 'sum', 'max' or "
+                                             "'min'");
+
+        // the arrays are sorted in place, a copy would lose the result
+        py_args args{false};
+        return dispatch(
+            [&](auto i, auto d) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D>(A_data, "A_data");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"canonicalize_csr", A_cols_.size()};
+              auto const size =
+                  canonicalize_csr<I, D>(A_rows_, A_cols_, A_data_, op_,
+                                         n_threads);
+              span.output(static_cast<std::size_t>(size),
+                          trace::bytes_of(A_cols_, A_data_));
+              return size;
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "op"_a = "sum", "n_threads"_a = 0);
+
+  m.def(
+      "rolling_alloc_csr",
+      [](handle A_rows, handle A_cols, handle B_rows, std::int64_t A_n_cols,
+         std::int64_t window, bool copy) {
+        py_args args{copy};
+        return dispatch(
+            [&](auto i, auto j) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              using J = type_of<decltype(j)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const B_rows_ = args.get<J>(B_rows, "B_rows");
+
+              check_rows(A_rows_, A_cols_.size(), "A_rows");
+              check_size(B_rows_, A_rows_.size(), "B_rows");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"rolling_alloc_csr", A_cols_.size()};
+              auto const size = rolling_alloc_csr<I, J>(
+                  A_rows_, A_cols_, B_rows_, static_cast<I>(A_n_cols),
+                  static_cast<J>(window));
+              span.output(static_cast<std::size_t>(size),
+                          trace::bytes_of(B_rows_));
+              return size;
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<pointer_types>(B_rows, "B_rows"));
+      },
+      "A_rows"_a, "A_cols"_a, "B_rows"_a, "A_n_cols"_a, "window"_a,
+      "copy"_a = false);
+
+  auto const rolling_args =
+      std::make_tuple("A_rows"_a, "A_cols"_a, "A_data"_a, "B_cols"_a,
+                      "B_data"_a, "A_n_cols"_a, "window"_a, "copy"_a = false);
+  auto def_rolling = [&](char const *const name, rolling_op const op) {
+    std::apply(
+        [&](auto const &...a) { m.def(name, rolling_binding(op, name), a...); },
+        rolling_args);
+  };
+  def_rolling("rolling_min_csr", rolling_min);
+  def_rolling("rolling_max_csr", rolling_max);
+  def_rolling("rolling_mean_csr", rolling_mean);
+  def_rolling("rolling_median_csr", rolling_median);
+  def_rolling("rolling_sum_csr", rolling_sum);
+  def_rolling("rolling_count_csr", rolling_count);
+
+  m.def(
+      "rolling_median_approx_csr",
+      [](handle A_rows, handle A_cols, handle A_data, handle B_cols,
+         handle B_data, std::int64_t A_n_cols, std::int64_t window, double eps,
+         bool copy) {
+        if (!(0 < eps && eps <= 1))
+          throw pybind11::value_error("eps: expected a value in (0, 1]");
+
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto j, auto d) {
+              using I = type_of<decltype(i)>;
+              using J = type_of<decltype(j)>;
+              using D = type_of<decltype(d)>;
+
+              if constexpr (!widens_v<I, J>)
+                throw narrowing_error<I, J>("B_cols");
+              else {
+                auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+                auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+                auto const A_data_ = args.get<D const>(A_data, "A_data");
+                auto const B_cols_ = args.get<J>(B_cols, "B_cols");
+                auto const B_data_ = args.get<D>(B_data, "B_data");
+
+                check_csr(A_rows_, A_cols_, A_data_,
+                          "A_rows, A_cols, A_data");
+                auto const size = static_cast<std::size_t>(rolling_size_csr(
+                    A_rows_, A_cols_, static_cast<I>(A_n_cols),
+                    static_cast<J>(window)));
+                check_size(B_cols_, size, "B_cols");
+                check_size(B_data_, size, "B_data");
+
+                pybind11::gil_scoped_release release;
+                trace::scope span{"rolling_median_approx_csr", A_data_.size()};
+                get_kernels<I, J, D>(*active_kernels)
+                    .rolling_median_approx(A_rows_, A_cols_, A_data_, B_cols_,
+                                           B_data_, static_cast<I>(A_n_cols),
+                                           static_cast<J>(window),
+                                           static_cast<D>(eps));
+                span.output(B_data_.size(), trace::bytes_of(B_cols_, B_data_));
+              }
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<pointer_types>(B_cols, "B_cols"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "B_cols"_a, "B_data"_a,
+      "A_n_cols"_a, "window"_a, "eps"_a, "copy"_a = false);
+
+  m.def(
+      "rolling_windows_alloc_csr",
+      [](handle A_rows, handle A_cols, handle windows, handle B_rows,
+         std::int64_t A_n_cols, bool copy) {
+        py_args args{copy};
+        return dispatch(
+            [&](auto i, auto j) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              using J = type_of<decltype(j)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const windows_ = args.get<J const>(windows, "windows");
+              auto const B_rows_ = args.get<J>(B_rows, "B_rows");
+
+              check_rows(A_rows_, A_cols_.size(), "A_rows");
+              if (B_rows_.size() != windows_.size() * A_rows_.size())
+                throw pybind11::value_error(
+                    "B_rows: expected a row offset array per window");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"rolling_windows_alloc_csr", A_cols_.size()};
+              auto const size = rolling_windows_alloc_csr<I, J>(
+                  A_rows_, A_cols_, windows_, B_rows_,
+                  static_cast<I>(A_n_cols));
+              span.output(static_cast<std::size_t>(size),
+                          trace::bytes_of(B_rows_));
+              return size;
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<pointer_types>(B_rows, "B_rows"));
+      },
+      "A_rows"_a, "A_cols"_a, "windows"_a, "B_rows"_a, "A_n_cols"_a,
+      "copy"_a = false);
+
+  auto const windows_args = std::make_tuple(
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "windows"_a, "B_rows"_a, "B_cols"_a,
+      "B_data"_a, "A_n_cols"_a, "n_threads"_a, "copy"_a = false);
+  auto def_windows = [&](char const *const name, rolling_op const op) {
+    std::apply(
+        [&](auto const &...a) { m.def(name, windows_binding(op, name), a...); },
+        windows_args);
+  };
+  def_windows("rolling_windows_min_csr", rolling_min);
+  def_windows("rolling_windows_max_csr", rolling_max);
+  def_windows("rolling_windows_mean_csr", rolling_mean);
+  def_windows("rolling_windows_sum_csr", rolling_sum);
+  def_windows("rolling_windows_count_csr", rolling_count);
+
+  auto const scan_args =
+      std::make_tuple("A_rows"_a, "A_cols"_a, "A_data"_a, "B_cols"_a,
+                      "B_data"_a, "copy"_a = false);
+  auto def_scan = [&](char const *const name, rolling_op const op) {
+    std::apply(
+        [&](auto const &...a) { m.def(name, scan_binding(op, name), a...); },
+        scan_args);
+  };
+  def_scan("rolling_scan_min_csr", rolling_min);
+  def_scan("rolling_scan_max_csr", rolling_max);
+  def_scan("rolling_scan_mean_csr", rolling_mean);
+  def_scan("rolling_scan_median_csr", rolling_median);
+  def_scan("rolling_scan_sum_csr", rolling_sum);
+  def_scan("rolling_scan_count_csr", rolling_count);
+
+  m.def(
+      "convolve_scan_csr",
+      [](handle A_rows, handle A_cols, handle A_data, handle coeffs,
+         handle B_cols, handle B_data, bool copy) {
+        py_args args{copy};
+        return dispatch(
+            [&](auto i, auto d) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D const>(A_data, "A_data");
+              auto const coeffs_ = args.get<D const>(coeffs, "coeffs");
+              auto const B_cols_ = args.get<I>(B_cols, "B_cols");
+              auto const B_data_ = args.get<D>(B_data, "B_data");
+
+              if (A_rows_.size() != coeffs_.size() + 1)
+                throw pybind11::value_error(
+                    "A_rows: expected a row per coefficient");
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+              if (B_cols_.size() < static_cast<std::size_t>(A_rows_.back() -
+                                                            A_rows_.front()) ||
+                  B_data_.size() < B_cols_.size())
+                throw pybind11::value_error(
+                    "B_cols, B_data: expected room for every nonzero of A");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"convolve_scan_csr", A_data_.size()};
+              auto const size = get_kernels<I, i64, D>(*active_kernels)
+                                    .convolve_scan(A_rows_, A_cols_, A_data_,
+                                                   coeffs_, B_cols_, B_data_);
+              span.output(static_cast<std::size_t>(size),
+                          trace::bytes_of(B_cols_, B_data_));
+              return size;
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "coeffs"_a, "B_cols"_a, "B_data"_a,
+      "copy"_a = false);
+
+  def_rolling_plan(m);
+  def_hybrid(m);
+
+  m.def(
+      "std_csr",
+      [](handle rows, handle data, std::int64_t n_cols, handle result,
+         bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const rows_ = args.get<I const>(rows, "rows");
+              auto const data_ = args.get_strided<D const>(data, "data");
+              auto const result_ = args.get<D>(result, "result");
+
+              check_rows(rows_, data_.size(), "rows");
+              check_size(result_, rows_.size() - 1, "result");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"std_csr", data_.size()};
+              if (data_.is_contiguous())
+                get_kernels<I, i64, D>(*active_kernels).stdev(
+                    rows_, data_.contiguous(), static_cast<I>(n_cols),
+                    result_);
+              else
+                stdev_csr<I, D>(rows_, data_, static_cast<I>(n_cols),
+                                result_);
+              span.output(result_.size(), trace::bytes_of(result_));
+            },
+            dtype_of<index_types>(rows, "rows"),
+            dtype_of<value_types>(data, "data"));
+      },
+      "rows"_a, "data"_a, "n_cols"_a, "result"_a, "copy"_a = false);
+
+  m.def(
+      "convolve_csr_dv",
+      [](handle A_rows, handle A_cols, handle A_data, handle coeffs,
+         handle B_cols, handle B_data, std::int64_t A_n_cols, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto j, auto d) {
+              using I = type_of<decltype(i)>;
+              using J = type_of<decltype(j)>;
+              using D = type_of<decltype(d)>;
+
+              if constexpr (!widens_v<I, J>)
+                throw narrowing_error<I, J>("B_cols");
+              else {
+                auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+                auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+                auto const A_data_ = args.get<D const>(A_data, "A_data");
+                auto const coeffs_ = args.get<D const>(coeffs, "coeffs");
+                auto const B_cols_ = args.get<J>(B_cols, "B_cols");
+                auto const B_data_ = args.get<D>(B_data, "B_data");
+
+                check_csr(A_rows_, A_cols_, A_data_,
+                          "A_rows, A_cols, A_data");
+                if (coeffs_.size() == 0)
+                  throw pybind11::value_error{"the coefficients must not be "
+                                              "empty"};
+                auto const size = static_cast<std::size_t>(rolling_size_csr(
+                    A_rows_, A_cols_, static_cast<I>(A_n_cols),
+                    static_cast<J>(coeffs_.size())));
+                check_size(B_cols_, size, "B_cols");
+                check_size(B_data_, size, "B_data");
+
+                pybind11::gil_scoped_release release;
+                trace::scope span{"convolve_csr_dv", A_data_.size()};
+                get_kernels<I, J, D>(*active_kernels).convolve(
+                    A_rows_, A_cols_, A_data_, coeffs_, B_cols_, B_data_,
+                    static_cast<I>(A_n_cols));
+                span.output(B_data_.size(), trace::bytes_of(B_cols_, B_data_));
+              }
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<pointer_types>(B_cols, "B_cols"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "coeffs"_a, "B_cols"_a, "B_data"_a,
+      "A_n_cols"_a, "copy"_a = false);
+
+  m.def(
+      "convolve_csr_dm",
+      [](handle A_rows, handle A_cols, handle A_data, handle coeffs,
+         std::int64_t n_outputs, handle B_cols, handle B_data,
+         std::int64_t A_n_cols, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto j, auto d) {
+              using I = type_of<decltype(i)>;
+              using J = type_of<decltype(j)>;
+              using D = type_of<decltype(d)>;
+
+              if constexpr (!widens_v<I, J>)
+                throw narrowing_error<I, J>("B_cols");
+              else {
+                auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+                auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+                auto const A_data_ = args.get<D const>(A_data, "A_data");
+                auto const coeffs_ = args.get<D const>(coeffs, "coeffs");
+                auto const B_cols_ = args.get<J>(B_cols, "B_cols");
+                auto const B_data_ = args.get<D>(B_data, "B_data");
+
+                auto const n_out = static_cast<std::size_t>(n_outputs);
+                if (n_outputs <= 0 || coeffs_.size() % n_out != 0 ||
+                    coeffs_.size() == 0)
+                  throw pybind11::value_error{"the coefficients must hold "
+                                              "n_outputs kernels of the same "
+                                              "nonzero size"};
+                if (B_data_.size() != n_out * B_cols_.size())
+                  throw pybind11::value_error{"the output values must hold "
+                                              "n_outputs times the output "
+                                              "indices"};
+                check_csr(A_rows_, A_cols_, A_data_,
+                          "A_rows, A_cols, A_data");
+                check_size(B_cols_,
+                           static_cast<std::size_t>(rolling_size_csr(
+                               A_rows_, A_cols_, static_cast<I>(A_n_cols),
+                               static_cast<J>(coeffs_.size() / n_out))),
+                           "B_cols");
+
+                pybind11::gil_scoped_release release;
+                trace::scope span{"convolve_csr_dm", A_data_.size()};
+                get_kernels<I, J, D>(*active_kernels)
+                    .convolve_many(A_rows_, A_cols_, A_data_, coeffs_,
+                                   static_cast<J>(n_outputs), B_cols_,
+                                   B_data_, static_cast<I>(A_n_cols));
+                span.output(B_data_.size(), trace::bytes_of(B_cols_, B_data_));
+              }
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<pointer_types>(B_cols, "B_cols"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "coeffs"_a, "n_outputs"_a,
+      "B_cols"_a, "B_data"_a, "A_n_cols"_a, "copy"_a = false);
+
+  m.def(
+      "maxclip_csr_spmat_plus_dvec_nonnegative",
+      [](handle A_rows, handle A_cols, handle A_data, handle B_rows,
+         handle B_cols, handle B_data, handle C_data, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D>(A_data, "A_data");
+              auto const B_rows_ = args.get<I const>(B_rows, "B_rows");
+              auto const B_cols_ = args.get<I const>(B_cols, "B_cols");
+              auto const B_data_ = args.get<D const>(B_data, "B_data");
+              auto const C_data_ = args.get<D const>(C_data, "C_data");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+              check_csr(B_rows_, B_cols_, B_data_, "B_rows, B_cols, B_data");
+              check_size(B_rows_, A_rows_.size(), "B_rows");
+              check_size(C_data_, A_rows_.size() - 1, "C_data");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"maxclip_csr_spmat_plus_dvec_nonnegative",
+                                A_data_.size() + B_data_.size()};
+              get_kernels<I, i64, D>(*active_kernels).maxclip(
+                  A_rows_, A_cols_, A_data_, B_rows_, B_cols_, B_data_,
+                  C_data_);
+              span.output(A_data_.size(), 0);
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "B_rows"_a, "B_cols"_a, "B_data"_a,
+      "C_data"_a, "copy"_a = false);
+
+  m.def(
+      "clip_prune_csr",
+      [](handle A_rows, handle A_cols, handle A_data, double lower,
+         double upper) {
+        py_args args{false};
+        return dispatch(
+            [&](auto i, auto d) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D>(A_data, "A_data");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"clip_prune_csr", A_data_.size()};
+              auto const size =
+                  get_kernels<I, i64, D>(*active_kernels)
+                      .clip_prune(A_rows_, A_cols_, A_data_,
+                                  static_cast<D>(lower), static_cast<D>(upper));
+              span.output(static_cast<std::size_t>(size), 0);
+              return size;
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "lower"_a, "upper"_a);
+
+  m.def(
+      "subtract_clip_csr",
+      [](handle A_rows, handle A_cols, handle A_data, handle B_rows,
+         handle B_cols, handle B_data, handle C_rows, handle C_cols,
+         handle C_data, double lower, double upper) {
+        py_args args{false};
+        return dispatch(
+            [&](auto i, auto d) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D const>(A_data, "A_data");
+              auto const B_rows_ = args.get<I const>(B_rows, "B_rows");
+              auto const B_cols_ = args.get<I const>(B_cols, "B_cols");
+              auto const B_data_ = args.get<D const>(B_data, "B_data");
+              auto const C_rows_ = args.get<I>(C_rows, "C_rows");
+              auto const C_cols_ = args.get<I>(C_cols, "C_cols");
+              auto const C_data_ = args.get<D>(C_data, "C_data");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+              check_csr(B_rows_, B_cols_, B_data_, "B_rows, B_cols, B_data");
+              if (B_rows_.size() != A_rows_.size() ||
+                  C_rows_.size() != A_rows_.size())
+                throw pybind11::value_error(
+                    "A_rows, B_rows, C_rows: expected the same number of "
+                    "rows");
+              if (C_cols_.size() < static_cast<std::size_t>(
+                                       A_rows_.back() - A_rows_.front() +
+                                       B_rows_.back() - B_rows_.front()) ||
+                  C_data_.size() < C_cols_.size())
+                throw pybind11::value_error(
+                    "C_cols, C_data: expected room for every nonzero of A "
+                    "and B");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"subtract_clip_csr",
+                                A_data_.size() + B_data_.size()};
+              auto const size =
+                  get_kernels<I, i64, D>(*active_kernels)
+                      .subtract_clip(A_rows_, A_cols_, A_data_, B_rows_,
+                                     B_cols_, B_data_, C_rows_, C_cols_,
+                                     C_data_, static_cast<D>(lower),
+                                     static_cast<D>(upper));
+              span.output(static_cast<std::size_t>(size), 0);
+              return size;
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "B_rows"_a, "B_cols"_a, "B_data"_a,
+      "C_rows"_a, "C_cols"_a, "C_data"_a, "lower"_a, "upper"_a);
+
+  m.def(
+      "nmf_csr",
+      [](handle A_rows, handle A_cols, handle A_data, handle windows,
+         handle W, handle H, handle errors, std::int64_t A_n_cols,
+         std::int64_t rank, std::int64_t max_iter, double tol,
+         bool warm_start, unsigned n_threads, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D const>(A_data, "A_data");
+              auto const windows_ = args.get<I const>(windows, "windows");
+              auto const W_ = args.get<D>(W, "W");
+              auto const H_ = args.get<D>(H, "H");
+              auto const errors_ = args.get<D>(errors, "errors");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+              if (rank < 1 || A_n_cols < 0)
+                throw pybind11::value_error(
+                    "rank, A_n_cols: expected a positive rank and a "
+                    "non-negative number of columns");
+              auto const n_rows = A_rows_.size() - 1;
+              if (windows_.empty() || windows_.front() < 0 ||
+                  !std::is_sorted(windows_.begin(), windows_.end()) ||
+                  static_cast<std::size_t>(windows_.back()) > n_rows)
+                throw pybind11::value_error(
+                    "windows: expected sorted row offsets within the matrix");
+
+              auto const k = static_cast<std::size_t>(rank);
+              auto const n_windows = windows_.size() - 1;
+              if (W_.size() != n_rows * k)
+                throw pybind11::value_error(
+                    "W: expected a (rows x rank) matrix");
+              if (H_.size() !=
+                  n_windows * static_cast<std::size_t>(A_n_cols) * k)
+                throw pybind11::value_error(
+                    "H: expected a (cols x rank) matrix per window");
+              if (errors_.size() != n_windows)
+                throw pybind11::value_error(
+                    "errors: expected a value per window");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"nmf_csr", A_data_.size()};
+              nmf_csr<I, D>(A_rows_, A_cols_, A_data_, windows_, W_, H_,
+                            errors_, static_cast<I>(A_n_cols),
+                            static_cast<I>(rank), static_cast<I>(max_iter),
+                            static_cast<D>(tol), warm_start, n_threads);
+              span.output(W_.size() + H_.size(), 0);
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "windows"_a, "W"_a, "H"_a,
+      "errors"_a, "A_n_cols"_a, "rank"_a, "max_iter"_a, "tol"_a,
+      "warm_start"_a, "n_threads"_a, "copy"_a = false);
+
+  m.def(
+      "peaks_alloc_csr",
+      [](handle A_rows, handle A_cols, handle A_data, handle B_rows,
+         std::int64_t A_n_cols, double min_prominence, double min_width,
+         unsigned n_threads, bool copy) {
+        py_args args{copy};
+        return dispatch(
+            [&](auto i, auto d) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D const>(A_data, "A_data");
+              auto const B_rows_ = args.get<I>(B_rows, "B_rows");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+              check_size(B_rows_, A_rows_.size(), "B_rows");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"peaks_alloc_csr", A_data_.size()};
+              auto const size = peaks_alloc_csr<I, D>(
+                  A_rows_, A_cols_, A_data_, B_rows_, static_cast<I>(A_n_cols),
+                  static_cast<D>(min_prominence), static_cast<D>(min_width),
+                  n_threads);
+              span.output(static_cast<std::size_t>(size),
+                          trace::bytes_of(B_rows_));
+              return size;
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "B_rows"_a, "A_n_cols"_a,
+      "min_prominence"_a, "min_width"_a, "n_threads"_a, "copy"_a = false);
+
+  m.def(
+      "peaks_csr",
+      [](handle A_rows, handle A_cols, handle A_data, handle B_rows,
+         handle B_apex, handle B_height, handle B_prominence, handle B_area,
+         handle B_left, handle B_right, std::int64_t A_n_cols,
+         double min_prominence, double min_width, unsigned n_threads,
+         bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D const>(A_data, "A_data");
+              auto const B_rows_ = args.get<I const>(B_rows, "B_rows");
+              auto const B_apex_ = args.get<I>(B_apex, "B_apex");
+              auto const B_height_ = args.get<D>(B_height, "B_height");
+              auto const B_prominence_ =
+                  args.get<D>(B_prominence, "B_prominence");
+              auto const B_area_ = args.get<D>(B_area, "B_area");
+              auto const B_left_ = args.get<D>(B_left, "B_left");
+              auto const B_right_ = args.get<D>(B_right, "B_right");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+              check_size(B_rows_, A_rows_.size(), "B_rows");
+              check_rows(B_rows_, B_apex_.size(), "B_rows");
+              auto const size = static_cast<std::size_t>(B_rows_.back());
+              check_size(B_apex_, size, "B_apex");
+              check_size(B_height_, size, "B_height");
+              check_size(B_prominence_, size, "B_prominence");
+              check_size(B_area_, size, "B_area");
+              check_size(B_left_, size, "B_left");
+              check_size(B_right_, size, "B_right");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"peaks_csr", A_data_.size()};
+              peaks_csr<I, D>(A_rows_, A_cols_, A_data_, B_rows_, B_apex_,
+                              B_height_, B_prominence_, B_area_, B_left_,
+                              B_right_, static_cast<I>(A_n_cols),
+                              static_cast<D>(min_prominence),
+                              static_cast<D>(min_width), n_threads);
+              span.output(B_apex_.size(),
+                          trace::bytes_of(B_apex_, B_height_, B_prominence_,
+                                          B_area_, B_left_, B_right_));
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "B_rows"_a, "B_apex"_a,
+      "B_height"_a, "B_prominence"_a, "B_area"_a, "B_left"_a, "B_right"_a,
+      "A_n_cols"_a, "min_prominence"_a, "min_width"_a, "n_threads"_a,
+      "copy"_a = false);
+
+  m.def(
+      "xic_query_csc",
+      [](handle A_cols, handle A_rows, handle A_data, handle mz_scales,
+         handle mz, double ppm, std::int64_t row_lo, std::int64_t row_hi,
+         handle B_data, bool max_pool, unsigned n_threads, bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_data_ = args.get<D const>(A_data, "A_data");
+              auto const mz_scales_ =
+                  args.get<double const>(mz_scales, "mz_scales");
+              auto const mz_ = args.get<double const>(mz, "mz");
+              auto const B_data_ = args.get<D>(B_data, "B_data");
+
+              if (A_cols_.size() != mz_scales_.size() + 1)
+                throw pybind11::value_error(
+                    "mz_scales: expected an m/z value per column");
+              if (row_lo < 0 || row_hi < row_lo)
+                throw pybind11::value_error(
+                    "row_lo, row_hi: expected 0 <= row_lo <= row_hi");
+              if (B_data_.size() !=
+                  mz_.size() * static_cast<std::size_t>(row_hi - row_lo))
+                throw pybind11::value_error(
+                    "B_data: expected a value per target and scan");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"xic_query_csc", A_data_.size()};
+              xic_query_csc<I, D>(A_cols_, A_rows_, A_data_, mz_scales_, mz_,
+                                  ppm, static_cast<I>(row_lo),
+                                  static_cast<I>(row_hi), B_data_, max_pool,
+                                  n_threads);
+              span.output(B_data_.size(), trace::bytes_of(B_data_));
+            },
+            dtype_of<index_types>(A_cols, "A_cols"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_cols"_a, "A_rows"_a, "A_data"_a, "mz_scales"_a, "mz"_a, "ppm"_a,
+      "row_lo"_a, "row_hi"_a, "B_data"_a, "max_pool"_a, "n_threads"_a,
+      "copy"_a = false);
+
+  m.def(
+      "dtw_align_runs",
+      [](handle reference, pybind11::list runs, std::int64_t n_features,
+         std::int64_t band, pybind11::list ref_to_run,
+         pybind11::list run_to_ref, handle costs, unsigned n_threads,
+         bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto d) {
+              using D = type_of<decltype(d)>;
+              auto const reference_ = args.get<D const>(reference, "reference");
+              auto const costs_ = args.get<double>(costs, "costs");
+
+              std::vector<cspan<D>> runs_;
+              std::vector<span<double>> ref_to_run_, run_to_ref_;
+              for (auto const run : runs)
+                runs_.push_back(args.get<D const>(run, "runs"));
+              for (auto const out : ref_to_run)
+                ref_to_run_.push_back(args.get<double>(out, "ref_to_run"));
+              for (auto const out : run_to_ref)
+                run_to_ref_.push_back(args.get<double>(out, "run_to_ref"));
+
+              pybind11::gil_scoped_release release;
+              std::size_t size = reference_.size();
+              for (auto const run : runs_)
+                size += run.size();
+              trace::scope span{"dtw_align_runs", size};
+              dtw_align_runs<D>(reference_, runs_, n_features, band,
+                                ref_to_run_, run_to_ref_, costs_, n_threads);
+              span.output(costs_.size(), 0);
+            },
+            dtype_of<value_types>(reference, "reference"));
+      },
+      "reference"_a, "runs"_a, "n_features"_a, "band"_a, "ref_to_run"_a,
+      "run_to_ref"_a, "costs"_a, "n_threads"_a = 0, "copy"_a = false);
+
+  m.def(
+      "resample_alloc_csr",
+      [](handle A_rows, handle A_cols, handle positions, handle B_rows,
+         unsigned n_threads, bool copy) {
+        py_args args{copy};
+        return dispatch(
+            [&](auto i) -> std::int64_t {
+              using I = type_of<decltype(i)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const positions_ =
+                  args.get<double const>(positions, "positions");
+              auto const B_rows_ = args.get<I>(B_rows, "B_rows");
+
+              check_rows(A_rows_, A_cols_.size(), "A_rows");
+              check_size(B_rows_, positions_.size() + 1, "B_rows");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"resample_alloc_csr", A_cols_.size()};
+              auto const size = resample_alloc_csr<I>(A_rows_, A_cols_,
+                                                      positions_, B_rows_,
+                                                      n_threads);
+              span.output(static_cast<std::size_t>(size),
+                          trace::bytes_of(B_rows_));
+              return static_cast<std::int64_t>(size);
+            },
+            dtype_of<index_types>(A_rows, "A_rows"));
+      },
+      "A_rows"_a, "A_cols"_a, "positions"_a, "B_rows"_a, "n_threads"_a = 0,
+      "copy"_a = false);
+
+  m.def(
+      "resample_csr",
+      [](handle A_rows, handle A_cols, handle A_data, handle positions,
+         handle B_rows, handle B_cols, handle B_data, unsigned n_threads,
+         bool copy) {
+        py_args args{copy};
+        dispatch(
+            [&](auto i, auto d) {
+              using I = type_of<decltype(i)>;
+              using D = type_of<decltype(d)>;
+              auto const A_rows_ = args.get<I const>(A_rows, "A_rows");
+              auto const A_cols_ = args.get<I const>(A_cols, "A_cols");
+              auto const A_data_ = args.get<D const>(A_data, "A_data");
+              auto const positions_ =
+                  args.get<double const>(positions, "positions");
+              auto const B_rows_ = args.get<I const>(B_rows, "B_rows");
+              auto const B_cols_ = args.get<I>(B_cols, "B_cols");
+              auto const B_data_ = args.get<D>(B_data, "B_data");
+
+              check_csr(A_rows_, A_cols_, A_data_, "A_rows, A_cols, A_data");
+              check_size(B_rows_, positions_.size() + 1, "B_rows");
+              check_rows(B_rows_, B_cols_.size(), "B_rows");
+              check_size(B_cols_, static_cast<std::size_t>(B_rows_.back()),
+                         "B_cols");
+              check_size(B_data_, B_cols_.size(), "B_data");
+
+              pybind11::gil_scoped_release release;
+              trace::scope span{"resample_csr", A_data_.size()};
+              resample_csr<I, D>(A_rows_, A_cols_, A_data_, positions_,
+                                 B_rows_, B_cols_, B_data_, n_threads);
+              span.output(B_data_.size(), trace::bytes_of(B_cols_, B_data_));
+            },
+            dtype_of<index_types>(A_rows, "A_rows"),
+            dtype_of<value_types>(A_data, "A_data"));
+      },
+      "A_rows"_a, "A_cols"_a, "A_data"_a, "positions"_a, "B_rows"_a,
+      "B_cols"_a, "B_data"_a, "n_threads"_a = 0, "copy"_a = false);
 }
@@ -0,0 +1,320 @@
+#pragma once
+
+#include "parallel.h"
+#include "span.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace spectre {
+  // Scales the (scans x features) profile for the comparison of the scans:
+  // the square root damps the most intense features and every feature is then
+  // divided by its maximum, so that each of them weighs the same in a run
+  // however its intensities compare to those of the reference
+  template <typename D>
+  void normalize_profile(cspan<D> const profile, std::ptrdiff_t const n_features,
+                         std::vector<D> &out)
+  {
+    auto const n = static_cast<std::size_t>(n_features);
+    out.resize(profile.size());
+    std::vector<D> scale(n, static_cast<D>(0));
+
+    for (std::size_t a = 0; a < profile.size(); a += n)
+      for (std::size_t f = 0; f < n; ++f) {
+        out[a + f] = std::sqrt(std::max(profile[a + f], static_cast<D>(0)));
+        scale[f] = std::max(scale[f], out[a + f]);
+      }
+    for (auto &value : scale)
+      value = value > 0 ? 1 / value : static_cast<D>(0);
+    for (std::size_t a = 0; a < out.size(); a += n)
+      for (std::size_t f = 0; f < n; ++f)
+        out[a + f] *= scale[f];
+  }
+
+  // The band of a warping between `n_ref` and `n_run` scans: the cells of row
+  // `i` are those within `band` of the diagonal. The band is widened to the
+  // slope of the diagonal, so consecutive rows always share a path.
+  class warp_band {
+  public:
+    warp_band(std::ptrdiff_t const n_ref, std::ptrdiff_t const n_run,
+              std::ptrdiff_t const band)
+        : _n_run{n_run},
+          _slope{n_ref > 1 ? static_cast<double>(n_run - 1) /
+                                 static_cast<double>(n_ref - 1)
+                           : static_cast<double>(n_run - 1)},
+          _band{std::max(band, static_cast<std::ptrdiff_t>(std::ceil(_slope)))}
+    {}
+
+    std::ptrdiff_t lo(std::ptrdiff_t const i) const noexcept
+    {
+      auto const center = static_cast<std::ptrdiff_t>(
+          std::floor(static_cast<double>(i) * _slope));
+      return std::max<std::ptrdiff_t>(0, center - _band);
+    }
+
+    std::ptrdiff_t hi(std::ptrdiff_t const i) const noexcept
+    {
+      auto const center = static_cast<std::ptrdiff_t>(
+          std::ceil(static_cast<double>(i) * _slope));
+      return std::min(_n_run, center + _band + 1);
+    }
+
+    std::ptrdiff_t width() const noexcept
+    {
+      return std::min(_n_run, 2 * _band + 3);
+    }
+
+  private:
+    std::ptrdiff_t _n_run;
+    double _slope;
+    std::ptrdiff_t _band;
+  };
+
+  // Dynamic time warping of the normalized (scans x features) profiles `run`
+  // onto `ref` within a band, with the symmetric steps (a diagonal step costs
+  // twice). A row of the local costs is computed at once, the inner loop over
+  // the contiguous features vectorizes; only the steps of the path are kept,
+  // one byte per cell of the band. Every scan of one run gets the mean scan of
+  // the other run it was matched with, `ref_to_run` and `run_to_ref`, and the
+  // normalized cost of the path is returned.
+  template <typename D>
+  double dtw_banded(cspan<D> const ref, cspan<D> const run,
+                    std::ptrdiff_t const n_features, std::ptrdiff_t const band,
+                    span<double> const ref_to_run,
+                    span<double> const run_to_ref)
+  {
+    enum step : std::uint8_t { diagonal, vertical, horizontal };
+    constexpr auto inf = std::numeric_limits<double>::infinity();
+
+    auto const n_ref = static_cast<std::ptrdiff_t>(ref_to_run.size());
+    auto const n_run = static_cast<std::ptrdiff_t>(run_to_ref.size());
+    auto const bounds = warp_band{n_ref, n_run, band};
+    auto const width = bounds.width();
+
+    std::vector<std::uint8_t> steps(static_cast<std::size_t>(n_ref * width));
+    std::vector<double> prev(static_cast<std::size_t>(width), inf);
+    std::vector<double> cost(static_cast<std::size_t>(width));
+    std::vector<double> curr(static_cast<std::size_t>(width));
+
+    std::ptrdiff_t prev_lo = 0;
+    std::ptrdiff_t prev_hi = 0;
+    for (std::ptrdiff_t i = 0; i < n_ref; ++i) {
+      auto const lo = bounds.lo(i);
+      auto const hi = bounds.hi(i);
+      auto const x = ref.begin() + i * n_features;
+
+      for (auto j = lo; j < hi; ++j) {
+        auto const y = run.begin() + j * n_features;
+        D sum = 0;
+        for (std::ptrdiff_t f = 0; f < n_features; ++f)
+          sum += (x[f] - y[f]) * (x[f] - y[f]);
+        cost[j - lo] = static_cast<double>(sum);
+      }
+
+      auto const row = steps.begin() + i * width;
+      auto const at_prev = [&](std::ptrdiff_t const j) {
+        return prev_lo <= j && j < prev_hi ? prev[j - prev_lo] : inf;
+      };
+      for (auto j = lo; j < hi; ++j) {
+        auto const c = cost[j - lo];
+        auto best = i == 0 && j == 0 ? c : at_prev(j - 1) + 2 * c;
+        auto how = diagonal;
+        if (auto const up = at_prev(j) + c; up < best)
+          best = up, how = vertical;
+        if (j > lo)
+          if (auto const left = curr[j - lo - 1] + c; left < best)
+            best = left, how = horizontal;
+        curr[j - lo] = best;
+        row[j - lo] = how;
+      }
+
+      std::swap(prev, curr);
+      prev_lo = lo;
+      prev_hi = hi;
+    }
+    auto const total = prev[n_run - 1 - prev_lo];
+
+    std::fill(ref_to_run.begin(), ref_to_run.end(), 0.0);
+    std::fill(run_to_ref.begin(), run_to_ref.end(), 0.0);
+    std::vector<std::ptrdiff_t> ref_count(static_cast<std::size_t>(n_ref));
+    std::vector<std::ptrdiff_t> run_count(static_cast<std::size_t>(n_run));
+
+    for (auto i = n_ref - 1, j = n_run - 1;;) {
+      ref_to_run[i] += static_cast<double>(j);
+      run_to_ref[j] += static_cast<double>(i);
+      ++ref_count[i];
+      ++run_count[j];
+      if (i == 0 && j == 0)
+        break;
+
+      auto const how = steps[i * width + (j - bounds.lo(i))];
+      i -= how != horizontal;
+      j -= how != vertical;
+    }
+    for (std::ptrdiff_t i = 0; i < n_ref; ++i)
+      ref_to_run[i] /= static_cast<double>(ref_count[i]);
+    for (std::ptrdiff_t j = 0; j < n_run; ++j)
+      run_to_ref[j] /= static_cast<double>(run_count[j]);
+
+    return total / static_cast<double>(n_ref + n_run);
+  }
+
+  // Aligns every run to the reference in parallel over the runs. The profiles
+  // hold `n_features` intensities per scan, e.g. the chromatograms of the most
+  // intense m/z columns of the reference, and are normalized first.
+  template <typename D>
+  void dtw_align_runs(cspan<D> const ref, std::vector<cspan<D>> const &runs,
+                      std::ptrdiff_t const n_features,
+                      std::ptrdiff_t const band,
+                      std::vector<span<double>> const &ref_to_run,
+                      std::vector<span<double>> const &run_to_ref,
+                      span<double> const costs, unsigned const n_threads)
+  {
+    auto const n = static_cast<std::size_t>(n_features);
+    auto const n_ref = ref.size() / std::max<std::size_t>(n, 1);
+    if (n_features < 1 || band < 0)
+      throw std::invalid_argument{"expected features and a non-negative band"};
+    if (ref.size() != n_ref * n || n_ref == 0 || runs.size() != costs.size() ||
+        ref_to_run.size() != runs.size() || run_to_ref.size() != runs.size())
+      throw std::invalid_argument{"the profiles do not match the outputs"};
+    for (std::size_t k = 0; k < runs.size(); ++k)
+      if (runs[k].size() != run_to_ref[k].size() * n ||
+          run_to_ref[k].size() == 0 || ref_to_run[k].size() != n_ref)
+        throw std::invalid_argument{"the profile of run " + std::to_string(k) +
+                                    " does not match its outputs"};
+
+    std::vector<D> reference;
+    normalize_profile(ref, n_features, reference);
+
+    auto const n_runs = static_cast<std::ptrdiff_t>(runs.size());
+    parallel_for(n_runs, 1, n_threads, [&](auto const a, auto const b) {
+      std::vector<D> profile;
+      for (auto k = a; k < b; ++k) {
+        normalize_profile(runs[k], n_features, profile);
+        costs[k] = dtw_banded(
+            cspan<D>{reference.data(), reference.size()},
+            cspan<D>{profile.data(), profile.size()}, n_features, band,
+            ref_to_run[k], run_to_ref[k]);
+      }
+    });
+  }
+
+  // The rows of a resampled CSR matrix: the output row `i` interpolates the
+  // rows `floor(p)` and `floor(p) + 1` of `A` linearly at `p = positions[i]`,
+  // clamped to the rows of `A`
+  struct resample_point {
+    std::ptrdiff_t row;
+    double weight;
+
+    static resample_point at(double const p, std::ptrdiff_t const n_rows)
+    {
+      auto const q = std::clamp(p, 0.0, static_cast<double>(n_rows - 1));
+      auto const row = static_cast<std::ptrdiff_t>(std::floor(q));
+      return {row, row + 1 < n_rows ? q - static_cast<double>(row) : 0.0};
+    }
+  };
+
+  template <typename I>
+  I resample_alloc_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                       cspan<double> const positions, span<I> const B_rows,
+                       unsigned const n_threads)
+  {
+    auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+    auto const n_out = static_cast<std::ptrdiff_t>(positions.size());
+    if (n_rows < 1 || B_rows.size() != positions.size() + 1)
+      throw std::invalid_argument{"the rows do not match the positions"};
+
+    // the number of the nonzeros of every row first, then their offsets
+    B_rows[0] = 0;
+    parallel_for(n_out, 1024, n_threads, [&](auto const a, auto const b) {
+      for (auto i = a; i < b; ++i) {
+        auto const p = resample_point::at(positions[i], n_rows);
+        auto const lhs = A_cols.slice(A_rows[p.row], A_rows[p.row + 1]);
+        if (p.weight == 0) {
+          B_rows[i + 1] = static_cast<I>(lhs.size());
+          continue;
+        }
+
+        auto const rhs = A_cols.slice(A_rows[p.row + 1], A_rows[p.row + 2]);
+        std::size_t size = 0, l = 0, r = 0;
+        for (; l < lhs.size() && r < rhs.size(); ++size) {
+          auto const col = std::min(lhs[l], rhs[r]);
+          l += lhs[l] == col;
+          r += rhs[r] == col;
+        }
+        B_rows[i + 1] =
+            static_cast<I>(size + (lhs.size() - l) + (rhs.size() - r));
+      }
+    });
+    for (std::ptrdiff_t i = 0; i < n_out; ++i)
+      B_rows[i + 1] += B_rows[i];
+    return B_rows[n_out];
+  }
+
+  // Interpolates the rows of the canonical CSR `A` at `positions` into `B`,
+  // whose structure was computed by `resample_alloc_csr`, without ever
+  // densifying a row: the output merges the indices of the two rows
+  template <typename I, typename D>
+  void resample_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                    cspan<D> const A_data, cspan<double> const positions,
+                    cspan<I> const B_rows, span<I> const B_cols,
+                    span<D> const B_data, unsigned const n_threads)
+  {
+    auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+    auto const n_out = static_cast<std::ptrdiff_t>(positions.size());
+    if (n_rows < 1 || B_rows.size() != positions.size() + 1 ||
+        B_cols.size() < static_cast<std::size_t>(B_rows[n_out]) ||
+        B_data.size() < B_cols.size())
+      throw std::invalid_argument{"the output does not match the positions"};
+    // every row fills exactly its range of `B_rows`, offsets computed with
+    // other arguments are rejected rather than overrun
+    constexpr auto mismatch = "the output rows do not match the positions";
+
+    parallel_for(n_out, 1024, n_threads, [&](auto const a, auto const b) {
+      for (auto i = a; i < b; ++i) {
+        auto const p = resample_point::at(positions[i], n_rows);
+        auto out = static_cast<std::size_t>(B_rows[i]);
+        auto const end = static_cast<std::size_t>(B_rows[i + 1]);
+        auto const l_end = static_cast<std::size_t>(A_rows[p.row + 1]);
+        auto l = static_cast<std::size_t>(A_rows[p.row]);
+        if (p.weight == 0) {
+          if (end - out != l_end - l)
+            throw std::invalid_argument{mismatch};
+          std::copy(A_cols.begin() + l, A_cols.begin() + l_end,
+                    B_cols.begin() + out);
+          std::copy(A_data.begin() + l, A_data.begin() + l_end,
+                    B_data.begin() + out);
+          continue;
+        }
+
+        auto const w_lhs = static_cast<D>(1 - p.weight);
+        auto const w_rhs = static_cast<D>(p.weight);
+        auto const r_end = static_cast<std::size_t>(A_rows[p.row + 2]);
+        auto r = l_end;
+        while (l < l_end || r < r_end) {
+          auto const take_l = l < l_end && (r == r_end || A_cols[l] <= A_cols[r]);
+          auto const take_r = r < r_end && (l == l_end || A_cols[r] <= A_cols[l]);
+          if (out == end)
+            throw std::invalid_argument{mismatch};
+          auto value = static_cast<D>(0);
+          if (take_l)
+            value += w_lhs * A_data[l];
+          if (take_r)
+            value += w_rhs * A_data[r];
+          B_cols[out] = take_l ? A_cols[l] : A_cols[r];
+          B_data[out] = value;
+          ++out;
+          l += take_l;
+          r += take_r;
+        }
+        if (out != end)
+          throw std::invalid_argument{mismatch};
+      }
+    });
+  }
+} // namespace spectre
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "isa.h"
+#include "span.h"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+namespace spectre {
+  inline namespace SPECTRE_ISA {
+    // A growable array of trivial values, the scratch space of the kernels.
+    // Unlike `std::vector`, every member of it lives in the namespace of the
+    // ISA level, so the levels never share (and the linker never swaps) the
+    // out-of-line code growing it, see `isa.h`.
+    template <typename T> class buffer {
+      static_assert(std::is_trivially_copyable_v<T>);
+
+    public:
+      buffer() noexcept = default;
+
+      explicit buffer(std::size_t const size)
+      {
+        resize(size);
+      }
+
+      // Starts in the caller's `storage`, aligned for `T`, and only allocates
+      // once the values outgrow it. The storage must outlive the buffer.
+      explicit buffer(span<std::byte> const storage) noexcept
+          : _data{reinterpret_cast<T *>(storage.begin())},
+            _capacity{storage.size() / sizeof(T)}, _borrowed{true}
+      {}
+
+      buffer(buffer const &) = delete;
+      buffer &operator=(buffer const &) = delete;
+
+      ~buffer()
+      {
+        if (!_borrowed)
+          ::operator delete(_data);
+      }
+
+      T *begin() noexcept
+      {
+        return _data;
+      }
+
+      T *end() noexcept
+      {
+        return _data + _size;
+      }
+
+      T const *begin() const noexcept
+      {
+        return _data;
+      }
+
+      T const *end() const noexcept
+      {
+        return _data + _size;
+      }
+
+      T *data() noexcept
+      {
+        return _data;
+      }
+
+      T const *data() const noexcept
+      {
+        return _data;
+      }
+
+      std::size_t size() const noexcept
+      {
+        return _size;
+      }
+
+      std::size_t capacity() const noexcept
+      {
+        return _capacity;
+      }
+
+      bool empty() const noexcept
+      {
+        return _size == 0;
+      }
+
+      T &operator[](std::size_t const i) noexcept
+      {
+        assert(i < _size);
+        return _data[i];
+      }
+
+      T const &operator[](std::size_t const i) const noexcept
+      {
+        assert(i < _size);
+        return _data[i];
+      }
+
+      T &back() noexcept
+      {
+        assert(_size > 0);
+        return _data[_size - 1];
+      }
+
+      T const &back() const noexcept
+      {
+        assert(_size > 0);
+        return _data[_size - 1];
+      }
+
+      void reserve(std::size_t const capacity)
+      {
+        if (capacity <= _capacity)
+          return;
+
+        auto const data =
+            static_cast<T *>(::operator new(capacity * sizeof(T)));
+        if (_size)
+          std::memcpy(data, _data, _size * sizeof(T));
+        if (!_borrowed)
+          ::operator delete(_data);
+        _data = data;
+        _capacity = capacity;
+        _borrowed = false;
+      }
+
+      // The new values are zeros, like the value-initialized values of
+      // `std::vector::resize`
+      void resize(std::size_t const size)
+      {
+        resize(size, T{});
+      }
+
+      void resize(std::size_t const size, T const value)
+      {
+        reserve(size);
+        for (auto i = _size; i < size; ++i)
+          _data[i] = value;
+        _size = size;
+      }
+
+      template <typename It> void assign(It const first, It const last)
+      {
+        _size = 0;
+        reserve(static_cast<std::size_t>(std::distance(first, last)));
+        for (auto iter = first; iter != last; ++iter)
+          _data[_size++] = static_cast<T>(*iter);
+      }
+
+      void clear() noexcept
+      {
+        _size = 0;
+      }
+
+      void push_back(T const value)
+      {
+        if (_size == _capacity)
+          reserve(_capacity ? 2 * _capacity : 8);
+        _data[_size++] = value;
+      }
+
+      void pop_back() noexcept
+      {
+        assert(_size > 0);
+        --_size;
+      }
+
+      T *insert(T const *const pos, T const value)
+      {
+        auto const i = static_cast<std::size_t>(pos - _data);
+        assert(i <= _size);
+
+        if (_size == _capacity)
+          reserve(_capacity ? 2 * _capacity : 8);
+        std::memmove(_data + i + 1, _data + i, (_size - i) * sizeof(T));
+        _data[i] = value;
+        ++_size;
+        return _data + i;
+      }
+
+      T *erase(T const *const first, T const *const last) noexcept
+      {
+        auto const i = static_cast<std::size_t>(first - _data);
+        auto const j = static_cast<std::size_t>(last - _data);
+        assert(i <= j && j <= _size);
+
+        std::memmove(_data + i, _data + j, (_size - j) * sizeof(T));
+        _size -= j - i;
+        return _data + i;
+      }
+
+      T *erase(T const *const pos) noexcept
+      {
+        return erase(pos, pos + 1);
+      }
+
+    private:
+      T *_data = nullptr;
+      std::size_t _size = 0;
+      std::size_t _capacity = 0;
+      bool _borrowed = false;
+    };
+  } // namespace SPECTRE_ISA
+} // namespace spectre
@@ -1,43 +1,237 @@
 #pragma once
 
-#include "ranges.h"
+#include "parallel.h"
 #include "span.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
 
 namespace spectre {
-  template <typename I>
-  bool is_canonical_coo(cspan<I> const A_rows, cspan<I> const A_cols) noexcept
+  // Whether the adjacent pairs of `cols` are strictly ascending. The pairs are
+  // compared without branches in chunks, the first failing chunk stops it.
+  template <typename I> bool is_ascending(cspan<I> const cols) noexcept
   {
-    bool sorted = true;
-    for (auto const [i, j] : zip(adjacent(A_rows), adjacent(A_cols)))
-      sorted &= (std::get<0>(i) < std::get<1>(i)) |
-                ((std::get<0>(i) == std::get<1>(i)) &
-                 (std::get<0>(j) < std::get<1>(j)));
-    return sorted;
+    constexpr std::size_t chunk = 1024;
+    for (std::size_t a = 1; a < cols.size(); a += chunk) {
+      auto const b = std::min(cols.size(), a + chunk);
+      bool sorted = true;
+      for (auto i = a; i < b; ++i)
+        sorted &= cols[i - 1] < cols[i];
+      if (!sorted)
+        return false;
+    }
+    return true;
   }
 
+  // The checks run in parallel over blocks of rows (or of nonzeros of COO)
+  // and every block gives up as soon as any of them finds a violation
   template <typename I>
-  bool is_canonical_csr(cspan<I> const A_rows, cspan<I> const A_cols) noexcept
+  bool is_canonical_coo(cspan<I> const A_rows, cspan<I> const A_cols,
+                        unsigned const n_threads = 1)
   {
-    bool sorted = true;
-    for (auto const [a, b] : adjacent(A_rows))
-      for (auto const [u, v] : adjacent(A_cols.slice(a, b)))
-        sorted &= u < v;
-    return sorted;
+    auto const size = static_cast<std::ptrdiff_t>(A_rows.size());
+    if (size < 2)
+      return true;
+
+    std::atomic<bool> canonical{true};
+    parallel_for(size - 1, 1 << 16, n_threads, [&](auto const a, auto const b) {
+      constexpr std::ptrdiff_t chunk = 1024;
+      for (auto c = a; c < b; c += chunk) {
+        if (!canonical.load(std::memory_order_relaxed))
+          return;
+
+        bool sorted = true;
+        for (auto i = c, d = std::min(b, c + chunk); i < d; ++i)
+          sorted &= (A_rows[i] < A_rows[i + 1]) |
+                    ((A_rows[i] == A_rows[i + 1]) & (A_cols[i] < A_cols[i + 1]));
+        if (!sorted) {
+          canonical.store(false, std::memory_order_relaxed);
+          return;
+        }
+      }
+    });
+    return canonical;
   }
 
   template <typename I>
-  auto canonical_alloc_csr(cspan<I> const A_rows, cspan<I> const A_cols,
-                           span<I> const B_rows) noexcept
+  bool is_canonical_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                        unsigned const n_threads = 1)
   {
-    auto size = static_cast<I>(0);
-    auto iter = B_rows.begin();
+    auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+    if (n_rows < 1)
+      return true;
+
+    std::atomic<bool> canonical{true};
+    parallel_for(n_rows, 4096, n_threads, [&](auto const a, auto const b) {
+      for (auto row = a; row < b; ++row) {
+        if (!canonical.load(std::memory_order_relaxed))
+          return;
+        if (!is_ascending(A_cols.slice(A_rows[row], A_rows[row + 1]))) {
+          canonical.store(false, std::memory_order_relaxed);
+          return;
+        }
+      }
+    });
+    return canonical;
+  }
+
+  // How `canonicalize_csr` merges the values of duplicate indices
+  enum duplicate_op : int { duplicate_sum, duplicate_max, duplicate_min };
+
+  // Sorts the indices of one row along with their values. A nearly sorted row
+  // (a few descents) costs little to an insertion sort, any other row is
+  // sorted by a stable LSD radix sort over the bytes of its largest index.
+  template <typename I, typename D> class row_sorter {
+  public:
+    void sort(span<I> const cols, span<D> const data)
+    {
+      auto const n = cols.size();
+      std::size_t descents = 0;
+      for (std::size_t i = 1; i < n; ++i)
+        descents += cols[i] < cols[i - 1];
+
+      if (descents == 0)
+        return;
+      if (n <= 64 || descents * 32 <= n)
+        insertion_sort(cols, data);
+      else
+        radix_sort(cols, data);
+    }
+
+  private:
+    using key_t = std::make_unsigned_t<I>;
+
+    // flips the sign bit, so the negative indices come first
+    static constexpr key_t sign =
+        std::is_signed_v<I> ? key_t{1} << (8 * sizeof(I) - 1) : key_t{0};
+
+    static void insertion_sort(span<I> const cols, span<D> const data)
+    {
+      for (std::size_t i = 1; i < cols.size(); ++i) {
+        auto const col = cols[i];
+        auto const value = data[i];
+        auto j = i;
+        for (; j > 0 && col < cols[j - 1]; --j) {
+          cols[j] = cols[j - 1];
+          data[j] = data[j - 1];
+        }
+        cols[j] = col;
+        data[j] = value;
+      }
+    }
+
+    void radix_sort(span<I> const cols, span<D> const data)
+    {
+      auto const n = cols.size();
+      key_t mask = 0;
+      _keys.resize(2 * n);
+      _values.resize(2 * n);
+      for (std::size_t i = 0; i < n; ++i) {
+        _keys[i] = static_cast<key_t>(static_cast<key_t>(cols[i]) ^ sign);
+        _values[i] = data[i];
+        mask |= _keys[i] ^ _keys[0];
+      }
 
-    *iter++ = size;
-    for (auto const [a, b] : adjacent(A_rows)) {
-      for (auto const [u, v] : adjacent(A_cols.slice(a, b)))
-        size += u != v;
-      *iter++ = size;
+      // only the bytes in which the keys differ need a pass
+      auto src = std::size_t{0};
+      for (std::size_t shift = 0; shift < 8 * sizeof(I); shift += 8) {
+        if (((mask >> shift) & 0xff) == 0)
+          continue;
+
+        std::size_t counts[257] = {};
+        for (std::size_t i = 0; i < n; ++i)
+          ++counts[((_keys[src + i] >> shift) & 0xff) + 1];
+        for (std::size_t d = 1; d < 257; ++d)
+          counts[d] += counts[d - 1];
+
+        auto const dst = n - src;
+        for (std::size_t i = 0; i < n; ++i) {
+          auto const at = dst + counts[(_keys[src + i] >> shift) & 0xff]++;
+          _keys[at] = _keys[src + i];
+          _values[at] = _values[src + i];
+        }
+        src = dst;
+      }
+
+      for (std::size_t i = 0; i < n; ++i) {
+        cols[i] = static_cast<I>(_keys[src + i] ^ sign);
+        data[i] = _values[src + i];
+      }
+    }
+
+    std::vector<key_t> _keys;
+    std::vector<D> _values;
+  };
+
+  // Merges the adjacent duplicates of a sorted row to its front, returns the
+  // number of the distinct indices
+  template <typename I, typename D>
+  std::size_t merge_duplicates(span<I> const cols, span<D> const data,
+                               duplicate_op const op) noexcept
+  {
+    if (cols.size() == 0)
+      return 0;
+
+    std::size_t out = 0;
+    for (std::size_t i = 1; i < cols.size(); ++i) {
+      if (cols[i] != cols[out]) {
+        ++out;
+        cols[out] = cols[i];
+        data[out] = data[i];
+      } else if (op == duplicate_sum) {
+        data[out] += data[i];
+      } else if (op == duplicate_max) {
+        data[out] = std::max(data[out], data[i]);
+      } else {
+        data[out] = std::min(data[out], data[i]);
+      }
+    }
+    return out + 1;
+  }
+
+  // Sorts the indices of every row and merges the values of the duplicates by
+  // `op`, in place and in parallel over blocks of rows. The rows are then
+  // moved to close the gaps left by the duplicates and the row offsets are
+  // updated, the new number of the nonzeros is returned.
+  template <typename I, typename D>
+  I canonicalize_csr(span<I> const A_rows, span<I> const A_cols,
+                     span<D> const A_data, duplicate_op const op,
+                     unsigned const n_threads = 1)
+  {
+    auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+    if (n_rows < 0)
+      return 0;
+
+    std::vector<I> sizes(static_cast<std::size_t>(n_rows));
+    parallel_for(n_rows, 1024, n_threads, [&](auto const a, auto const b) {
+      row_sorter<I, D> sorter;
+      for (auto row = a; row < b; ++row) {
+        auto const begin = static_cast<std::size_t>(A_rows[row]);
+        auto const end = static_cast<std::size_t>(A_rows[row + 1]);
+        auto const cols = A_cols.slice(begin, end);
+        auto const data = A_data.slice(begin, end);
+
+        sorter.sort(cols, data);
+        sizes[row] = static_cast<I>(merge_duplicates(cols, data, op));
+      }
+    });
+
+    // the rows only move towards the front, so the moves in order are safe
+    auto size = static_cast<I>(0);
+    for (std::ptrdiff_t row = 0; row < n_rows; ++row) {
+      auto const begin = A_rows[row];
+      if (begin != size) {
+        std::copy(A_cols.begin() + begin, A_cols.begin() + begin + sizes[row],
+                  A_cols.begin() + size);
+        std::copy(A_data.begin() + begin, A_data.begin() + begin + sizes[row],
+                  A_data.begin() + size);
+      }
+      A_rows[row] = size;
+      size += sizes[row];
     }
+    A_rows[n_rows] = size;
     return size;
   }
 } // namespace spectre
@@ -2,43 +2,35 @@
 
 #include "span.h"
 #include <algorithm>
+#include <numeric>
 
 namespace spectre {
+  // Transposes the compressed layout, i.e. converts a CSR matrix to the CSC
+  // matrix of the same values, `B_cols` holds the `n_cols + 1` column offsets
+  // and `B_rows` the row index of each value. The rows within each column
+  // come out sorted.
   template <typename I, typename D>
   void csr_to_csc(cspan<I> A_rows, cspan<I> A_cols, cspan<D> A_data,
                   span<I> B_rows, span<I> B_cols, span<D> B_data,
                   I const A_n_rows) noexcept
   {
-    // histogram
+    // histogram of the columns, shifted by one
     std::fill(std::begin(B_cols), std::end(B_cols), 0);
-    for (auto const index : A_cols) {
-      ++B_cols[index];
-    }
+    for (auto const col : A_cols)
+      ++B_cols[col + 1];
 
-    // exclusive scan
-    I acc = 0;
-    for (auto &pointer : A_cols) {
-      auto tmp = pointer;
-      pointer = acc;
-      acc += tmp;
-    }
+    // the start of each column
+    std::partial_sum(B_cols.begin(), B_cols.end(), B_cols.begin());
 
     for (I row = 0; row < A_n_rows; ++row) {
-      auto const row_beg = A_rows[row];
-      auto const row_end = A_rows[row + 1];
-
-      for (auto i = row_beg; i < row_end; ++i) {
-        auto col = A_cols[i];
-        auto dst = B_cols[i];
-
+      for (auto i = A_rows[row]; i < A_rows[row + 1]; ++i) {
+        auto const dst = B_cols[A_cols[i]]++;
         B_rows[dst] = row;
         B_data[dst] = A_data[i];
-
-        B_cols[col]++;
       }
     }
 
-    // shift one right
+    // every start has moved to the end of its column, i.e. to the next start
     std::copy_backward(B_cols.begin(), B_cols.end() - 1, B_cols.end());
     B_cols[0] = 0;
   }
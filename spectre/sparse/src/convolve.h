@@ -1,59 +1,129 @@
 #pragma once
 
+#include "buffer.h"
+#include "isa.h"
 #include "ranges.h"
 #include "span.h"
+#include <algorithm>
+#include <cstddef>
 
 namespace spectre {
-  template <typename I, typename J, typename D>
-  void convolve_csr_dv(cspan<I> const A_rows, cspan<I> const A_cols,
-                       cspan<D> const A_data, cspan<D> const coeffs,
-                       span<J> B_cols, span<D> B_data, I const A_n_cols) noexcept
-  {
-    auto const window = static_cast<J>(coeffs.size());
-    auto const wnd_lhs = (window - 1) / 2;
-
-    auto out_col = B_cols.begin();
-    auto out_val = B_data.begin();
-
-    for (auto const [a, b] : adjacent(A_rows)) {
-      auto const cols = A_cols.slice(a, b);
-      auto const data = A_data.slice(a, b);
-
-      auto start = -wnd_lhs;
-      auto stop = A_n_cols - wnd_lhs;
-      auto col_iter = cols.begin();
-      auto val_iter = data.begin();
-
-      while (start < stop && col_iter < cols.end()) {
-        start = std::max(start, *col_iter - window + 1);
-
-        auto value = static_cast<D>(0);
-        auto krn_col_iter = col_iter;
-        auto krn_val_iter = val_iter;
-        auto coeff_iter = std::make_reverse_iterator(coeffs.end());
-
-        for (auto index = start; index < start + window;
-             ++index, ++coeff_iter) {
-          if (krn_col_iter < cols.end() && index == *krn_col_iter) {
-            value += (*coeff_iter) * (*krn_val_iter);
-            ++krn_col_iter;
-            ++krn_val_iter;
+  inline namespace SPECTRE_ISA {
+    // Only the nonzeros within each window contribute, so an output costs
+    // O(nonzeros in its window) rather than O(window)
+    template <typename I, typename J, typename D>
+    void convolve_csr_dv(cspan<I> const A_rows, cspan<I> const A_cols,
+                         cspan<D> const A_data, cspan<D> const coeffs,
+                         span<J> B_cols, span<D> B_data,
+                         I const A_n_cols) noexcept
+    {
+      auto const window = static_cast<J>(coeffs.size());
+      auto const wnd_lhs = (window - 1) / 2;
+
+      auto out_col = B_cols.begin();
+      auto out_val = B_data.begin();
+
+      for (auto const [a, b] : adjacent(A_rows)) {
+        auto const cols = A_cols.slice(a, b);
+        auto const data = A_data.slice(a, b);
+
+        auto start = -wnd_lhs;
+        auto stop = A_n_cols - wnd_lhs;
+        auto col_iter = cols.begin();
+        auto val_iter = data.begin();
+
+        while (start < stop && col_iter < cols.end()) {
+          start = std::max(start, *col_iter - window + 1);
+
+          auto value = static_cast<D>(0);
+          auto krn_val_iter = val_iter;
+          for (auto krn_col_iter = col_iter;
+               krn_col_iter < cols.end() && *krn_col_iter < start + window;
+               ++krn_col_iter, ++krn_val_iter)
+            value += coeffs[window - 1 - (*krn_col_iter - start)] *
+                     (*krn_val_iter);
+
+          assert(out_col < B_cols.end());
+          assert(out_val < B_data.end());
+          assert(0 <= start + wnd_lhs);
+          assert(start + wnd_lhs < A_n_cols);
+
+          *out_col++ = start + wnd_lhs;
+          *out_val++ = value;
+
+          if (++start > *col_iter) {
+            ++col_iter;
+            ++val_iter;
           }
         }
+      }
+    }
 
-        assert(out_col < B_cols.end());
-        assert(out_val < B_data.end());
-        assert(0 <= start + wnd_lhs);
-        assert(start + wnd_lhs < A_n_cols);
+    // Convolves every row with `n_outputs` kernels at once, e.g. a smoothing
+    // and its derivatives. The `coeffs` hold the kernels one after another and
+    // the output positions are shared, so `B_cols` is written once while the
+    // values of the k-th kernel go to `B_data[k * B_cols.size() + i]`.
+    template <typename I, typename J, typename D>
+    void convolve_csr_dm(cspan<I> const A_rows, cspan<I> const A_cols,
+                         cspan<D> const A_data, cspan<D> const coeffs,
+                         J const n_outputs, span<J> B_cols, span<D> B_data,
+                         I const A_n_cols)
+    {
+      auto const n_out = static_cast<std::size_t>(n_outputs);
+      auto const window = static_cast<J>(coeffs.size() / n_out);
+      auto const wnd_lhs = (window - 1) / 2;
+      auto const size = B_cols.size();
 
-        *out_col++ = start + wnd_lhs;
-        *out_val++ = value;
+      assert(coeffs.size() == n_out * static_cast<std::size_t>(window));
+      assert(B_data.size() == n_out * size);
 
-        if (++start > *col_iter) {
-          ++col_iter;
-          ++val_iter;
+      // reversed and interleaved, i.e. the coefficients of all kernels for a
+      // given offset in the window are adjacent
+      buffer<D> weights(coeffs.size());
+      for (std::size_t k = 0; k < n_out; ++k)
+        for (std::size_t c = 0; c < static_cast<std::size_t>(window); ++c)
+          weights[(window - 1 - c) * n_out + k] = coeffs[k * window + c];
+
+      buffer<D> values(n_out);
+      std::size_t out = 0;
+
+      for (auto const [a, b] : adjacent(A_rows)) {
+        auto const cols = A_cols.slice(a, b);
+        auto const data = A_data.slice(a, b);
+
+        auto start = -wnd_lhs;
+        auto stop = A_n_cols - wnd_lhs;
+        auto col_iter = cols.begin();
+        auto val_iter = data.begin();
+
+        while (start < stop && col_iter < cols.end()) {
+          start = std::max(start, *col_iter - window + 1);
+
+          std::fill(values.begin(), values.end(), static_cast<D>(0));
+          auto krn_val_iter = val_iter;
+          for (auto krn_col_iter = col_iter;
+               krn_col_iter < cols.end() && *krn_col_iter < start + window;
+               ++krn_col_iter, ++krn_val_iter) {
+            auto const w = weights.data() + (*krn_col_iter - start) * n_out;
+            for (std::size_t k = 0; k < n_out; ++k)
+              values[k] += w[k] * (*krn_val_iter);
+          }
+
+          assert(out < size);
+          assert(0 <= start + wnd_lhs);
+          assert(start + wnd_lhs < A_n_cols);
+
+          B_cols[out] = start + wnd_lhs;
+          for (std::size_t k = 0; k < n_out; ++k)
+            B_data[k * size + out] = values[k];
+          ++out;
+
+          if (++start > *col_iter) {
+            ++col_iter;
+            ++val_iter;
+          }
         }
       }
     }
-  }
+  } // namespace SPECTRE_ISA
 } // namespace spectre
\ No newline at end of file
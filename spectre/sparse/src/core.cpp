@@ -0,0 +1,61 @@
+#include "core.h"
+#include <cstdlib>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace spectre {
+  namespace {
+    // The levels from the newest, only the baseline is built unless the hot
+    // kernels are multiversioned (see CMakeLists.txt)
+    isa_level const isa_levels[] = {
+#ifdef SPECTRE_MULTIVERSION
+        {"avx512", avx512::kernels,
+         [] {
+           return __builtin_cpu_supports("avx512f") &&
+                  __builtin_cpu_supports("avx512bw") &&
+                  __builtin_cpu_supports("avx512dq") &&
+                  __builtin_cpu_supports("avx512vl") &&
+                  __builtin_cpu_supports("avx2") &&
+                  __builtin_cpu_supports("fma");
+         }},
+        {"avx2", avx2::kernels,
+         [] {
+           return __builtin_cpu_supports("avx2") &&
+                  __builtin_cpu_supports("fma");
+         }},
+        {"sse42", sse42::kernels,
+         [] {
+           return __builtin_cpu_supports("sse4.2") &&
+                  __builtin_cpu_supports("popcnt");
+         }},
+#endif
+        {"baseline", baseline::kernels, [] { return true; }},
+    };
+  } // namespace
+
+  isa_level const &select_isa()
+  {
+#ifdef SPECTRE_MULTIVERSION
+    __builtin_cpu_init();
+#endif
+
+    if (auto const forced = std::getenv("SPECTRE_ISA"); forced && *forced) {
+      for (auto const &level : isa_levels) {
+        if (std::string{forced} != level.name)
+          continue;
+        if (!level.supported())
+          throw std::runtime_error{std::string{"SPECTRE_ISA="} + forced +
+                                   " is not supported by this CPU"};
+        return level;
+      }
+      throw std::runtime_error{std::string{"SPECTRE_ISA="} + forced +
+                               " is not built into this library"};
+    }
+
+    for (auto const &level : isa_levels)
+      if (level.supported())
+        return level;
+    return isa_levels[std::size(isa_levels) - 1];
+  }
+} // namespace spectre
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "kernels.h"
+
+namespace spectre {
+  // An instruction set level the hot kernels are built for
+  struct isa_level {
+    char const *name;
+    kernel_tables const &(*kernels)() noexcept;
+    bool (*supported)();
+  };
+
+  // Selects the newest level supported by the CPU, the environment variable
+  // `SPECTRE_ISA` forces a level instead (e.g. for benchmarking). Throws
+  // `std::runtime_error` if the forced level is not supported or not built.
+  isa_level const &select_isa();
+} // namespace spectre
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "buffer.h"
+#include "isa.h"
+#include "rolling.h"
+#include "span.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// The kernels of the dense majors of a hybrid matrix, see `hybrid.h`. Each
+// takes a run of majors stored one after another, `n_minor` values each. The
+// windows are padded with zeros beyond the ends of a major, exactly like the
+// sparse kernels see them, so every output equals the sparse output at the
+// same position or zero where the sparse kernel has no output.
+namespace spectre {
+  inline namespace SPECTRE_ISA {
+    // Copies `x` into `out` between `lhs` zeros before and `rhs` zeros after
+    template <typename D>
+    void pad_zeros(cspan<D> const x, std::ptrdiff_t const lhs,
+                   std::ptrdiff_t const rhs, buffer<D> &out)
+    {
+      out.clear();
+      out.resize(static_cast<std::size_t>(lhs + rhs) + x.size());
+      std::copy(x.begin(), x.end(), out.begin() + lhs);
+    }
+
+    // The rolling `op` of an associative operation by van Herk and Gil-Werman:
+    // `x` is split into blocks of `window` values, then every window is the
+    // suffix of one block and the prefix of the next, so an output costs three
+    // applications of `op` whatever the window and the combining loop has no
+    // dependency between its iterations.
+    template <typename D, typename Op>
+    void rolling_blocks(cspan<D> const x, span<D> const y,
+                        std::ptrdiff_t const window, Op const op,
+                        buffer<D> &prefix, buffer<D> &suffix)
+    {
+      auto const size = static_cast<std::ptrdiff_t>(x.size());
+      prefix.resize(x.size());
+      suffix.resize(x.size());
+
+      for (std::ptrdiff_t a = 0; a < size; a += window) {
+        auto const b = std::min(size, a + window);
+        prefix[a] = x[a];
+        for (auto i = a + 1; i < b; ++i)
+          prefix[i] = op(prefix[i - 1], x[i]);
+        suffix[b - 1] = x[b - 1];
+        for (auto i = b - 2; i >= a; --i)
+          suffix[i] = op(x[i], suffix[i + 1]);
+      }
+
+      auto const n = static_cast<std::ptrdiff_t>(y.size());
+      auto const pre = prefix.data() + window - 1;
+      auto const suf = suffix.data();
+      auto const out = y.begin();
+      for (std::ptrdiff_t a = 0; a < n; a += window) {
+        out[a] = suf[a];
+        auto const b = std::min(n, a + window);
+        for (auto i = a + 1; i < b; ++i)
+          out[i] = op(suf[i], pre[i]);
+      }
+    }
+
+    template <typename D, rolling_op Op>
+    void rolling_dense(cspan<D> const A, span<D> const B,
+                       std::ptrdiff_t const n_minor,
+                       std::ptrdiff_t const window)
+    {
+      auto const lhs = (window - 1) / 2;
+      auto const rhs = window - 1 - lhs;
+      auto const n = static_cast<std::size_t>(n_minor);
+
+      buffer<D> padded;
+      buffer<D> prefix;
+      buffer<D> suffix;
+
+      for (std::size_t a = 0; a < A.size(); a += n) {
+        auto const x = A.slice(a, a + n);
+        auto const y = B.slice(a, a + n);
+
+        if constexpr (Op == rolling_median) {
+          auto kernel = median_kernel<std::ptrdiff_t, D>{window};
+          auto const at = [&](std::ptrdiff_t const i) {
+            return i < lhs || i >= lhs + n_minor ? static_cast<D>(0)
+                                                 : x[i - lhs];
+          };
+          auto const push = [&](D const value) {
+            value == 0 ? kernel.push_zeros(1) : kernel.push(value);
+          };
+          auto const pop = [&](D const value) {
+            value == 0 ? kernel.pop_zeros(1) : kernel.pop(value);
+          };
+
+          kernel.init();
+          for (std::ptrdiff_t i = 0; i < window - 1; ++i)
+            push(at(i));
+          for (std::ptrdiff_t i = 0; i < n_minor; ++i) {
+            push(at(i + window - 1));
+            y[i] = kernel.result();
+            pop(at(i));
+          }
+        } else {
+          pad_zeros(x, lhs, rhs, padded);
+          if constexpr (Op == rolling_count)
+            for (auto &value : padded)
+              value = static_cast<D>(value != 0);
+
+          auto const source = cspan<D>{padded.data(), padded.size()};
+          if constexpr (Op == rolling_min)
+            rolling_blocks(
+                source, y, window,
+                [](D const u, D const v) { return v < u ? v : u; }, prefix,
+                suffix);
+          else if constexpr (Op == rolling_max)
+            rolling_blocks(
+                source, y, window,
+                [](D const u, D const v) { return u < v ? v : u; }, prefix,
+                suffix);
+          else
+            rolling_blocks(
+                source, y, window, [](D const u, D const v) { return u + v; },
+                prefix, suffix);
+
+          if constexpr (Op == rolling_mean)
+            for (auto &value : y)
+              value /= static_cast<D>(window);
+        }
+      }
+    }
+
+    // Accumulates the products of one coefficient with the whole major at a
+    // time, i.e. a vectorizable AXPY per coefficient, in the order of
+    // `convolve_csr_dv`
+    template <typename D>
+    void convolve_dense(cspan<D> const A, cspan<D> const coeffs,
+                        span<D> const B, std::ptrdiff_t const n_minor)
+    {
+      auto const window = static_cast<std::ptrdiff_t>(coeffs.size());
+      auto const lhs = (window - 1) / 2;
+      auto const n = static_cast<std::size_t>(n_minor);
+
+      buffer<D> padded;
+      for (std::size_t a = 0; a < A.size(); a += n) {
+        pad_zeros(A.slice(a, a + n), lhs, window - 1 - lhs, padded);
+
+        auto const out = B.begin() + a;
+        std::fill(out, out + n, static_cast<D>(0));
+        for (std::ptrdiff_t k = 0; k < window; ++k) {
+          auto const c = coeffs[static_cast<std::size_t>(window - 1 - k)];
+          auto const in = padded.data() + k;
+          for (std::size_t i = 0; i < n; ++i)
+            out[i] += c * in[i];
+        }
+      }
+    }
+
+    // The sums run in independent lanes so that they vectorize
+    template <typename D>
+    void stdev_dense(cspan<D> const A, std::ptrdiff_t const n_minor,
+                     span<D> const result) noexcept
+    {
+      constexpr std::size_t lanes = 8;
+      auto const n = static_cast<std::size_t>(n_minor);
+
+      for (std::size_t a = 0, major = 0; a < A.size(); a += n, ++major) {
+        auto const x = A.begin() + a;
+        D sum[lanes] = {};
+        D sum2[lanes] = {};
+
+        std::size_t i = 0;
+        for (; i + lanes <= n; i += lanes)
+          for (std::size_t l = 0; l < lanes; ++l) {
+            sum[l] += x[i + l];
+            sum2[l] += x[i + l] * x[i + l];
+          }
+        for (; i < n; ++i) {
+          sum[0] += x[i];
+          sum2[0] += x[i] * x[i];
+        }
+        for (std::size_t l = 1; l < lanes; ++l) {
+          sum[0] += sum[l];
+          sum2[0] += sum2[l];
+        }
+
+        auto const mean = sum[0] / static_cast<D>(n_minor);
+        auto const var = sum2[0] / static_cast<D>(n_minor) - (mean * mean);
+        result[major] = std::sqrt(std::max(var, static_cast<D>(0)));
+      }
+    }
+
+    // `maxclip_csr_spmat_plus_dvec_nonnegative` of dense majors of `A` and
+    // `B`, where `C_data` holds one value per major of the run
+    template <typename D>
+    void maxclip_dense(span<D> const A, cspan<D> const B,
+                       cspan<D> const C_data,
+                       std::ptrdiff_t const n_minor) noexcept
+    {
+      auto const n = static_cast<std::size_t>(n_minor);
+      for (std::size_t a = 0, major = 0; a < A.size(); a += n, ++major) {
+        auto const c = C_data[major];
+        auto const x = A.begin() + a;
+        auto const y = B.begin() + a;
+        for (std::size_t i = 0; i < n; ++i) {
+          auto const max_val = y[i] + c;
+          x[i] = x[i] > max_val ? max_val : x[i];
+        }
+      }
+    }
+  } // namespace SPECTRE_ISA
+} // namespace spectre
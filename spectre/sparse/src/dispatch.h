@@ -0,0 +1,192 @@
+#pragma once
+
+#include "kernels.h"
+#include "python.h"
+#include "span.h"
+#include <pybind11/pybind11.h>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace spectre {
+  template <typename T> struct type_tag {
+    using type = T;
+  };
+
+  template <typename Tag> using type_of = typename Tag::type;
+
+  template <typename... Ts>
+  int find_type(type_list<Ts...>, int const typenum) noexcept
+  {
+    int index = 0;
+    for (bool const match : {PyArray_EquivTypenums(typenum,
+                                                   py_dtype<Ts>::value)...}) {
+      if (match)
+        return index;
+      ++index;
+    }
+    return -1;
+  }
+
+  // Calls `func(type_tag<T>{})` for the `index`-th type of the list through a
+  // table of instantiations generated at compile time.
+  template <typename... Ts, typename F>
+  decltype(auto) visit_type(type_list<Ts...>, int const index, F &func)
+  {
+    using first_t = std::tuple_element_t<0, std::tuple<Ts...>>;
+    using result_t = decltype(func(type_tag<first_t>{}));
+    using entry_t = result_t (*)(F &);
+
+    static constexpr entry_t table[] = {
+        [](F &f) -> result_t { return f(type_tag<Ts>{}); }...};
+
+    assert(0 <= index && index < static_cast<int>(sizeof...(Ts)));
+    return table[index](func);
+  }
+
+  template <typename L> struct dtype_arg {
+    int typenum;
+    char const *name;
+
+    int index() const
+    {
+      auto const result = find_type(L{}, typenum);
+      if (result < 0)
+        throw pybind11::type_error{std::string{"unsupported dtype of the "
+                                               "argument '"} +
+                                   name + "'"};
+      return result;
+    }
+  };
+
+  // The dtype of an array argument selecting a type from the list `L`
+  template <typename L>
+  dtype_arg<L> dtype_of(pybind11::handle const op, char const *const name)
+  {
+    if (!PyArray_Check(op.ptr()))
+      throw pybind11::type_error{std::string{"the argument '"} + name +
+                                 "' must be a numpy.ndarray"};
+    auto const arr = reinterpret_cast<PyArrayObject *>(op.ptr());
+    return dtype_arg<L>{PyArray_TYPE(arr), name};
+  }
+
+  // The dtype given as a `numpy.dtype` or anything convertible to it
+  template <typename L>
+  dtype_arg<L> dtype_from(pybind11::handle const dtype, char const *const name)
+  {
+    PyArray_Descr *descr = nullptr;
+    if (!PyArray_DescrConverter(dtype.ptr(), &descr))
+      throw pybind11::error_already_set{};
+    auto const typenum = descr->type_num;
+    Py_DECREF(descr);
+    return dtype_arg<L>{typenum, name};
+  }
+
+  template <typename F> decltype(auto) dispatch(F &&func)
+  {
+    return func();
+  }
+
+  // Calls `func(type_tag<T1>{}, type_tag<T2>{}, ...)` with the types selected
+  // by the dtypes of the arguments, each dtype is inspected exactly once.
+  template <typename F, typename L, typename... Ls>
+  decltype(auto) dispatch(F &&func, dtype_arg<L> const arg,
+                          dtype_arg<Ls> const... args)
+  {
+    auto visitor = [&](auto tag) -> decltype(auto) {
+      return dispatch(
+          [&](auto... tags) -> decltype(auto) { return func(tag, tags...); },
+          args...);
+    };
+    return visit_type(L{}, arg.index(), visitor);
+  }
+
+  // Views the array arguments of a kernel as spans. An array of a wrong dtype
+  // or layout is rejected, unless `copy` is set and the kernel only reads it,
+  // then it is converted and the copy is kept alive by the pack. Read-only
+  // views are accepted as they are, and so are strided ones by `get_strided`.
+  struct py_args {
+    explicit py_args(bool const copy) noexcept : _copy{copy}
+    {}
+
+    template <typename T>
+    span<T> get(pybind11::handle const op, char const *const name)
+    {
+      using value_t = std::remove_const_t<T>;
+      constexpr auto dtype = py_dtype<value_t>::value;
+      constexpr auto flags =
+          std::is_const_v<T> ? NPY_ARRAY_IN_ARRAY : NPY_ARRAY_OUT_ARRAY;
+
+      auto arr = reinterpret_cast<PyArrayObject *>(op.ptr());
+      auto const valid = PyArray_Check(op.ptr()) && PyArray_NDIM(arr) == 1 &&
+                         PyArray_EquivTypenums(PyArray_TYPE(arr), dtype) &&
+                         PyArray_CHKFLAGS(arr, flags);
+
+      if (!valid) {
+        if (!std::is_const_v<T> || !_copy)
+          throw pybind11::type_error{describe<T>(op, name)};
+
+        auto const type = PyArray_DescrFromType(dtype);
+        auto const tmp = PyArray_FromAny(op.ptr(), type, 1, 1,
+                                         flags | NPY_ARRAY_FORCECAST, nullptr);
+        if (!tmp)
+          throw pybind11::error_already_set{};
+        _temps.push_back(pybind11::reinterpret_steal<pybind11::object>(tmp));
+        arr = reinterpret_cast<PyArrayObject *>(tmp);
+      }
+
+      return span<T>{static_cast<T *>(PyArray_DATA(arr)),
+                     static_cast<std::size_t>(PyArray_SIZE(arr))};
+    }
+
+    // Views a read-only argument of a kernel that only iterates over it, a
+    // 1-d array of the dtype is read in place whatever its strides
+    template <typename T>
+    strided_span<T> get_strided(pybind11::handle const op,
+                                char const *const name)
+    {
+      static_assert(std::is_const_v<T>, "a strided view is read-only");
+      constexpr auto dtype = py_dtype<std::remove_const_t<T>>::value;
+      constexpr auto size = static_cast<npy_intp>(sizeof(T));
+
+      auto const arr = reinterpret_cast<PyArrayObject *>(op.ptr());
+      if (PyArray_Check(op.ptr()) && PyArray_NDIM(arr) == 1 &&
+          PyArray_EquivTypenums(PyArray_TYPE(arr), dtype) &&
+          PyArray_ISALIGNED(arr) && PyArray_STRIDE(arr, 0) % size == 0)
+        return strided_span<T>{static_cast<T *>(PyArray_DATA(arr)),
+                               static_cast<std::size_t>(PyArray_SIZE(arr)),
+                               PyArray_STRIDE(arr, 0) / size};
+      return get<T>(op, name);
+    }
+
+  private:
+    template <typename T>
+    static std::string describe(pybind11::handle const op,
+                                char const *const name)
+    {
+      using value_t = std::remove_const_t<T>;
+
+      auto message = std::string{"the argument '"} + name +
+                     "' must be a contiguous 1-d " +
+                     (std::is_const_v<T> ? "" : "writeable ") + "array of " +
+                     py_dtype<value_t>::name + ", got ";
+      if (!PyArray_Check(op.ptr()))
+        return message + pybind11::str(op.get_type()).cast<std::string>();
+
+      auto const arr = reinterpret_cast<PyArrayObject *>(op.ptr());
+      message += std::to_string(PyArray_NDIM(arr)) + "-d " +
+                 pybind11::str(op.attr("dtype")).cast<std::string>();
+      if (!PyArray_ISCARRAY_RO(arr))
+        message += " (non-contiguous)";
+      else if (!std::is_const_v<T> && !PyArray_ISWRITEABLE(arr))
+        message += " (read-only)";
+      if (std::is_const_v<T>)
+        message += "; pass copy=True to allow a conversion";
+      return message;
+    }
+
+    std::vector<pybind11::object> _temps;
+    bool _copy;
+  };
+} // namespace spectre
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "kernels.h"
+#include "parallel.h"
+#include "span.h"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace spectre {
+  // A compressed matrix whose busiest majors are stored densely. The majors
+  // listed in the ascending `dense_majors` are empty in the compressed arrays
+  // and hold `n_minor` values each in `dense`, in the order of the list.
+  template <typename I, typename D> struct hybrid_span {
+    span<I> pointers;
+    span<I> indices;
+    span<D> data;
+    span<D> dense;
+  };
+
+  // Splits the majors `[a, b)` into runs of the sparse and of the dense ones,
+  // calling `sparse(a, b)` or `dense(a, b, k)` for each run in order, where
+  // the k-th dense major is the first one of the run
+  template <typename I, typename S, typename F>
+  void hybrid_runs(cspan<I> const dense_majors, std::ptrdiff_t a,
+                   std::ptrdiff_t const b, S &&sparse, F &&dense)
+  {
+    auto const n_dense = static_cast<std::ptrdiff_t>(dense_majors.size());
+    auto k = std::lower_bound(dense_majors.begin(), dense_majors.end(), a,
+                              [](I const major, std::ptrdiff_t const value) {
+                                return static_cast<std::ptrdiff_t>(major) <
+                                       value;
+                              }) -
+             dense_majors.begin();
+
+    while (a < b) {
+      auto const next =
+          k < n_dense ? std::min<std::ptrdiff_t>(b, dense_majors[k]) : b;
+      if (a < next) {
+        sparse(a, next);
+        a = next;
+        continue;
+      }
+
+      auto const first = k;
+      while (k < n_dense && a < b &&
+             static_cast<std::ptrdiff_t>(dense_majors[k]) == a) {
+        ++k;
+        ++a;
+      }
+      dense(a - (k - first), a, first);
+    }
+  }
+
+  template <typename I, typename D, typename M>
+  void check_hybrid(hybrid_span<I, D> const A, cspan<M> const dense_majors,
+                    std::ptrdiff_t const n_minor, char const *const name)
+  {
+    auto const n_major = static_cast<std::ptrdiff_t>(A.pointers.size()) - 1;
+    if (n_major < 0 || A.indices.size() != A.data.size() ||
+        A.data.size() < static_cast<std::size_t>(A.pointers[n_major]))
+      throw std::invalid_argument{std::string{"the sparse arrays of "} + name +
+                                  " do not match"};
+    if (A.dense.size() != dense_majors.size() * static_cast<std::size_t>(
+                                                    n_minor))
+      throw std::invalid_argument{std::string{"the dense values of "} + name +
+                                  " do not match the dense majors"};
+
+    std::ptrdiff_t last = -1;
+    for (auto const major : dense_majors) {
+      auto const m = static_cast<std::ptrdiff_t>(major);
+      if (m <= last || m >= n_major || A.pointers[m] != A.pointers[m + 1])
+        throw std::invalid_argument{
+            std::string{"the dense majors of "} + name +
+            " must be ascending, unique and empty in the sparse arrays"};
+      last = m;
+    }
+  }
+
+  // Runs the rolling `op` of every major of `A` into `B`, whose sparse
+  // structure was computed by `rolling_alloc_csr` and whose dense majors are
+  // those of `A`. The sparse and the dense majors are dispatched to the sparse
+  // and the dense kernels in parallel over blocks of majors.
+  template <typename I, typename J, typename D>
+  void rolling_hybrid(kernel_table<I, J, D> const &kernels,
+                      rolling_op const op, hybrid_span<I const, D const> const A,
+                      hybrid_span<J, D> const B, cspan<I> const dense_majors,
+                      I const n_minor, J const window,
+                      unsigned const n_threads)
+  {
+    check_hybrid(A, dense_majors, n_minor, "A");
+    check_hybrid(B, dense_majors, n_minor, "B");
+    if (B.pointers.size() != A.pointers.size())
+      throw std::invalid_argument{"the outputs do not match the input"};
+    if (window < 1)
+      throw std::invalid_argument{"the window must be positive"};
+
+    auto const sparse = kernels.rolling[op];
+    auto const dense = kernels.dense_rolling[op];
+    auto const n = static_cast<std::size_t>(n_minor);
+    auto const n_major = static_cast<std::ptrdiff_t>(A.pointers.size()) - 1;
+
+    parallel_for(n_major, 256, n_threads, [&](auto const a, auto const b) {
+      hybrid_runs(
+          dense_majors, a, b,
+          [&](std::size_t const c, std::size_t const d) {
+            auto const out_a = static_cast<std::size_t>(B.pointers[c]);
+            auto const out_b = static_cast<std::size_t>(B.pointers[d]);
+            sparse(A.pointers.slice(c, d + 1), A.indices, A.data,
+                   B.indices.slice(out_a, out_b), B.data.slice(out_a, out_b),
+                   n_minor, window);
+          },
+          [&](std::size_t const c, std::size_t const d, std::size_t const k) {
+            dense(A.dense.slice(k * n, (k + d - c) * n),
+                  B.dense.slice(k * n, (k + d - c) * n),
+                  static_cast<std::ptrdiff_t>(n_minor), window);
+          });
+    });
+  }
+
+  template <typename I, typename J, typename D>
+  void convolve_hybrid(kernel_table<I, J, D> const &kernels,
+                       hybrid_span<I const, D const> const A,
+                       cspan<D> const coeffs, hybrid_span<J, D> const B,
+                       cspan<I> const dense_majors, I const n_minor,
+                       unsigned const n_threads)
+  {
+    check_hybrid(A, dense_majors, n_minor, "A");
+    check_hybrid(B, dense_majors, n_minor, "B");
+    if (B.pointers.size() != A.pointers.size())
+      throw std::invalid_argument{"the outputs do not match the input"};
+
+    auto const n = static_cast<std::size_t>(n_minor);
+    auto const n_major = static_cast<std::ptrdiff_t>(A.pointers.size()) - 1;
+
+    parallel_for(n_major, 256, n_threads, [&](auto const a, auto const b) {
+      hybrid_runs(
+          dense_majors, a, b,
+          [&](std::size_t const c, std::size_t const d) {
+            auto const out_a = static_cast<std::size_t>(B.pointers[c]);
+            auto const out_b = static_cast<std::size_t>(B.pointers[d]);
+            kernels.convolve(A.pointers.slice(c, d + 1), A.indices, A.data,
+                             coeffs, B.indices.slice(out_a, out_b),
+                             B.data.slice(out_a, out_b), n_minor);
+          },
+          [&](std::size_t const c, std::size_t const d, std::size_t const k) {
+            kernels.dense_convolve(A.dense.slice(k * n, (k + d - c) * n),
+                                   coeffs,
+                                   B.dense.slice(k * n, (k + d - c) * n),
+                                   static_cast<std::ptrdiff_t>(n_minor));
+          });
+    });
+  }
+
+  // The standard deviation of each major, counting the implicit zeros
+  template <typename I, typename J, typename D>
+  void stdev_hybrid(kernel_table<I, J, D> const &kernels,
+                    hybrid_span<I const, D const> const A,
+                    cspan<I> const dense_majors, I const n_minor,
+                    span<D> const result, unsigned const n_threads)
+  {
+    check_hybrid(A, dense_majors, n_minor, "A");
+    if (result.size() + 1 != A.pointers.size())
+      throw std::invalid_argument{"the result must hold one value per major"};
+
+    auto const n = static_cast<std::size_t>(n_minor);
+    auto const n_major = static_cast<std::ptrdiff_t>(A.pointers.size()) - 1;
+
+    parallel_for(n_major, 256, n_threads, [&](auto const a, auto const b) {
+      hybrid_runs(
+          dense_majors, a, b,
+          [&](std::size_t const c, std::size_t const d) {
+            kernels.stdev(A.pointers.slice(c, d + 1), A.data, n_minor,
+                          result.slice(c, d));
+          },
+          [&](std::size_t const c, std::size_t const d, std::size_t const k) {
+            kernels.dense_stdev(A.dense.slice(k * n, (k + d - c) * n),
+                                static_cast<std::ptrdiff_t>(n_minor),
+                                result.slice(c, d));
+          });
+    });
+  }
+
+  // `maxclip_csr_spmat_plus_dvec_nonnegative` of hybrid matrices sharing
+  // their dense majors, e.g. the rolling median and minimum of one matrix
+  template <typename I, typename J, typename D>
+  void maxclip_hybrid(kernel_table<I, J, D> const &kernels,
+                      hybrid_span<I const, D> const A,
+                      hybrid_span<I const, D const> const B,
+                      cspan<D> const C_data, cspan<I> const dense_majors,
+                      I const n_minor, unsigned const n_threads)
+  {
+    check_hybrid(A, dense_majors, n_minor, "A");
+    check_hybrid(B, dense_majors, n_minor, "B");
+    if (B.pointers.size() != A.pointers.size() ||
+        C_data.size() + 1 != A.pointers.size())
+      throw std::invalid_argument{"the operands of the max-clip do not "
+                                  "match"};
+    if (std::any_of(B.dense.begin(), B.dense.end(),
+                    [](D const value) { return value < 0; }))
+      throw std::domain_error{"max-clip algorithm can only handle sparse "
+                              "matrices with all values being non-negative"};
+
+    // the sparse kernel checks the signs of all of `B` and `C` on every call
+    kernels.maxclip(A.pointers, A.indices, A.data, B.pointers, B.indices,
+                    B.data, C_data);
+
+    auto const n = static_cast<std::size_t>(n_minor);
+    auto const n_dense = static_cast<std::ptrdiff_t>(dense_majors.size());
+    parallel_for(n_dense, 64, n_threads, [&](auto const a, auto const b) {
+      for (auto k = static_cast<std::size_t>(a);
+           k < static_cast<std::size_t>(b); ++k) {
+        auto const major = static_cast<std::size_t>(dense_majors[k]);
+        kernels.dense_maxclip(A.dense.slice(k * n, (k + 1) * n),
+                              B.dense.slice(k * n, (k + 1) * n),
+                              C_data.slice(major, major + 1),
+                              static_cast<std::ptrdiff_t>(n_minor));
+      }
+    });
+  }
+} // namespace spectre
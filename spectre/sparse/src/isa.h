@@ -0,0 +1,13 @@
+#pragma once
+
+// The hot kernels are compiled once for every instruction set level by
+// `kernels.cpp` with `SPECTRE_ISA` set to the name of the level. Each build
+// lives in its own inline namespace, so the instantiations of different
+// levels never share a symbol and the linker cannot mix them up.
+#ifndef SPECTRE_ISA
+#define SPECTRE_ISA baseline
+#endif
+
+namespace spectre {
+  inline namespace SPECTRE_ISA {}
+} // namespace spectre
@@ -0,0 +1,88 @@
+#include "convolve.h"
+#include "dense.h"
+#include "isa.h"
+#include "kernels.h"
+#include "maxclip.h"
+#include "online.h"
+#include "prune.h"
+#include "rolling.h"
+#include "stdev.h"
+
+namespace spectre {
+  inline namespace SPECTRE_ISA {
+    template <typename I, typename J, typename D>
+    void fill_kernels(kernel_table<I, J, D> &table) noexcept
+    {
+      if constexpr (widens_v<I, J>) {
+        table.rolling[rolling_min] = rolling_csr<I, J, D, min_kernel>;
+        table.rolling[rolling_max] = rolling_csr<I, J, D, max_kernel>;
+        table.rolling[rolling_mean] = rolling_csr<I, J, D, mean_kernel>;
+        table.rolling[rolling_median] = rolling_csr<I, J, D, median_kernel>;
+        table.rolling[rolling_sum] = rolling_csr<I, J, D, sum_kernel>;
+        table.rolling[rolling_count] = rolling_csr<I, J, D, count_kernel>;
+        table.rolling_median_approx = rolling_median_approx_csr<I, J, D>;
+
+        table.rolling_rows[rolling_min] =
+            rolling_rows_csr<I, J, D, min_kernel>;
+        table.rolling_rows[rolling_max] =
+            rolling_rows_csr<I, J, D, max_kernel>;
+        table.rolling_rows[rolling_mean] =
+            rolling_rows_csr<I, J, D, mean_kernel>;
+        table.rolling_rows[rolling_median] =
+            rolling_rows_csr<I, J, D, median_kernel>;
+        table.rolling_rows[rolling_sum] = rolling_rows_csr<I, J, D, sum_kernel>;
+        table.rolling_rows[rolling_count] =
+            rolling_rows_csr<I, J, D, count_kernel>;
+
+        table.rolling_windows[rolling_min] =
+            rolling_windows_rows_csr<I, J, D, rolling_min>;
+        table.rolling_windows[rolling_max] =
+            rolling_windows_rows_csr<I, J, D, rolling_max>;
+        table.rolling_windows[rolling_mean] =
+            rolling_windows_rows_csr<I, J, D, rolling_mean>;
+        table.rolling_windows[rolling_sum] =
+            rolling_windows_rows_csr<I, J, D, rolling_sum>;
+        table.rolling_windows[rolling_count] =
+            rolling_windows_rows_csr<I, J, D, rolling_count>;
+
+        table.convolve = convolve_csr_dv<I, J, D>;
+        table.convolve_many = convolve_csr_dm<I, J, D>;
+      }
+
+      table.stdev = stdev_csr<I, D>;
+      table.maxclip = maxclip_csr_spmat_plus_dvec_nonnegative<I, D>;
+      table.clip_prune = clip_prune_csr<I, D>;
+      table.subtract_clip = subtract_clip_csr<I, D>;
+
+      table.rolling_scan[rolling_min] = rolling_scan_csr<I, D, min_kernel>;
+      table.rolling_scan[rolling_max] = rolling_scan_csr<I, D, max_kernel>;
+      table.rolling_scan[rolling_mean] = rolling_scan_csr<I, D, mean_kernel>;
+      table.rolling_scan[rolling_median] =
+          rolling_scan_csr<I, D, median_kernel>;
+      table.rolling_scan[rolling_sum] = rolling_scan_csr<I, D, sum_kernel>;
+      table.rolling_scan[rolling_count] = rolling_scan_csr<I, D, count_kernel>;
+      table.convolve_scan = convolve_scan_csr<I, D>;
+
+      table.dense_rolling[rolling_min] = rolling_dense<D, rolling_min>;
+      table.dense_rolling[rolling_max] = rolling_dense<D, rolling_max>;
+      table.dense_rolling[rolling_mean] = rolling_dense<D, rolling_mean>;
+      table.dense_rolling[rolling_median] = rolling_dense<D, rolling_median>;
+      table.dense_rolling[rolling_sum] = rolling_dense<D, rolling_sum>;
+      table.dense_rolling[rolling_count] = rolling_dense<D, rolling_count>;
+      table.dense_convolve = convolve_dense<D>;
+      table.dense_stdev = stdev_dense<D>;
+      table.dense_maxclip = maxclip_dense<D>;
+    }
+
+    kernel_tables const &kernels() noexcept
+    {
+      static kernel_tables const tables = [] {
+        kernel_tables result;
+        std::apply([](auto &...table) { (fill_kernels(table), ...); },
+                   result);
+        return result;
+      }();
+      return tables;
+    }
+  } // namespace SPECTRE_ISA
+} // namespace spectre
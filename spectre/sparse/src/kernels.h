@@ -0,0 +1,127 @@
+#pragma once
+
+#include "isa.h"
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+namespace spectre {
+  template <typename... Ts> struct type_list {};
+
+  using index_types = type_list<std::int16_t, std::int32_t, std::int64_t,
+                                std::uint16_t, std::uint32_t, std::uint64_t>;
+  using pointer_types = type_list<std::int32_t, std::int64_t>;
+  using value_types = type_list<float, double>;
+
+  // Whether column indices of type `I` can be shifted by a window in the
+  // signed output type `J`, i.e. `I - J` is computed in `J`.
+  template <typename I, typename J>
+  constexpr bool widens_v =
+      std::is_signed_v<J> && (std::is_signed_v<I> ? sizeof(I) <= sizeof(J)
+                                                  : sizeof(I) < sizeof(J));
+
+  enum rolling_op : int {
+    rolling_min,
+    rolling_max,
+    rolling_mean,
+    rolling_median,
+    rolling_sum,
+    rolling_count,
+    n_rolling_ops
+  };
+
+  // Entry points of the hot kernels compiled for one instruction set level.
+  // The rolling kernels and the convolutions are null unless `widens_v<I, J>`,
+  // the multi-window kernel of the median is always null. The dense kernels
+  // depend on `D` only and are set in every table.
+  template <typename I, typename J, typename D> struct kernel_table {
+    using rolling_fn = void (*)(cspan<I>, cspan<I>, cspan<D>, span<J>,
+                                span<D>, I, J);
+    using rolling_median_approx_fn = void (*)(cspan<I>, cspan<I>, cspan<D>,
+                                              span<J>, span<D>, I, J, D);
+    using rolling_rows_fn = void (*)(cspan<I>, cspan<I>, cspan<D>, cspan<J>,
+                                     span<D>, I, J, std::ptrdiff_t,
+                                     std::ptrdiff_t, span<std::byte>);
+    using rolling_windows_fn = void (*)(cspan<I>, cspan<I>, cspan<D>, cspan<J>,
+                                        cspan<J>, span<J>, span<D>, I,
+                                        std::ptrdiff_t, std::ptrdiff_t);
+    using convolve_fn = void (*)(cspan<I>, cspan<I>, cspan<D>, cspan<D>,
+                                 span<J>, span<D>, I) noexcept;
+    using convolve_many_fn = void (*)(cspan<I>, cspan<I>, cspan<D>, cspan<D>,
+                                      J, span<J>, span<D>, I);
+    using stdev_fn = void (*)(cspan<I>, cspan<D>, I, span<D>) noexcept;
+    using maxclip_fn = void (*)(cspan<I>, cspan<I>, span<D>, cspan<I>,
+                                cspan<I>, cspan<D>, cspan<D>);
+    using clip_prune_fn = I (*)(span<I>, span<I>, span<D>, D, D) noexcept;
+    using subtract_clip_fn = I (*)(cspan<I>, cspan<I>, cspan<D>, cspan<I>,
+                                   cspan<I>, cspan<D>, span<I>, span<I>,
+                                   span<D>, D, D) noexcept;
+    using rolling_scan_fn = I (*)(cspan<I>, cspan<I>, cspan<D>, span<I>,
+                                  span<D>);
+    using convolve_scan_fn = I (*)(cspan<I>, cspan<I>, cspan<D>, cspan<D>,
+                                   span<I>, span<D>);
+    using dense_rolling_fn = void (*)(cspan<D>, span<D>, std::ptrdiff_t,
+                                      std::ptrdiff_t);
+    using dense_convolve_fn = void (*)(cspan<D>, cspan<D>, span<D>,
+                                       std::ptrdiff_t);
+    using dense_stdev_fn = void (*)(cspan<D>, std::ptrdiff_t,
+                                    span<D>) noexcept;
+    using dense_maxclip_fn = void (*)(span<D>, cspan<D>, cspan<D>,
+                                      std::ptrdiff_t) noexcept;
+
+    rolling_fn rolling[n_rolling_ops] = {};
+    rolling_median_approx_fn rolling_median_approx = nullptr;
+    rolling_rows_fn rolling_rows[n_rolling_ops] = {};
+    rolling_windows_fn rolling_windows[n_rolling_ops] = {};
+    convolve_fn convolve = nullptr;
+    convolve_many_fn convolve_many = nullptr;
+    stdev_fn stdev = nullptr;
+    maxclip_fn maxclip = nullptr;
+    clip_prune_fn clip_prune = nullptr;
+    subtract_clip_fn subtract_clip = nullptr;
+    rolling_scan_fn rolling_scan[n_rolling_ops] = {};
+    convolve_scan_fn convolve_scan = nullptr;
+    dense_rolling_fn dense_rolling[n_rolling_ops] = {};
+    dense_convolve_fn dense_convolve = nullptr;
+    dense_stdev_fn dense_stdev = nullptr;
+    dense_maxclip_fn dense_maxclip = nullptr;
+  };
+
+  template <typename I, typename J, typename... Ds>
+  std::tuple<kernel_table<I, J, Ds>...> kernel_tables_d(type_list<Ds...>);
+
+  template <typename I, typename... Js, typename Ds>
+  auto kernel_tables_jd(type_list<Js...>, Ds ds)
+      -> decltype(std::tuple_cat(kernel_tables_d<I, Js>(ds)...));
+
+  template <typename... Is, typename Js, typename Ds>
+  auto kernel_tables_ijd(type_list<Is...>, Js js, Ds ds)
+      -> decltype(std::tuple_cat(kernel_tables_jd<Is>(js, ds)...));
+
+  // A table for every combination of the index, pointer and value types
+  using kernel_tables = decltype(kernel_tables_ijd(
+      index_types{}, pointer_types{}, value_types{}));
+
+  template <typename I, typename J, typename D>
+  kernel_table<I, J, D> const &get_kernels(kernel_tables const &tables) noexcept
+  {
+    return std::get<kernel_table<I, J, D>>(tables);
+  }
+
+  // The tables of each instruction set level built by `kernels.cpp`, the
+  // levels other than the baseline exist only in the multiversioned builds
+  namespace baseline {
+    kernel_tables const &kernels() noexcept;
+  }
+  namespace sse42 {
+    kernel_tables const &kernels() noexcept;
+  }
+  namespace avx2 {
+    kernel_tables const &kernels() noexcept;
+  }
+  namespace avx512 {
+    kernel_tables const &kernels() noexcept;
+  }
+} // namespace spectre
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "parallel.h"
+#include "span.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+namespace spectre {
+  // number of rows (or columns) of the dense factors processed as one unit of
+  // work, chosen so that a block of a rank ~10 factor stays in the L1/L2 cache
+  constexpr std::ptrdiff_t nmf_block = 512;
+
+  template <typename D>
+  void nmf_gram(D const *const X, std::ptrdiff_t const n,
+                std::ptrdiff_t const k, span<D> const G,
+                unsigned const n_threads)
+  {
+    std::mutex mutex;
+    std::fill(G.begin(), G.end(), static_cast<D>(0));
+
+    parallel_for(n, nmf_block, n_threads, [&](auto const a, auto const b) {
+      std::vector<D> local(k * k, 0);
+      for (auto i = a; i < b; ++i) {
+        auto const x = X + i * k;
+        for (std::ptrdiff_t r = 0; r < k; ++r)
+          for (std::ptrdiff_t s = r; s < k; ++s)
+            local[r * k + s] += x[r] * x[s];
+      }
+
+      std::lock_guard<std::mutex> lock{mutex};
+      for (std::ptrdiff_t i = 0; i < k * k; ++i)
+        G[i] += local[i];
+    });
+
+    for (std::ptrdiff_t r = 0; r < k; ++r)
+      for (std::ptrdiff_t s = 0; s < r; ++s)
+        G[r * k + s] = G[s * k + r];
+  }
+
+  // Factorizes a block of rows `X ~ W * H^T` with multiplicative updates, where
+  // `W` is the (rows x rank) elution profile and `H` the (cols x rank) spectra,
+  // both row-major and used as the initial guess. Returns the relative error.
+  template <typename I, typename D>
+  D nmf_window_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                   cspan<D> const A_data, span<D> const W, span<D> const H,
+                   I const A_n_cols, I const rank, I const max_iter,
+                   D const tol, unsigned const n_threads)
+  {
+    auto const m = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+    auto const n = static_cast<std::ptrdiff_t>(A_n_cols);
+    auto const k = static_cast<std::ptrdiff_t>(rank);
+    auto const eps = std::numeric_limits<D>::epsilon();
+
+    // transposed copy of the window, so that `X^T W` is parallel over columns
+    std::vector<I> T_cols(n + 1, 0);
+    std::vector<I> T_rows(A_rows[m] - A_rows[0]);
+    std::vector<D> T_data(A_rows[m] - A_rows[0]);
+
+    for (auto p = A_rows[0]; p < A_rows[m]; ++p)
+      ++T_cols[A_cols[p] + 1];
+    std::partial_sum(T_cols.begin(), T_cols.end(), T_cols.begin());
+
+    auto norm2 = static_cast<D>(0);
+    std::vector<I> fill(T_cols.begin(), T_cols.end() - 1);
+    for (std::ptrdiff_t i = 0; i < m; ++i) {
+      for (auto p = A_rows[i]; p < A_rows[i + 1]; ++p) {
+        auto const dst = fill[A_cols[p]]++;
+        T_rows[dst] = static_cast<I>(i);
+        T_data[dst] = A_data[p];
+        norm2 += A_data[p] * A_data[p];
+      }
+    }
+
+    if (norm2 == 0 || k == 0)
+      return 0;
+
+    std::vector<D> G(k * k), F(k * k);
+    nmf_gram(W.begin(), m, k, span<D>{G.data(), G.size()}, n_threads);
+
+    auto error = std::numeric_limits<D>::max();
+    for (I iter = 0; iter < max_iter; ++iter) {
+      // H <- H * (X^T W) / (H W^T W), one fused pass per block of columns
+      parallel_for(n, nmf_block, n_threads, [&](auto const a, auto const b) {
+        std::vector<D> num(k), upd(k);
+        for (auto j = a; j < b; ++j) {
+          std::fill(num.begin(), num.end(), static_cast<D>(0));
+          for (auto p = T_cols[j]; p < T_cols[j + 1]; ++p) {
+            auto const w = W.begin() + T_rows[p] * k;
+            for (std::ptrdiff_t r = 0; r < k; ++r)
+              num[r] += T_data[p] * w[r];
+          }
+
+          auto const h = H.begin() + j * k;
+          for (std::ptrdiff_t r = 0; r < k; ++r) {
+            auto den = static_cast<D>(0);
+            for (std::ptrdiff_t s = 0; s < k; ++s)
+              den += h[s] * G[s * k + r];
+            upd[r] = h[r] * num[r] / (den + eps);
+          }
+          std::copy(upd.begin(), upd.end(), h);
+        }
+      });
+      nmf_gram(H.begin(), n, k, span<D>{F.data(), F.size()}, n_threads);
+
+      // W <- W * (X H) / (W H^T H), accumulating tr(W^T X H) for the error
+      std::mutex mutex;
+      auto cross = static_cast<D>(0);
+      parallel_for(m, nmf_block, n_threads, [&](auto const a, auto const b) {
+        auto local = static_cast<D>(0);
+        std::vector<D> num(k), upd(k);
+        for (auto i = a; i < b; ++i) {
+          std::fill(num.begin(), num.end(), static_cast<D>(0));
+          for (auto p = A_rows[i]; p < A_rows[i + 1]; ++p) {
+            auto const h = H.begin() + A_cols[p] * k;
+            for (std::ptrdiff_t r = 0; r < k; ++r)
+              num[r] += A_data[p] * h[r];
+          }
+
+          auto const w = W.begin() + i * k;
+          for (std::ptrdiff_t r = 0; r < k; ++r) {
+            auto den = static_cast<D>(0);
+            for (std::ptrdiff_t s = 0; s < k; ++s)
+              den += w[s] * F[s * k + r];
+            upd[r] = w[r] * num[r] / (den + eps);
+            local += upd[r] * num[r];
+          }
+          std::copy(upd.begin(), upd.end(), w);
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        cross += local;
+      });
+      nmf_gram(W.begin(), m, k, span<D>{G.data(), G.size()}, n_threads);
+
+      // |X - W H^T|^2 = |X|^2 - 2 tr(W^T X H) + tr(W^T W H^T H)
+      auto const fit = std::inner_product(G.begin(), G.end(), F.begin(),
+                                          static_cast<D>(0));
+      auto const next = std::sqrt(std::max(norm2 - 2 * cross + fit,
+                                           static_cast<D>(0)) /
+                                  norm2);
+
+      auto const converged = error - next < tol * error;
+      error = next;
+      if (converged)
+        break;
+    }
+    return error;
+  }
+
+  // Factorizes independent windows of rows given by the pointer array
+  // `windows`. With `warm_start` the windows are solved in order and each one
+  // starts from the spectra of the previous window, otherwise they are solved
+  // in parallel. `H` holds one (cols x rank) block per window.
+  template <typename I, typename D>
+  void nmf_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+               cspan<D> const A_data, cspan<I> const windows, span<D> const W,
+               span<D> const H, span<D> const errors, I const A_n_cols,
+               I const rank, I const max_iter, D const tol,
+               bool const warm_start, unsigned const n_threads)
+  {
+    auto const n_windows = static_cast<std::ptrdiff_t>(windows.size()) - 1;
+    auto const k = static_cast<std::size_t>(rank);
+    auto const h_size = static_cast<std::size_t>(A_n_cols) * k;
+
+    assert(errors.size() == static_cast<std::size_t>(n_windows));
+    assert(H.size() == h_size * n_windows);
+
+    auto solve = [&](std::ptrdiff_t const w, unsigned const threads) {
+      auto const a = static_cast<std::size_t>(windows[w]);
+      auto const b = static_cast<std::size_t>(windows[w + 1]);
+      errors[w] = nmf_window_csr(A_rows.slice(a, b + 1), A_cols, A_data,
+                                 W.slice(a * k, b * k),
+                                 H.slice(w * h_size, (w + 1) * h_size),
+                                 A_n_cols, rank, max_iter, tol, threads);
+    };
+
+    if (warm_start) {
+      for (std::ptrdiff_t w = 0; w < n_windows; ++w) {
+        if (w > 0)
+          std::copy_n(H.begin() + (w - 1) * h_size, h_size,
+                      H.begin() + w * h_size);
+        solve(w, n_threads);
+      }
+    } else {
+      parallel_for(n_windows, 1, n_threads, [&](auto const a, auto const b) {
+        for (auto w = a; w < b; ++w)
+          solve(w, 1);
+      });
+    }
+  }
+} // namespace spectre
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the .npy files are read and written in the little endian byte order"
+#endif
+
+// A minimal reader and writer of the one-dimensional `.npy` arrays and of the
+// `meta.json` of a `spectre.load.to_arrays` directory, enough for the command
+// line tools to exchange projects with Python without depending on it
+namespace spectre::npy {
+  // The element type of an array, e.g. `{'f', 8}` for `<f8`
+  struct dtype {
+    char kind;
+    std::size_t size;
+  };
+
+  struct array {
+    dtype type;
+    std::vector<char> bytes;
+
+    std::size_t size() const noexcept
+    {
+      return bytes.size() / type.size;
+    }
+  };
+
+  [[noreturn]] inline void fail(std::string const &path,
+                                std::string const &what)
+  {
+    throw std::runtime_error{path + ": " + what};
+  }
+
+  // The value of `key` in the header dictionary, e.g. `'<f8'` or `(3,)`,
+  // empty if there is none
+  inline std::string header_value(std::string const &header,
+                                  std::string const &key)
+  {
+    auto const at = header.find("'" + key + "':");
+    if (at == std::string::npos)
+      return {};
+    auto const first = header.find_first_not_of(' ', at + key.size() + 3);
+    if (first == std::string::npos)
+      return {};
+
+    auto const tuple = header[first] == '(';
+    auto const last = tuple ? header.find(')', first)
+                            : header.find_first_of(",}", first);
+    if (last == std::string::npos)
+      return {};
+    return header.substr(first, last - first + tuple);
+  }
+
+  // Whether `cast` converts the elements of the type
+  inline bool supported(dtype const type) noexcept
+  {
+    if (type.kind == 'f')
+      return type.size == 4 || type.size == 8;
+    return (type.kind == 'i' || type.kind == 'u') &&
+           (type.size == 1 || type.size == 2 || type.size == 4 ||
+            type.size == 8);
+  }
+
+  inline array load(std::string const &path)
+  {
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+      fail(path, "cannot be opened");
+
+    char magic[8];
+    if (!file.read(magic, 8) || std::memcmp(magic, "\x93NUMPY", 6) != 0)
+      fail(path, "is not a .npy file");
+
+    std::uint32_t length = 0;
+    unsigned char bytes[4] = {};
+    file.read(reinterpret_cast<char *>(bytes), magic[6] == 1 ? 2 : 4);
+    for (int i = 3; i >= 0; --i)
+      length = length << 8 | bytes[i];
+
+    std::string header(length, '\0');
+    if (!file.read(&header[0], length))
+      fail(path, "has a truncated header");
+
+    auto const descr = header_value(header, "descr");
+    auto const shape = header_value(header, "shape");
+    if (descr.size() < 5 || descr.front() != '\'' || descr.back() != '\'' ||
+        (descr[1] != '<' && descr[1] != '|'))
+      fail(path, "has an unsupported dtype " + descr);
+    if (shape.size() < 3 || shape.front() != '(' ||
+        shape.find(',') != shape.size() - 2)
+      fail(path, "is not a one-dimensional array");
+
+    array result;
+    char *end;
+    result.type = {descr[2], std::strtoul(descr.c_str() + 3, &end, 10)};
+    if (end != &descr.back() || !supported(result.type))
+      fail(path, "has an unsupported dtype " + descr);
+    auto const size = std::strtoull(shape.c_str() + 1, &end, 10);
+    if (shape[1] < '0' || shape[1] > '9' || *end != ',')
+      fail(path, "is not a one-dimensional array");
+    if (size > std::numeric_limits<std::size_t>::max() / result.type.size)
+      fail(path, "has too many elements");
+
+    result.bytes.resize(size * result.type.size);
+    if (!file.read(result.bytes.data(),
+                   static_cast<std::streamsize>(result.bytes.size())))
+      fail(path, "has truncated data");
+    return result;
+  }
+
+  // Converts the elements of an array to `T`
+  template <typename T> std::vector<T> cast(array const &a)
+  {
+    std::vector<T> result(a.size());
+    auto convert = [&](auto tag) {
+      using S = decltype(tag);
+      for (std::size_t i = 0; i < result.size(); ++i) {
+        S value;
+        std::memcpy(&value, a.bytes.data() + i * sizeof(S), sizeof(S));
+        result[i] = static_cast<T>(value);
+      }
+    };
+
+    switch (a.type.kind == 'f' ? -static_cast<int>(a.type.size)
+                               : (a.type.kind == 'u' ? 16 : 0) +
+                                     static_cast<int>(a.type.size)) {
+    case -4: convert(float{}); break;
+    case -8: convert(double{}); break;
+    case 1: convert(std::int8_t{}); break;
+    case 2: convert(std::int16_t{}); break;
+    case 4: convert(std::int32_t{}); break;
+    case 8: convert(std::int64_t{}); break;
+    case 17: convert(std::uint8_t{}); break;
+    case 18: convert(std::uint16_t{}); break;
+    case 20: convert(std::uint32_t{}); break;
+    case 24: convert(std::uint64_t{}); break;
+    default: throw std::runtime_error{"unsupported dtype"};
+    }
+    return result;
+  }
+
+  template <typename T> constexpr char const *descr() noexcept
+  {
+    static_assert(std::is_arithmetic_v<T>, "not a numeric type");
+    if constexpr (std::is_floating_point_v<T>)
+      return sizeof(T) == 4 ? "<f4" : "<f8";
+    else if constexpr (std::is_signed_v<T>)
+      return sizeof(T) == 4 ? "<i4" : "<i8";
+    else
+      return sizeof(T) == 4 ? "<u4" : "<u8";
+  }
+
+  // Writes a version 1.0 `.npy` file, readable by `numpy.load`
+  template <typename T> void save(std::string const &path, cspan<T> data)
+  {
+    std::ostringstream dict;
+    dict << "{'descr': '" << descr<T>() << "', 'fortran_order': False, "
+         << "'shape': (" << data.size() << ",), }";
+
+    // the data start is aligned to 64 bytes
+    auto header = dict.str();
+    header.append(63 - (10 + header.size()) % 64, ' ').push_back('\n');
+
+    std::ofstream file{path, std::ios::binary};
+    auto const length = static_cast<std::uint16_t>(header.size());
+    file.write("\x93NUMPY\x01\x00", 8);
+    file.put(static_cast<char>(length & 0xff));
+    file.put(static_cast<char>(length >> 8));
+    file << header;
+    file.write(reinterpret_cast<char const *>(data.begin()),
+               static_cast<std::streamsize>(data.size() * sizeof(T)));
+    if (!file)
+      fail(path, "cannot be written");
+  }
+
+  // The `meta.json` of a directory written by `spectre.load.to_arrays`
+  struct meta {
+    std::string format;
+    std::int64_t shape[2];
+  };
+
+  inline meta load_meta(std::string const &path)
+  {
+    std::ifstream file{path};
+    if (!file)
+      fail(path, "cannot be opened");
+    std::string const json{std::istreambuf_iterator<char>{file}, {}};
+
+    meta result;
+    auto const format = json.find("\"format\"");
+    auto const shape = json.find("\"shape\"");
+    if (format == std::string::npos || shape == std::string::npos)
+      fail(path, "has no format or shape");
+
+    auto const first = json.find('"', json.find(':', format)) + 1;
+    result.format = json.substr(first, json.find('"', first) - first);
+
+    auto const open = json.find('[', shape);
+    if (open == std::string::npos)
+      fail(path, "has a malformed shape");
+    char const *at = json.c_str() + open + 1;
+    for (int i = 0; i < 2; ++i) {
+      char *end;
+      result.shape[i] = std::strtoll(at, &end, 10);
+      if (end == at)
+        fail(path, "has a malformed shape");
+      while (*end == ' ')
+        ++end;
+      if (*end != ",]"[i])
+        fail(path, "has a malformed shape");
+      at = end + 1;
+    }
+    if (result.format != "csr" && result.format != "csc")
+      fail(path, "has an unsupported format " + result.format);
+    return result;
+  }
+
+  inline void save_meta(std::string const &path, meta const &m)
+  {
+    std::ofstream file{path};
+    file << "{\"format\": \"" << m.format << "\", \"shape\": [" << m.shape[0]
+         << ", " << m.shape[1] << "]}";
+    if (!file)
+      fail(path, "cannot be written");
+  }
+} // namespace spectre::npy
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "buffer.h"
+#include "isa.h"
+#include "span.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+namespace spectre {
+  inline namespace SPECTRE_ISA {
+    // Visits the union of the columns of `window` consecutive CSR rows in
+    // ascending order, calling `emit(col, values)` with the values of the
+    // column in each row (zeros for the rows without it). Rows outside of the
+    // matrix are passed as empty rows, so this is the column-wise rolling
+    // operation of `rolling_csr` evaluated at a single output row.
+    template <typename I, typename D, typename F>
+    void scan_window(cspan<I> const A_rows, cspan<I> const A_cols,
+                     cspan<D> const A_data, buffer<D> &values, F &&emit)
+    {
+      auto const window = A_rows.size() - 1;
+      buffer<std::size_t> iters;
+      iters.assign(A_rows.begin(), A_rows.end() - 1);
+      values.resize(window);
+
+      for (;;) {
+        auto col = std::numeric_limits<I>::max();
+        bool any = false;
+        for (std::size_t r = 0; r < window; ++r)
+          if (iters[r] < static_cast<std::size_t>(A_rows[r + 1])) {
+            col = std::min(col, A_cols[iters[r]]);
+            any = true;
+          }
+        if (!any)
+          return;
+
+        for (std::size_t r = 0; r < window; ++r) {
+          auto &iter = iters[r];
+          if (iter < static_cast<std::size_t>(A_rows[r + 1]) &&
+              A_cols[iter] == col)
+            values[r] = A_data[iter++];
+          else
+            values[r] = 0;
+        }
+        emit(col, cspan<D>{values.data(), values.size()});
+      }
+    }
+
+    // Applies the kernel `Krn` over the window rows `A_rows` for the row in
+    // their middle, `B_cols`/`B_data` need room for every nonzero of the
+    // window. Returns the number of the output nonzeros.
+    template <typename I, typename D,
+              template <typename, typename> typename Krn>
+    I rolling_scan_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                       cspan<D> const A_data, span<I> const B_cols,
+                       span<D> const B_data)
+    {
+      using J = std::ptrdiff_t;
+
+      auto kernel = Krn<J, D>{static_cast<J>(A_rows.size() - 1)};
+      buffer<D> values;
+      std::size_t out = 0;
+
+      scan_window(A_rows, A_cols, A_data, values,
+                  [&](I const col, cspan<D> const window) {
+                    kernel.init();
+                    for (auto const value : window)
+                      kernel.push(value);
+
+                    assert(out < B_cols.size());
+                    B_cols[out] = col;
+                    B_data[out] = kernel.result();
+                    ++out;
+                  });
+      return static_cast<I>(out);
+    }
+
+    // Like `rolling_scan_csr`, but convolves the window with `coeffs` (ordered
+    // as in `convolve_csr_dv`), the window size is the size of `coeffs`
+    template <typename I, typename D>
+    I convolve_scan_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                        cspan<D> const A_data, cspan<D> const coeffs,
+                        span<I> const B_cols, span<D> const B_data)
+    {
+      assert(A_rows.size() == coeffs.size() + 1);
+
+      buffer<D> values;
+      std::size_t out = 0;
+
+      scan_window(A_rows, A_cols, A_data, values,
+                  [&](I const col, cspan<D> const window) {
+                    auto value = static_cast<D>(0);
+                    auto coeff = coeffs.end();
+                    for (auto const v : window)
+                      value += *--coeff * v;
+
+                    assert(out < B_cols.size());
+                    B_cols[out] = col;
+                    B_data[out] = value;
+                    ++out;
+                  });
+      return static_cast<I>(out);
+    }
+  } // namespace SPECTRE_ISA
+} // namespace spectre
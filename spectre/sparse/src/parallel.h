@@ -0,0 +1,80 @@
+#pragma once
+
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace spectre {
+  inline unsigned resolve_threads(unsigned const n_threads) noexcept
+  {
+    if (n_threads > 0)
+      return n_threads;
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // Calls `func(a, b)` for consecutive blocks `[a, b)` of `[0, size)`. Blocks
+  // are handed out dynamically, so uneven rows do not stall the other workers.
+  // `n_threads == 0` uses all hardware threads. The first exception thrown by
+  // `func` stops the handing out and is rethrown once every worker joined.
+  // A `func(a, b, worker)` is also given the index of the worker running the
+  // block, below `resolve_threads(n_threads)`, e.g. to pick its scratch space.
+  template <typename F>
+  void parallel_for(std::ptrdiff_t const size, std::ptrdiff_t const block,
+                    unsigned const n_threads, F &&func)
+  {
+    auto const n_blocks = (size + block - 1) / block;
+    auto const n_workers = static_cast<unsigned>(std::min<std::ptrdiff_t>(
+        resolve_threads(n_threads), std::max<std::ptrdiff_t>(n_blocks, 1)));
+
+    // the work of the threads is reported to the caller's trace scope
+    auto *const traced = trace::scope::active();
+    std::atomic<std::int64_t> busy{0};
+
+    std::atomic<std::ptrdiff_t> next{0};
+    std::vector<std::exception_ptr> errors(n_workers);
+    auto worker = [&](unsigned const id) {
+      auto const begin = traced ? trace::now() : 0;
+      try {
+        for (auto a = next.fetch_add(block); a < size;
+             a = next.fetch_add(block))
+          if constexpr (std::is_invocable_v<F &, std::ptrdiff_t,
+                                            std::ptrdiff_t, unsigned>)
+            func(a, std::min(size, a + block), id);
+          else
+            func(a, std::min(size, a + block));
+      } catch (...) {
+        errors[id] = std::current_exception();
+        next = size;
+      }
+      if (traced)
+        busy += trace::now() - begin;
+    };
+
+    std::vector<std::thread> threads;
+    if (n_workers > 1) {
+      // when no more threads start, the calling thread takes over their blocks
+      try {
+        threads.reserve(n_workers - 1);
+        for (unsigned i = 1; i < n_workers; ++i)
+          threads.emplace_back(worker, i);
+      } catch (...) {
+      }
+    }
+    worker(0);
+    for (auto &thread : threads)
+      thread.join();
+
+    if (traced)
+      traced->parallel(n_workers, busy);
+
+    for (auto const &error : errors)
+      if (error)
+        std::rethrow_exception(error);
+  }
+} // namespace spectre
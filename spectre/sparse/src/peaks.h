@@ -0,0 +1,168 @@
+#pragma once
+
+#include "parallel.h"
+#include "ranges.h"
+#include "span.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace spectre {
+  template <typename I, typename D> struct peak {
+    I apex;
+    D height;
+    D prominence;
+    D area;
+    D left;
+    D right;
+  };
+
+  // Finds peaks in every run of consecutive nonzeros of a sparse row, padded by
+  // the implicit zeros around it. Local maxima, prominences and widths at half
+  // prominence follow `scipy.signal.find_peaks`/`peak_widths`, and they are
+  // exact for non-negative rows since a search never has to cross a zero.
+  template <typename I, typename D, typename F>
+  void find_peaks_row(cspan<I> const cols, cspan<D> const data, I const n_cols,
+                      D const min_prominence, D const min_width,
+                      std::vector<D> &ext, F &&emit)
+  {
+    std::size_t a = 0;
+    while (a < cols.size()) {
+      auto b = a + 1;
+      while (b < cols.size() && cols[b] == cols[b - 1] + 1)
+        ++b;
+
+      auto const lpad = cols[a] > 0;
+      auto const rpad = cols[b - 1] + 1 < n_cols;
+      auto const offset = cols[a] - static_cast<I>(lpad);
+
+      ext.clear();
+      if (lpad)
+        ext.push_back(0);
+      ext.insert(ext.end(), data.begin() + a, data.begin() + b);
+      if (rpad)
+        ext.push_back(0);
+
+      auto evaluate = [&](std::ptrdiff_t const p) {
+        auto const last = static_cast<std::ptrdiff_t>(ext.size()) - 1;
+        auto const height = ext[p];
+
+        auto lmin = height, rmin = height;
+        auto lbase = p, rbase = p;
+        for (auto q = p; q >= 0 && ext[q] <= height; --q)
+          if (ext[q] < lmin)
+            lmin = ext[q], lbase = q;
+        for (auto q = p; q <= last && ext[q] <= height; ++q)
+          if (ext[q] < rmin)
+            rmin = ext[q], rbase = q;
+
+        auto const prominence = height - std::max(lmin, rmin);
+        if (prominence < min_prominence)
+          return;
+
+        auto const ref = height - prominence / 2;
+        auto lq = p, rq = p;
+        while (lbase < lq && ext[lq] > ref)
+          --lq;
+        while (rq < rbase && ext[rq] > ref)
+          ++rq;
+
+        auto left = static_cast<D>(lq), right = static_cast<D>(rq);
+        if (ext[lq] < ref)
+          left += (ref - ext[lq]) / (ext[lq + 1] - ext[lq]);
+        if (ext[rq] < ref)
+          right -= (ref - ext[rq]) / (ext[rq - 1] - ext[rq]);
+        if (right - left < min_width)
+          return;
+
+        auto area = static_cast<D>(0);
+        for (auto q = lbase; q < rbase; ++q)
+          area += (ext[q] + ext[q + 1]) / 2;
+
+        emit(peak<I, D>{static_cast<I>(offset + p), height, prominence, area,
+                        offset + left, offset + right});
+      };
+
+      auto const last = static_cast<std::ptrdiff_t>(ext.size()) - 1;
+      for (std::ptrdiff_t e = 1; e < last; ++e) {
+        if (ext[e - 1] < ext[e]) {
+          auto ahead = e + 1;
+          while (ahead < last && ext[ahead] == ext[e])
+            ++ahead;
+          if (ext[ahead] < ext[e]) {
+            evaluate((e + ahead - 1) / 2);
+            e = ahead;
+          }
+        }
+      }
+      a = b;
+    }
+  }
+
+  template <typename I, typename D>
+  I peaks_alloc_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                    cspan<D> const A_data, span<I> const B_rows,
+                    I const A_n_cols, D const min_prominence,
+                    D const min_width, unsigned const n_threads)
+  {
+    auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+
+    B_rows[0] = 0;
+    parallel_for(n_rows, 64, n_threads, [&](auto const a, auto const b) {
+      std::vector<D> ext;
+      for (auto row = a; row < b; ++row) {
+        auto count = static_cast<I>(0);
+        find_peaks_row(A_cols.slice(A_rows[row], A_rows[row + 1]),
+                       A_data.slice(A_rows[row], A_rows[row + 1]), A_n_cols,
+                       min_prominence, min_width, ext,
+                       [&](auto const &) { ++count; });
+        B_rows[row + 1] = count;
+      }
+    });
+
+    std::partial_sum(B_rows.begin(), B_rows.end(), B_rows.begin());
+    return B_rows.back();
+  }
+
+  // Writes the peaks counted by `peaks_alloc_csr` as a struct of arrays, the
+  // peaks of the `i`-th row are stored at `[B_rows[i], B_rows[i + 1])`
+  template <typename I, typename D>
+  void peaks_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                 cspan<D> const A_data, cspan<I> const B_rows,
+                 span<I> const B_apex, span<D> const B_height,
+                 span<D> const B_prominence, span<D> const B_area,
+                 span<D> const B_left, span<D> const B_right,
+                 I const A_n_cols, D const min_prominence, D const min_width,
+                 unsigned const n_threads)
+  {
+    auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+    // every row fills exactly its range of `B_rows`, offsets computed with
+    // other arguments are rejected rather than overrun
+    constexpr auto mismatch = "the output rows do not match the peaks";
+
+    parallel_for(n_rows, 64, n_threads, [&](auto const a, auto const b) {
+      std::vector<D> ext;
+      for (auto row = a; row < b; ++row) {
+        auto out = static_cast<std::size_t>(B_rows[row]);
+        auto const end = static_cast<std::size_t>(B_rows[row + 1]);
+        find_peaks_row(A_cols.slice(A_rows[row], A_rows[row + 1]),
+                       A_data.slice(A_rows[row], A_rows[row + 1]), A_n_cols,
+                       min_prominence, min_width, ext,
+                       [&](peak<I, D> const &p) {
+                         if (out == end)
+                           throw std::invalid_argument{mismatch};
+                         B_apex[out] = p.apex;
+                         B_height[out] = p.height;
+                         B_prominence[out] = p.prominence;
+                         B_area[out] = p.area;
+                         B_left[out] = p.left;
+                         B_right[out] = p.right;
+                         ++out;
+                       });
+        if (out != end)
+          throw std::invalid_argument{mismatch};
+      }
+    });
+  }
+} // namespace spectre
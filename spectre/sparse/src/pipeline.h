@@ -0,0 +1,285 @@
+#pragma once
+
+#include "convert.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "rolling.h"
+#include "span.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace spectre {
+  template <typename T> span<T> as_span(std::vector<T> &v) noexcept
+  {
+    return span<T>{v.data(), v.size()};
+  }
+
+  template <typename T> cspan<T> as_span(std::vector<T> const &v) noexcept
+  {
+    return cspan<T>{v.data(), v.size()};
+  }
+
+  template <typename T> cspan<T> as_cspan(std::vector<T> const &v) noexcept
+  {
+    return as_span(v);
+  }
+
+  // A compressed sparse matrix owning its arrays, i.e. a CSR matrix when the
+  // major axis is the rows or a CSC matrix when it is the columns
+  template <typename I, typename D> struct compressed_matrix {
+    std::vector<I> pointers = {0};
+    std::vector<I> indices;
+    std::vector<D> data;
+    I n_minor = 0;
+
+    I n_major() const noexcept
+    {
+      return static_cast<I>(pointers.size()) - 1;
+    }
+  };
+
+  template <typename I, typename D>
+  compressed_matrix<I, D> transpose(compressed_matrix<I, D> const &A)
+  {
+    compressed_matrix<I, D> B;
+    B.pointers.resize(static_cast<std::size_t>(A.n_minor) + 1);
+    B.indices.resize(A.indices.size());
+    B.data.resize(A.data.size());
+    B.n_minor = A.n_major();
+
+    csr_to_csc(as_span(A.pointers), as_span(A.indices), as_span(A.data),
+               as_span(B.indices), as_span(B.pointers), as_span(B.data),
+               A.n_major());
+    return B;
+  }
+
+  // Runs `func(a, b)` over blocks of the majors `[a, b)` of `A` in parallel
+  template <typename I, typename D, typename F>
+  void for_majors(compressed_matrix<I, D> const &A, unsigned const n_threads,
+                  F &&func)
+  {
+    parallel_for(A.n_major(), 256, n_threads, std::forward<F>(func));
+  }
+
+  // An output of a rolling operation along the minor axis, with the structure
+  // computed by `rolling_alloc_csr` and the values left to `func(A, B, a, b)`
+  // called in parallel for blocks of the majors `[a, b)`
+  template <typename I, typename D, typename F>
+  compressed_matrix<I, D> rolling_output(compressed_matrix<I, D> const &A,
+                                         I const window,
+                                         unsigned const n_threads, F &&func)
+  {
+    compressed_matrix<I, D> B;
+    B.pointers.resize(A.pointers.size());
+    B.n_minor = A.n_minor;
+
+    auto const size = rolling_alloc_csr(as_span(A.pointers), as_span(A.indices),
+                                        as_span(B.pointers), A.n_minor, window);
+    B.indices.resize(static_cast<std::size_t>(size));
+    B.data.resize(static_cast<std::size_t>(size));
+
+    for_majors(A, n_threads, [&](auto const a, auto const b) {
+      func(as_span(A.pointers).slice(a, b + 1),
+           as_span(B.indices).slice(B.pointers[a], B.pointers[b]),
+           as_span(B.data).slice(B.pointers[a], B.pointers[b]));
+    });
+    return B;
+  }
+
+  template <typename I, typename D>
+  compressed_matrix<I, D> rolling(kernel_table<I, I, D> const &kernels,
+                                  rolling_op const op,
+                                  compressed_matrix<I, D> const &A,
+                                  I const window, unsigned const n_threads)
+  {
+    return rolling_output(
+        A, window, n_threads, [&](auto rows, auto cols, auto data) {
+          kernels.rolling[op](rows, as_span(A.indices), as_span(A.data), cols,
+                              data, A.n_minor, window);
+        });
+  }
+
+  template <typename I, typename D>
+  compressed_matrix<I, D> convolve(kernel_table<I, I, D> const &kernels,
+                                   compressed_matrix<I, D> const &A,
+                                   std::vector<D> const &coeffs,
+                                   unsigned const n_threads)
+  {
+    return rolling_output(
+        A, static_cast<I>(coeffs.size()), n_threads,
+        [&](auto rows, auto cols, auto data) {
+          kernels.convolve(rows, as_span(A.indices), as_span(A.data),
+                           as_span(coeffs), cols, data, A.n_minor);
+        });
+  }
+
+  // Drops the values outside of `[lower, upper]` after clamping them, see
+  // `clip_prune_csr`
+  template <typename I, typename D>
+  void clip(kernel_table<I, I, D> const &kernels, compressed_matrix<I, D> &A,
+            D const lower, D const upper)
+  {
+    auto const size =
+        kernels.clip_prune(as_span(A.pointers), as_span(A.indices),
+                           as_span(A.data), lower, upper);
+    A.indices.resize(static_cast<std::size_t>(size));
+    A.data.resize(static_cast<std::size_t>(size));
+  }
+
+  // The standard deviation of each major, counting the implicit zeros
+  template <typename I, typename D>
+  std::vector<D> stdev(kernel_table<I, I, D> const &kernels,
+                       compressed_matrix<I, D> const &A,
+                       unsigned const n_threads)
+  {
+    std::vector<D> result(static_cast<std::size_t>(A.n_major()));
+    for_majors(A, n_threads, [&](auto const a, auto const b) {
+      kernels.stdev(as_span(A.pointers).slice(a, b + 1), as_span(A.data),
+                    A.n_minor, as_span(result).slice(a, b));
+    });
+    return result;
+  }
+
+  // `max(A - B, 0)` of a non-negative `B`, which may only be positive at the
+  // nonzeros of `A`, so it is computed in place of `A`
+  template <typename I, typename D>
+  void subtract_clip(kernel_table<I, I, D> const &kernels,
+                     compressed_matrix<I, D> &A,
+                     compressed_matrix<I, D> const &B,
+                     unsigned const n_threads)
+  {
+    for_majors(A, n_threads, [&](auto const a, auto const b) {
+      for (auto major = a; major < b; ++major) {
+        auto j = B.pointers[major];
+        for (auto i = A.pointers[major]; i < A.pointers[major + 1]; ++i) {
+          while (j < B.pointers[major + 1] && B.indices[j] < A.indices[i])
+            ++j;
+          if (j < B.pointers[major + 1] && B.indices[j] == A.indices[i])
+            A.data[i] -= B.data[j];
+        }
+      }
+    });
+    clip(kernels, A, static_cast<D>(0), std::numeric_limits<D>::infinity());
+  }
+
+  // The Savitzky-Golay smoothing coefficients, like `scipy.signal.
+  // savgol_coeffs(window, degree)`, i.e. the least squares fit of a polynomial
+  // evaluated at the center of the window
+  template <typename D>
+  std::vector<D> savgol_coeffs(std::size_t const window,
+                               std::size_t const degree)
+  {
+    if (window % 2 == 0 || degree >= window)
+      throw std::invalid_argument{"the Savitzky-Golay window must be odd and "
+                                  "longer than the degree"};
+
+    auto const n = degree + 1;
+    auto const half = static_cast<double>(window / 2);
+
+    // the normal equations `(A A^T) z = e_0` of the powers `A[p][i] = x_i^p`
+    std::vector<double> M(n * (n + 1), 0);
+    for (std::size_t p = 0; p < n; ++p) {
+      for (std::size_t q = 0; q < n; ++q)
+        for (std::size_t i = 0; i < window; ++i)
+          M[p * (n + 1) + q] += std::pow(i - half, static_cast<double>(p + q));
+      M[p * (n + 1) + n] = p == 0;
+    }
+
+    // Gauss-Jordan elimination with partial pivoting
+    for (std::size_t c = 0; c < n; ++c) {
+      auto pivot = c;
+      for (auto r = c + 1; r < n; ++r)
+        if (std::abs(M[r * (n + 1) + c]) > std::abs(M[pivot * (n + 1) + c]))
+          pivot = r;
+      for (std::size_t k = 0; k <= n; ++k)
+        std::swap(M[c * (n + 1) + k], M[pivot * (n + 1) + k]);
+
+      for (std::size_t r = 0; r < n; ++r) {
+        if (r == c)
+          continue;
+        auto const f = M[r * (n + 1) + c] / M[c * (n + 1) + c];
+        for (std::size_t k = c; k <= n; ++k)
+          M[r * (n + 1) + k] -= f * M[c * (n + 1) + k];
+      }
+    }
+
+    std::vector<D> coeffs(window);
+    for (std::size_t i = 0; i < window; ++i) {
+      double value = 0;
+      for (std::size_t p = 0; p < n; ++p)
+        value += M[p * (n + 1) + n] / M[p * (n + 1) + p] *
+                 std::pow(i - half, static_cast<double>(p));
+      coeffs[i] = static_cast<D>(value);
+    }
+    return coeffs;
+  }
+
+  // The steps of `spectre.sparse.preprocess_cpp.preprocess` over a CSC
+  // matrix, i.e. its majors are the m/z columns and its minors the scans
+
+  template <typename I, typename D>
+  compressed_matrix<I, D> remove_noise(kernel_table<I, I, D> const &kernels,
+                                       compressed_matrix<I, D> data,
+                                       double const peak_width,
+                                       unsigned const n_threads)
+  {
+    auto const width = static_cast<std::size_t>(std::nearbyint(peak_width));
+    auto const window = width % 2 ? width : width + 1;
+    auto const degree = std::min<std::size_t>(3, window - 1);
+
+    if (degree > 0)
+      data = convolve(kernels, data, savgol_coeffs<D>(window, degree),
+                      n_threads);
+    clip(kernels, data, static_cast<D>(0),
+         std::numeric_limits<D>::infinity());
+    return data;
+  }
+
+  template <typename I, typename D>
+  compressed_matrix<I, D> estimate_baseline(
+      kernel_table<I, I, D> const &kernels,
+      compressed_matrix<I, D> const &data, I const k, unsigned const n_threads)
+  {
+    auto k_med = std::min(k, data.n_minor - 1);
+    k_med = k_med % 2 ? k_med : k_med - 1;
+    if (k < 1 || k_med < 1)
+      throw std::invalid_argument{"the baseline window does not fit the "
+                                  "number of scans"};
+
+    auto const data_min = rolling(kernels, rolling_min, data, k, n_threads);
+    auto data_base = rolling(kernels, rolling_median, data, k_med, n_threads);
+
+    auto const deviation = stdev(kernels, data_min, n_threads);
+    kernels.maxclip(as_cspan(data_base.pointers), as_cspan(data_base.indices),
+                    as_span(data_base.data), as_span(data_min.pointers),
+                    as_span(data_min.indices), as_span(data_min.data),
+                    as_span(deviation));
+    return rolling(kernels, rolling_mean, data_base, k, n_threads);
+  }
+
+  template <typename I, typename D>
+  compressed_matrix<I, D> remove_baseline(kernel_table<I, I, D> const &kernels,
+                                          compressed_matrix<I, D> data,
+                                          I const k, unsigned const n_threads)
+  {
+    auto const baseline = estimate_baseline(kernels, data, k, n_threads);
+    subtract_clip(kernels, data, baseline, n_threads);
+    return data;
+  }
+
+  template <typename I, typename D>
+  compressed_matrix<I, D> preprocess(kernel_table<I, I, D> const &kernels,
+                                     compressed_matrix<I, D> data,
+                                     double const peak_width,
+                                     unsigned const n_threads)
+  {
+    data = remove_noise(kernels, std::move(data), peak_width, n_threads);
+    return remove_baseline(kernels, std::move(data),
+                           static_cast<I>(10 * peak_width), n_threads);
+  }
+} // namespace spectre
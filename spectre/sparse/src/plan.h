@@ -0,0 +1,222 @@
+#pragma once
+
+#include "parallel.h"
+#include "rolling.h"
+#include "ranges.h"
+#include "span.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace spectre {
+  // The output structure of `rolling_csr` for a fixed sparsity pattern and
+  // window. Since the output columns do not depend on the kernel, they are
+  // computed once and every kernel run against the plan only writes values,
+  // in parallel over rows, as the offset of each row is known in advance.
+  // A matrix run against the plan must have exactly the same pattern,
+  // otherwise its rows would not fit the output, so the plan keeps a
+  // fingerprint of the pattern of each block of rows rather than a copy of
+  // it. It also owns the scratch space of the kernels, one per worker, sized
+  // once for the longest row and reused by every block and every run. Runs
+  // against one plan take turns on its scratch space.
+  template <typename J> struct rolling_plan {
+    using index_type = J;
+
+    // The number of rows of a block, the unit of the work and of the checks
+    static constexpr std::ptrdiff_t block = 256;
+
+    template <typename I>
+    rolling_plan(cspan<I> const A_rows, cspan<I> const A_cols,
+                 I const A_n_cols, J const window, unsigned const n_threads)
+        : _rows(A_rows.size()), _n_cols{static_cast<J>(A_n_cols)},
+          _window{window}, _n_threads{n_threads},
+          _scratch(resolve_threads(n_threads)),
+          _lock{std::make_unique<std::mutex>()}
+    {
+      if (window < 1)
+        throw std::invalid_argument{"the window must be positive"};
+      if (A_rows.empty() || A_rows.front() != 0 ||
+          static_cast<std::size_t>(A_rows.back()) > A_cols.size() ||
+          !std::is_sorted(A_rows.begin(), A_rows.end()))
+        throw std::invalid_argument{"the row offsets must ascend from 0 "
+                                    "within the column indices"};
+
+      _nnz = static_cast<std::size_t>(A_rows.back());
+      for (auto const [a, b] : adjacent(A_rows))
+        _max_row_nnz = std::max(_max_row_nnz, static_cast<std::size_t>(b - a));
+
+      auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+      _digests.resize(static_cast<std::size_t>((n_rows + block - 1) / block));
+      parallel_for(n_rows, block, n_threads, [&](auto const a, auto const b) {
+        for (auto row = a; row < b; ++row)
+          if (!is_row(A_cols.slice(A_rows[row], A_rows[row + 1]), A_n_cols))
+            throw std::invalid_argument{"the column indices of a row must "
+                                        "ascend within the columns"};
+        _digests[a / block] = digest(A_rows, A_cols, a, b);
+      });
+
+      auto const size = rolling_alloc_csr(A_rows, A_cols, rows_span(),
+                                          A_n_cols, window);
+      _cols.resize(size);
+
+      parallel_for(n_rows, block, n_threads, [&](auto const a, auto const b) {
+        for (auto row = a; row < b; ++row) {
+          auto out = _cols.begin() + _rows[row];
+          rolling_cols(A_cols.slice(A_rows[row], A_rows[row + 1]), A_n_cols,
+                       window, [&](J const col) { *out++ = col; });
+        }
+      });
+    }
+
+    // Runs `rows_kernel`, an instantiation of `rolling_rows_csr`, in parallel
+    // over blocks of rows. Every block is compared with the pattern of the
+    // plan before its values are written.
+    template <typename I, typename D, typename F>
+    void execute(F const rows_kernel, cspan<I> const A_rows,
+                 cspan<I> const A_cols, cspan<D> const A_data,
+                 span<D> const B_data) const
+    {
+      constexpr auto mismatch = "the matrix does not match the sparsity "
+                                "pattern of the rolling plan";
+      if (A_rows.size() != _rows.size() || A_rows.front() != 0 ||
+          static_cast<std::size_t>(A_rows.back()) != _nnz ||
+          A_cols.size() < _nnz || A_data.size() < _nnz)
+        throw std::invalid_argument{mismatch};
+      if (B_data.size() != _cols.size())
+        throw std::invalid_argument{"the output size does not match the "
+                                    "rolling plan"};
+
+      auto const n_rows = static_cast<std::ptrdiff_t>(_rows.size()) - 1;
+      auto const A_n_cols = static_cast<I>(_n_cols);
+
+      // the kernels hold at most the nonzeros of a window of a row
+      std::lock_guard<std::mutex> const lock{*_lock};
+      auto const size =
+          std::min(static_cast<std::size_t>(_window), _max_row_nnz) *
+          sizeof(D);
+      for (auto &scratch : _scratch)
+        if (scratch.size() < size)
+          scratch.resize(size);
+
+      parallel_for(n_rows, block, _n_threads,
+                   [&](auto const a, auto const b, unsigned const worker) {
+                     if (digest(A_rows, A_cols, a, b) != _digests[a / block])
+                       throw std::invalid_argument{mismatch};
+                     auto &scratch = _scratch[worker];
+                     rows_kernel(A_rows, A_cols, A_data, rows(), B_data,
+                                 A_n_cols, _window, a, b,
+                                 span<std::byte>{scratch.data(),
+                                                 scratch.size()});
+                   });
+    }
+
+    template <template <typename, typename> typename Krn, typename I,
+              typename D>
+    void execute(cspan<I> const A_rows, cspan<I> const A_cols,
+                 cspan<D> const A_data, span<D> const B_data) const
+    {
+      execute(rolling_rows_csr<I, J, D, Krn>, A_rows, A_cols, A_data, B_data);
+    }
+
+    cspan<J> rows() const noexcept
+    {
+      return cspan<J>{_rows.data(), _rows.size()};
+    }
+
+    cspan<J> cols() const noexcept
+    {
+      return cspan<J>{_cols.data(), _cols.size()};
+    }
+
+    J window() const noexcept
+    {
+      return _window;
+    }
+
+  private:
+    span<J> rows_span() noexcept
+    {
+      return span<J>{_rows.data(), _rows.size()};
+    }
+
+    // Whether the column indices of a row are strictly ascending within
+    // `[0, A_n_cols)`
+    template <typename I>
+    static bool is_row(cspan<I> const cols, I const A_n_cols) noexcept
+    {
+      if (cols.empty())
+        return true;
+      if constexpr (std::is_signed_v<I>)
+        if (cols.front() < 0)
+          return false;
+      return cols.back() < A_n_cols &&
+             std::adjacent_find(cols.begin(), cols.end(),
+                                std::greater_equal<I>{}) == cols.end();
+    }
+
+    // A fingerprint of the pattern of the rows `[a, b)`, i.e. of their sizes
+    // and column indices as `J`, so indices of any type compare equal
+    template <typename I>
+    static std::uint64_t digest(cspan<I> const A_rows, cspan<I> const A_cols,
+                                std::ptrdiff_t const a,
+                                std::ptrdiff_t const b) noexcept
+    {
+      auto hash = static_cast<std::uint64_t>(b - a);
+      auto const mix = [&](auto const value) {
+        hash = (hash ^ static_cast<std::uint64_t>(static_cast<J>(value))) *
+               0x9e3779b97f4a7c15u;
+        hash ^= hash >> 32;
+      };
+      for (auto row = a; row < b; ++row) {
+        mix(A_rows[row + 1] - A_rows[row]);
+        for (auto i = A_rows[row]; i < A_rows[row + 1]; ++i)
+          mix(A_cols[i]);
+      }
+      return hash;
+    }
+
+    std::vector<J> _rows;
+    std::vector<J> _cols;
+    J _n_cols;
+    J _window;
+    unsigned _n_threads;
+    std::size_t _nnz = 0;
+    std::size_t _max_row_nnz = 0;
+    std::vector<std::uint64_t> _digests;
+    // aligned for any value type by the default `operator new`
+    mutable std::vector<std::vector<std::byte>> _scratch;
+    std::unique_ptr<std::mutex> _lock;
+  };
+
+  // Runs `rows_kernel`, an instantiation of `rolling_windows_rows_csr`, in
+  // parallel over blocks of rows, the outputs being allocated by
+  // `rolling_windows_alloc_csr`
+  template <typename I, typename J, typename D, typename F>
+  void rolling_windows_csr(F const rows_kernel, cspan<I> const A_rows,
+                           cspan<I> const A_cols, cspan<D> const A_data,
+                           cspan<J> const windows, cspan<J> const B_rows,
+                           span<J> const B_cols, span<D> const B_data,
+                           I const A_n_cols, unsigned const n_threads)
+  {
+    if (B_rows.size() != windows.size() * A_rows.size())
+      throw std::invalid_argument{"the output row offsets do not match the "
+                                  "windows"};
+    if (windows.size() &&
+        (B_cols.size() != static_cast<std::size_t>(B_rows.back()) ||
+         B_data.size() != B_cols.size()))
+      throw std::invalid_argument{"the output size does not match the row "
+                                  "offsets"};
+
+    auto const n_rows = static_cast<std::ptrdiff_t>(A_rows.size()) - 1;
+    parallel_for(n_rows, 256, n_threads, [&](auto const a, auto const b) {
+      rows_kernel(A_rows, A_cols, A_data, windows, B_rows, B_cols, B_data,
+                  A_n_cols, a, b);
+    });
+  }
+} // namespace spectre
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "isa.h"
+#include "span.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace spectre {
+  inline namespace SPECTRE_ISA {
+    // Clips the values of a CSR matrix into `[lower, upper]` and removes the
+    // entries that became zero in a single in-place pass, the rows are
+    // compacted towards the front. Returns the new number of nonzeros.
+    template <typename I, typename D>
+    I clip_prune_csr(span<I> const A_rows, span<I> const A_cols,
+                     span<D> const A_data, D const lower,
+                     D const upper) noexcept
+    {
+      auto const n_rows = A_rows.size() - 1;
+      auto out = static_cast<std::size_t>(A_rows[0]);
+      auto a = out;
+
+      for (std::size_t row = 0; row < n_rows; ++row) {
+        auto const b = static_cast<std::size_t>(A_rows[row + 1]);
+        for (auto p = a; p < b; ++p) {
+          auto const value = std::clamp(A_data[p], lower, upper);
+          if (value != 0) {
+            A_cols[out] = A_cols[p];
+            A_data[out] = value;
+            ++out;
+          }
+        }
+        A_rows[row + 1] = static_cast<I>(out);
+        a = b;
+      }
+      return static_cast<I>(out);
+    }
+
+    // Clips the difference `A - B` of two canonical CSR matrices of the same
+    // shape into `[lower, upper]` in a single pass merging their rows, only
+    // the nonzeros are written to C. `C_cols` and `C_data` need room for the
+    // nonzeros of both operands. Returns the number of nonzeros of C.
+    template <typename I, typename D>
+    I subtract_clip_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                        cspan<D> const A_data, cspan<I> const B_rows,
+                        cspan<I> const B_cols, cspan<D> const B_data,
+                        span<I> const C_rows, span<I> const C_cols,
+                        span<D> const C_data, D const lower,
+                        D const upper) noexcept
+    {
+      auto const n_rows = A_rows.size() - 1;
+      std::size_t out = 0;
+
+      auto const emit = [&](I const col, D const value) {
+        auto const clipped = std::clamp(value, lower, upper);
+        if (clipped != 0) {
+          assert(out < C_cols.size());
+          C_cols[out] = col;
+          C_data[out] = clipped;
+          ++out;
+        }
+      };
+
+      C_rows[0] = 0;
+      for (std::size_t row = 0; row < n_rows; ++row) {
+        auto a = static_cast<std::size_t>(A_rows[row]);
+        auto b = static_cast<std::size_t>(B_rows[row]);
+        auto const a_end = static_cast<std::size_t>(A_rows[row + 1]);
+        auto const b_end = static_cast<std::size_t>(B_rows[row + 1]);
+
+        while (a < a_end && b < b_end) {
+          if (A_cols[a] < B_cols[b]) {
+            emit(A_cols[a], A_data[a]);
+            ++a;
+          } else if (B_cols[b] < A_cols[a]) {
+            emit(B_cols[b], -B_data[b]);
+            ++b;
+          } else {
+            emit(A_cols[a], A_data[a] - B_data[b]);
+            ++a;
+            ++b;
+          }
+        }
+        for (; a < a_end; ++a)
+          emit(A_cols[a], A_data[a]);
+        for (; b < b_end; ++b)
+          emit(B_cols[b], -B_data[b]);
+
+        C_rows[row + 1] = static_cast<I>(out);
+      }
+      return static_cast<I>(out);
+    }
+  } // namespace SPECTRE_ISA
+} // namespace spectre
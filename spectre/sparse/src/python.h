@@ -15,6 +15,11 @@ namespace spectre {
 
   template <typename> struct py_dtype;
 
+  template <> struct py_dtype<npy_int16> {
+    constexpr static const int value = NPY_INT16;
+    constexpr static const char name[] = "int16";
+  };
+
   template <> struct py_dtype<npy_int32> {
     constexpr static const int value = NPY_INT32;
     constexpr static const char name[] = "int32";
@@ -25,6 +30,21 @@ namespace spectre {
     constexpr static const char name[] = "int64";
   };
 
+  template <> struct py_dtype<npy_uint16> {
+    constexpr static const int value = NPY_UINT16;
+    constexpr static const char name[] = "uint16";
+  };
+
+  template <> struct py_dtype<npy_uint32> {
+    constexpr static const int value = NPY_UINT32;
+    constexpr static const char name[] = "uint32";
+  };
+
+  template <> struct py_dtype<npy_uint64> {
+    constexpr static const int value = NPY_UINT64;
+    constexpr static const char name[] = "uint64";
+  };
+
   template <> struct py_dtype<npy_float32> {
     constexpr static const int value = NPY_FLOAT32;
     constexpr static const char name[] = "float32";
@@ -35,6 +55,26 @@ namespace spectre {
     constexpr static const char name[] = "float64";
   };
 
+  // Wraps memory owned by a C++ object as a read-only numpy array, the array
+  // keeps `owner` alive for as long as it exists
+  template <typename T>
+  pybind11::object py_view(cspan<T> const view, pybind11::handle const owner)
+  {
+    npy_intp dims[] = {static_cast<npy_intp>(view.size())};
+    auto const op = PyArray_New(&PyArray_Type, 1, dims, py_dtype<T>::value,
+                                nullptr, const_cast<T *>(view.begin()), 0,
+                                NPY_ARRAY_C_CONTIGUOUS | NPY_ARRAY_ALIGNED,
+                                nullptr);
+    if (!op)
+      throw pybind11::error_already_set{};
+
+    auto result = pybind11::reinterpret_steal<pybind11::object>(op);
+    auto const arr = reinterpret_cast<PyArrayObject *>(op);
+    if (PyArray_SetBaseObject(arr, owner.inc_ref().ptr()) < 0)
+      throw pybind11::error_already_set{};
+    return result;
+  }
+
   template <typename T> struct py_array {
     constexpr static const int dtype = py_dtype<std::decay_t<T>>::value;
     constexpr static const int ndims = 1;
@@ -165,6 +205,12 @@ namespace spectre {
       return py_array{PyArray_FromAny(op, type, 0, 0, flags, nullptr)};
     }
 
+    static py_array borrow(PyObject *op) noexcept
+    {
+      Py_XINCREF(op);
+      return py_array{op};
+    }
+
     friend void swap(py_array &lhs, py_array &rhs) noexcept
     {
       lhs.swap(rhs);
@@ -180,31 +226,6 @@ namespace spectre {
 } // namespace spectre
 
 namespace pybind11::detail {
-  template <typename T> struct type_caster<::spectre::span<T>> {
-    using value_t = ::spectre::span<T>;
-    using dtype_t = ::spectre::py_dtype<std::decay_t<T>>;
-    using data_t = typename value_t::pointer;
-    using size_t = typename value_t::size_type;
-
-    PYBIND11_TYPE_CASTER(value_t, _("array[") + _(dtype_t::name) + _("]"));
-
-    bool load(handle op, bool)
-    {
-      auto const arr = reinterpret_cast<PyArrayObject *>(op.ptr());
-      auto const flags =
-          std::is_const_v<T> ? NPY_ARRAY_IN_ARRAY : NPY_ARRAY_OUT_ARRAY;
-
-      if (!PyArray_Check(op.ptr()) ||
-          !PyArray_EquivTypenums(PyArray_TYPE(arr), dtype_t::value) ||
-          PyArray_NDIM(arr) != 1 || !PyArray_CHKFLAGS(arr, flags))
-        return false;
-
-      value = value_t{static_cast<data_t>(PyArray_DATA(arr)),
-                      static_cast<size_t>(PyArray_SIZE(arr))};
-      return true;
-    }
-  };
-
   template <typename T> struct type_caster<::spectre::py_array<T>> {
     using value_t = ::spectre::py_array<T>;
 
@@ -213,13 +234,14 @@ namespace pybind11::detail {
       _(::spectre::py_dtype<std::decay_t<T>>::name) + _("]"));
     // clang-format on
 
-    bool load(handle source, bool convert)
+    // NOTE: an array is never converted implicitly, a copy must be requested
+    // explicitly by `value_t::convert`
+    bool load(handle source, bool)
     {
-      if (!convert && !value_t::check(source.ptr()))
+      if (!value_t::check(source.ptr()))
         return false;
-      if (value = value_t::convert(source.ptr()); !value)
-        PyErr_Clear();
-      return bool(value);
+      value = value_t::borrow(source.ptr());
+      return true;
     }
 
     static handle cast(value_t source, return_value_policy, handle)
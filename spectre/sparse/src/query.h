@@ -0,0 +1,54 @@
+#pragma once
+
+#include "parallel.h"
+#include "span.h"
+#include <algorithm>
+
+namespace spectre {
+  // Extracts a chromatogram of every target `mz[i] +- mz[i] * ppm * 1e-6` over
+  // the scans `[row_lo, row_hi)` of a CSC matrix into the i-th row of the
+  // (targets x scans) dense `B_data`. The m/z columns are found by a binary
+  // search in `mz_scales` and the first scan of each column by a binary search
+  // in its row indices, so only the nonzeros inside the query are visited.
+  template <typename I, typename D>
+  void xic_query_csc(cspan<I> const A_cols, cspan<I> const A_rows,
+                     cspan<D> const A_data, cspan<double> const mz_scales,
+                     cspan<double> const mz, double const ppm, I const row_lo,
+                     I const row_hi, span<D> const B_data, bool const max_pool,
+                     unsigned const n_threads)
+  {
+    auto const n_targets = static_cast<std::ptrdiff_t>(mz.size());
+    auto const n_scans = static_cast<std::ptrdiff_t>(row_hi - row_lo);
+
+    assert(B_data.size() == static_cast<std::size_t>(n_targets * n_scans));
+    assert(A_cols.size() == mz_scales.size() + 1);
+
+    parallel_for(n_targets, 16, n_threads, [&](auto const a, auto const b) {
+      for (auto i = a; i < b; ++i) {
+        auto const out = B_data.begin() + i * n_scans;
+        std::fill(out, out + n_scans, static_cast<D>(0));
+
+        auto const tol = mz[i] * ppm * 1e-6;
+        auto const col_lo = std::lower_bound(mz_scales.begin(),
+                                             mz_scales.end(), mz[i] - tol) -
+                            mz_scales.begin();
+        auto const col_hi = std::upper_bound(mz_scales.begin(),
+                                             mz_scales.end(), mz[i] + tol) -
+                            mz_scales.begin();
+
+        for (auto col = col_lo; col < col_hi; ++col) {
+          auto const rows = A_rows.slice(A_cols[col], A_cols[col + 1]);
+          auto const data = A_data.slice(A_cols[col], A_cols[col + 1]);
+
+          auto iter = std::lower_bound(rows.begin(), rows.end(), row_lo);
+          auto value = data.begin() + (iter - rows.begin());
+
+          for (; iter < rows.end() && *iter < row_hi; ++iter, ++value) {
+            auto &dst = out[*iter - row_lo];
+            dst = max_pool ? std::max(dst, *value) : dst + *value;
+          }
+        }
+      }
+    });
+  }
+} // namespace spectre
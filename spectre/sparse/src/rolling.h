@@ -1,182 +1,691 @@
 #pragma once
 
+#include "buffer.h"
+#include "isa.h"
+#include "kernels.h"
+#include "ranges.h"
 #include "span.h"
 #include <algorithm>
-#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
 
 namespace spectre {
-  template <typename I, typename J>
-  J rolling_alloc_csr(cspan<I> const A_rows, cspan<I> const A_cols,
-                      span<J> const B_rows, I const A_n_cols,
-                      J const window) noexcept
-  {
-    auto out = B_rows.begin();
-    auto size = static_cast<J>(0);
-    auto const wnd_lhs = window / 2;
-    auto const wnd_rhs = (window + 1) / 2;
-
-    *out++ = size;
-    for (auto const [a, b] : adjacent(A_rows)) {
-      auto beg = A_cols.begin() + a;
-      auto end = A_cols.begin() + b;
-
-      if (beg != end) {
-        size += std::min(wnd_lhs, static_cast<J>(beg[0]));
-        for (--end; beg < end; ++beg)
-          size += std::min(window, static_cast<J>(beg[1] - beg[0]));
-        size += std::min(wnd_rhs, static_cast<J>(A_n_cols - beg[0]));
-      }
+  inline namespace SPECTRE_ISA {
+    // The number of the output positions of one row of `rolling_csr`
+    template <typename I, typename J>
+    J rolling_row_size(cspan<I> const cols, I const A_n_cols,
+                       J const window) noexcept
+    {
+      if (cols.size() == 0)
+        return 0;
+
+      auto const wnd_lhs = window / 2;
+      auto const wnd_rhs = (window + 1) / 2;
+
+      auto size = std::min(wnd_lhs, static_cast<J>(cols[0]));
+      for (std::size_t i = 1; i < cols.size(); ++i)
+        size += std::min(window, static_cast<J>(cols[i] - cols[i - 1]));
+      return size + std::min(wnd_rhs, static_cast<J>(A_n_cols - cols.back()));
+    }
+
+    template <typename I, typename J>
+    J rolling_alloc_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                        span<J> const B_rows, I const A_n_cols,
+                        J const window) noexcept
+    {
+      auto out = B_rows.begin();
+      auto size = static_cast<J>(0);
+
       *out++ = size;
+      for (auto const [a, b] : adjacent(A_rows)) {
+        size += rolling_row_size(A_cols.slice(a, b), A_n_cols, window);
+        *out++ = size;
+      }
+      return size;
     }
-    return size;
-  }
-
-  template <typename I, typename J, typename D,
-            template <typename, typename> typename Krn>
-  void rolling_csr(cspan<I> const A_rows, cspan<I> const A_cols,
-                   cspan<D> const A_data, span<J> const B_cols,
-                   span<D> const B_data, I const A_n_cols,
-                   J const window) noexcept
-  {
-    auto kernel = Krn<J, D>{window};
-    auto const wnd_lhs = (window - 1) / 2;
-
-    auto out_col = B_cols.begin();
-    auto out_val = B_data.begin();
-
-    for (auto const [a, b] : adjacent(A_rows)) {
-      auto const cols = A_cols.slice(a, b);
-      auto const data = A_data.slice(a, b);
+
+    // The total size `rolling_alloc_csr` computes, without the row offsets
+    template <typename I, typename J>
+    J rolling_size_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                       I const A_n_cols, J const window) noexcept
+    {
+      auto size = static_cast<J>(0);
+      for (auto const [a, b] : adjacent(A_rows))
+        size += rolling_row_size(A_cols.slice(a, b), A_n_cols, window);
+      return size;
+    }
+
+    // `rolling_alloc_csr` of every window in `windows` in one pass over the
+    // rows. The row offsets of the k-th window are `B_rows[k * (n_rows + 1)]`
+    // to `B_rows[(k + 1) * (n_rows + 1) - 1]` and index the concatenation of
+    // all outputs, the total size of which is returned.
+    template <typename I, typename J>
+    J rolling_windows_alloc_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                                cspan<J> const windows, span<J> const B_rows,
+                                I const A_n_cols) noexcept
+    {
+      auto const n_rows = A_rows.size() - 1;
+      auto const stride = A_rows.size();
+
+      for (std::size_t row = 0; row < n_rows; ++row) {
+        auto const cols = A_cols.slice(A_rows[row], A_rows[row + 1]);
+        for (std::size_t k = 0; k < windows.size(); ++k)
+          B_rows[k * stride + row + 1] =
+              rolling_row_size(cols, A_n_cols, windows[k]);
+      }
+
+      auto size = static_cast<J>(0);
+      for (std::size_t k = 0; k < windows.size(); ++k) {
+        B_rows[k * stride] = size;
+        for (std::size_t row = 1; row <= n_rows; ++row)
+          B_rows[k * stride + row] = size += B_rows[k * stride + row];
+      }
+      return size;
+    }
+
+    // Visits the output positions of one row of `rolling_csr`, i.e. every
+    // column whose window reaches at least one nonzero, in ascending order
+    template <typename I, typename J, typename F>
+    void rolling_cols(cspan<I> const cols, I const A_n_cols, J const window,
+                      F &&emit) noexcept
+    {
+      auto const wnd_lhs = (window - 1) / 2;
 
       auto start = -wnd_lhs;
       auto stop = A_n_cols - wnd_lhs;
       auto col_iter = cols.begin();
-      auto val_iter = data.begin();
 
       while (start < stop && col_iter < cols.end()) {
         start = std::max(start, *col_iter - window + 1);
+        emit(start + wnd_lhs);
+
+        if (++start > *col_iter)
+          ++col_iter;
+      }
+    }
 
-        kernel.init();
-        auto krn_col_iter = col_iter;
-        auto krn_val_iter = val_iter;
+    // Computes one row of `rolling_csr`, calling `emit(col, kernel)` with the
+    // kernel holding the window centered at each output position. The window
+    // slides and jumps over the gaps between the nonzeros, every nonzero is
+    // pushed and popped once and the zeros in between in bulk, so a step costs
+    // only the update of the kernel by the values entering and leaving it.
+    template <typename I, typename J, typename D, typename K, typename F>
+    void rolling_row(cspan<I> const cols, cspan<D> const data, I const A_n_cols,
+                     J const window, K &kernel, F &&emit)
+    {
+      auto const wnd_lhs = (window - 1) / 2;
+      auto const size = cols.size();
+
+      // the kernel holds the positions [lo, hi), the nonzeros [rem, add)
+      J lo = 0;
+      J hi = 0;
+      std::size_t rem = 0;
+      std::size_t add = 0;
+      bool empty = true;
+
+      rolling_cols(cols, A_n_cols, window, [&](J const col) {
+        auto const start = col - wnd_lhs;
+        auto const stop = start + window;
+
+        if (empty || start >= hi) {
+          kernel.init();
+          while (add < size && static_cast<J>(cols[add]) < start)
+            ++add;
+          lo = hi = start;
+          rem = add;
+          empty = false;
+        }
 
-        for (auto index = start; index < start + window; ++index) {
-          if (krn_col_iter < cols.end() && index == *krn_col_iter) {
-            kernel.push(*krn_val_iter);
-            ++krn_col_iter;
-            ++krn_val_iter;
+        while (lo < start) {
+          if (rem < add && static_cast<J>(cols[rem]) < start) {
+            auto const at = static_cast<J>(cols[rem]);
+            if (lo < at)
+              kernel.pop_zeros(static_cast<std::size_t>(at - lo));
+            kernel.pop(data[rem++]);
+            lo = at + 1;
           } else {
-            kernel.push(0);
+            kernel.pop_zeros(static_cast<std::size_t>(start - lo));
+            lo = start;
           }
         }
 
-        assert(out_col < B_cols.end());
-        assert(out_val < B_data.end());
-        assert(0 <= start + wnd_lhs);
-        assert(start + wnd_lhs < A_n_cols);
-
-        *out_col++ = start + wnd_lhs;
-        *out_val++ = kernel.pop();
-
-        if (++start > *col_iter) {
-          ++col_iter;
-          ++val_iter;
+        while (hi < stop) {
+          if (add < size && static_cast<J>(cols[add]) < stop) {
+            auto const at = static_cast<J>(cols[add]);
+            if (hi < at)
+              kernel.push_zeros(static_cast<std::size_t>(at - hi));
+            kernel.push(data[add++]);
+            hi = at + 1;
+          } else {
+            kernel.push_zeros(static_cast<std::size_t>(stop - hi));
+            hi = stop;
+          }
         }
-      }
-    }
-  }
 
-  template <typename I, typename T> struct min_kernel {
-    explicit min_kernel(I const) noexcept
-    {}
+        assert(0 <= col && col < A_n_cols);
+        emit(col, kernel);
+      });
+    }
 
-    void init() noexcept
+    template <typename I, typename J, typename D,
+              template <typename, typename> typename Krn>
+    void rolling_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                     cspan<D> const A_data, span<J> const B_cols,
+                     span<D> const B_data, I const A_n_cols,
+                     J const window)
     {
-      _result = std::numeric_limits<T>::max();
+      auto kernel = Krn<J, D>{window};
+
+      auto out_col = B_cols.begin();
+      auto out_val = B_data.begin();
+
+      for (auto const [a, b] : adjacent(A_rows)) {
+        rolling_row(A_cols.slice(a, b), A_data.slice(a, b), A_n_cols, window,
+                    kernel, [&](J const col, auto &krn) {
+                      assert(out_col < B_cols.end());
+                      assert(out_val < B_data.end());
+
+                      *out_col++ = col;
+                      *out_val++ = krn.result();
+                    });
+      }
     }
 
-    void push(T const value) noexcept
+    // Computes the rows `[a, b)` of `rolling_csr` into the values of an output
+    // whose row offsets `B_rows` were already computed by `rolling_alloc_csr`,
+    // so disjoint ranges of rows can be computed independently. The kernel
+    // starts in `scratch`, which holds `min(window, nnz)` values of the longest
+    // row so that no block allocates. A row not filling exactly its range of
+    // `B_rows` was not the one the offsets were computed of, and is rejected.
+    template <typename I, typename J, typename D,
+              template <typename, typename> typename Krn>
+    void rolling_rows_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                          cspan<D> const A_data, cspan<J> const B_rows,
+                          span<D> const B_data, I const A_n_cols,
+                          J const window, std::ptrdiff_t const a,
+                          std::ptrdiff_t const b, span<std::byte> const scratch)
     {
-      _result = std::min(_result, value);
+      constexpr auto mismatch = "the output rows do not match the sparsity "
+                                "pattern";
+      auto kernel = Krn<J, D>{window, scratch};
+
+      for (auto row = a; row < b; ++row) {
+        auto out = B_data.begin() + B_rows[row];
+        auto const end = B_data.begin() + B_rows[row + 1];
+        rolling_row(A_cols.slice(A_rows[row], A_rows[row + 1]),
+                    A_data.slice(A_rows[row], A_rows[row + 1]), A_n_cols,
+                    window, kernel, [&](J const, auto &krn) {
+                      if (out == end)
+                        throw std::invalid_argument{mismatch};
+                      *out++ = krn.result();
+                    });
+        if (out != end)
+          throw std::invalid_argument{mismatch};
+      }
     }
 
-    auto pop() const noexcept
+    // Computes the rows `[a, b)` of `rolling_csr` for every window in
+    // `windows` into the outputs allocated by `rolling_windows_alloc_csr`.
+    // The nonzeros within any window form a range of its row, so the prefix
+    // sums (or a sparse table of the minima or maxima) of the row, built once,
+    // answer every window of every size in O(1). Only the min, max, mean, sum
+    // and count are supported, the median has no such decomposition.
+    template <typename I, typename J, typename D, rolling_op Op>
+    void rolling_windows_rows_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                                  cspan<D> const A_data,
+                                  cspan<J> const windows,
+                                  cspan<J> const B_rows, span<J> const B_cols,
+                                  span<D> const B_data, I const A_n_cols,
+                                  std::ptrdiff_t const a,
+                                  std::ptrdiff_t const b)
     {
-      return _result;
+      static_assert(Op != rolling_median);
+      constexpr bool extremum = Op == rolling_min || Op == rolling_max;
+
+      auto const better = [](D const x, D const y) {
+        return Op == rolling_min ? x < y : y < x;
+      };
+
+      auto const stride = A_rows.size();
+      buffer<double> prefix;
+      buffer<D> table;
+
+      for (auto row = a; row < b; ++row) {
+        auto const cols = A_cols.slice(A_rows[row], A_rows[row + 1]);
+        auto const data = A_data.slice(A_rows[row], A_rows[row + 1]);
+        auto const n = cols.size();
+
+        if constexpr (extremum) {
+          // level l holds the extrema of the runs of 2^l nonzeros
+          table.assign(data.begin(), data.end());
+          for (std::size_t half = 1; 2 * half <= n; half *= 2) {
+            auto const prev = table.size() - n;
+            for (std::size_t i = 0; i < n; ++i)
+              table.push_back(i + half < n && better(table[prev + i + half],
+                                                     table[prev + i])
+                                  ? table[prev + i + half]
+                                  : table[prev + i]);
+          }
+        } else {
+          prefix.resize(n + 1);
+          prefix[0] = 0;
+          for (std::size_t i = 0; i < n; ++i)
+            prefix[i + 1] = prefix[i] + (Op == rolling_count
+                                             ? static_cast<double>(data[i] != 0)
+                                             : static_cast<double>(data[i]));
+        }
+
+        for (std::size_t k = 0; k < windows.size(); ++k) {
+          auto const window = windows[k];
+          auto const wnd_lhs = (window - 1) / 2;
+          auto out = static_cast<std::size_t>(B_rows[k * stride + row]);
+          if (B_rows[k * stride + row + 1] - B_rows[k * stride + row] !=
+              rolling_row_size(cols, A_n_cols, window))
+            throw std::invalid_argument{"the output row offsets do not match "
+                                        "the windows"};
+
+          // the nonzeros of the current window are [lo, hi)
+          std::size_t lo = 0;
+          std::size_t hi = 0;
+
+          rolling_cols(cols, A_n_cols, window, [&](J const col) {
+            auto const start = col - wnd_lhs;
+            while (lo < n && static_cast<J>(cols[lo]) < start)
+              ++lo;
+            while (hi < n && static_cast<J>(cols[hi]) < start + window)
+              ++hi;
+
+            D value;
+            if constexpr (extremum) {
+              std::size_t level = 0;
+              while ((std::size_t{2} << level) <= hi - lo)
+                ++level;
+              auto const x = table[level * n + lo];
+              auto const y = table[level * n + hi - (std::size_t{1} << level)];
+              value = better(y, x) ? y : x;
+              if (static_cast<J>(hi - lo) < window &&
+                  better(static_cast<D>(0), value))
+                value = 0;
+            } else {
+              value = static_cast<D>(prefix[hi] - prefix[lo]);
+              if constexpr (Op == rolling_mean)
+                value /= static_cast<D>(window);
+            }
+
+            assert(out < static_cast<std::size_t>(
+                             B_rows[k * stride + row + 1]));
+            B_cols[out] = col;
+            B_data[out] = value;
+            ++out;
+          });
+        }
+      }
     }
 
-  private:
-    T _result;
-  };
+    // The kernels see a window sliding along a row, `push` and `pop` add a
+    // value at its right end and remove the value at its left end, while
+    // `push_zeros` and `pop_zeros` do the same for a run of zeros at once.
+    // `init` empties the window and `result` is the statistic of the window.
+    // The kernels are built of the window and an optional scratch storage,
+    // which the ones holding the nonzeros of the window start their buffer in.
+
+    // The minimum (or maximum) over a monotonic deque of the nonzeros, the
+    // zeros only need to be counted. The deque is `_values` from `_front`,
+    // the popped values are dropped at once when the buffer is full.
+    template <typename I, typename T, typename Compare> struct extremum_kernel {
+      explicit extremum_kernel(I const, span<std::byte> const scratch = {})
+          : _values{scratch}
+      {}
+
+      void init() noexcept
+      {
+        _values.clear();
+        _front = 0;
+        _zeros = 0;
+      }
 
-  template <typename I, typename T> struct max_kernel {
-    explicit max_kernel(I const) noexcept
-    {}
+      void push(T const value)
+      {
+        while (_values.size() > _front && Compare{}(value, _values.back()))
+          _values.pop_back();
+        if (_front && _values.size() == _values.capacity()) {
+          _values.erase(_values.begin(), _values.begin() + _front);
+          _front = 0;
+        }
+        _values.push_back(value);
+      }
 
-    void init() noexcept
-    {
-      _result = std::numeric_limits<T>::min();
-    }
+      void pop(T const value) noexcept
+      {
+        // a value still in the deque is its front, otherwise a later and
+        // strictly better value has already removed it
+        if (_values.size() > _front && _values[_front] == value)
+          ++_front;
+      }
 
-    void push(T const value) noexcept
-    {
-      _result = std::max(_result, value);
-    }
+      void push_zeros(std::size_t const n) noexcept
+      {
+        _zeros += n;
+      }
 
-    auto pop() const noexcept
-    {
-      return _result;
-    }
+      void pop_zeros(std::size_t const n) noexcept
+      {
+        _zeros -= n;
+      }
 
-  private:
-    T _result;
-  };
+      auto result() const noexcept
+      {
+        if (_values.size() == _front)
+          return static_cast<T>(0);
+        if (_zeros && Compare{}(static_cast<T>(0), _values[_front]))
+          return static_cast<T>(0);
+        return _values[_front];
+      }
 
-  template <typename I, typename T> struct mean_kernel {
-    explicit mean_kernel(I const window) noexcept : _window{window}
-    {}
+    private:
+      buffer<T> _values;
+      std::size_t _front = 0;
+      std::size_t _zeros = 0;
+    };
 
-    void init() noexcept
-    {
-      _result = 0;
-    }
+    template <typename I, typename T>
+    using min_kernel = extremum_kernel<I, T, std::less<T>>;
 
-    void push(T const value) noexcept
-    {
-      _result += value;
-    }
+    template <typename I, typename T>
+    using max_kernel = extremum_kernel<I, T, std::greater<T>>;
 
-    auto pop() const noexcept
-    {
-      return _result / _window;
-    }
+    // The sum is reset whenever the window holds no nonzero, so the rounding
+    // errors of the removals do not leave tiny values between the peaks
+    template <typename I, typename T> struct sum_kernel {
+      explicit sum_kernel(I const, span<std::byte> const = {}) noexcept
+      {}
 
-  private:
-    T _result;
-    I const _window;
-  };
+      void init() noexcept
+      {
+        _sum = 0;
+        _size = 0;
+      }
 
-  template <typename I, typename T> struct median_kernel {
-    explicit median_kernel(I const window) noexcept : _buffer(window)
-    {}
+      void push(T const value) noexcept
+      {
+        _sum += value;
+        ++_size;
+      }
 
-    void init() noexcept
-    {
-      _buffer.clear();
-    }
+      void pop(T const value) noexcept
+      {
+        _sum = --_size ? _sum - value : static_cast<T>(0);
+      }
 
-    void push(T const value) noexcept
-    {
-      _buffer.push_back(value);
-    }
+      void push_zeros(std::size_t const) noexcept
+      {}
+
+      void pop_zeros(std::size_t const) noexcept
+      {}
+
+      auto result() const noexcept
+      {
+        return _sum;
+      }
+
+    private:
+      T _sum = 0;
+      std::size_t _size = 0;
+    };
+
+    template <typename I, typename T> struct mean_kernel {
+      explicit mean_kernel(I const window,
+                           span<std::byte> const = {}) noexcept
+          : _sum{window}, _window{window}
+      {}
+
+      void init() noexcept
+      {
+        _sum.init();
+      }
+
+      void push(T const value) noexcept
+      {
+        _sum.push(value);
+      }
+
+      void pop(T const value) noexcept
+      {
+        _sum.pop(value);
+      }
+
+      void push_zeros(std::size_t const) noexcept
+      {}
+
+      void pop_zeros(std::size_t const) noexcept
+      {}
+
+      auto result() const noexcept
+      {
+        return _sum.result() / _window;
+      }
+
+    private:
+      sum_kernel<I, T> _sum;
+      I const _window;
+    };
+
+    // The number of the nonzero values in the window
+    template <typename I, typename T> struct count_kernel {
+      explicit count_kernel(I const, span<std::byte> const = {}) noexcept
+      {}
+
+      void init() noexcept
+      {
+        _count = 0;
+      }
+
+      void push(T const value) noexcept
+      {
+        _count += value != 0;
+      }
+
+      void pop(T const value) noexcept
+      {
+        _count -= value != 0;
+      }
+
+      void push_zeros(std::size_t const) noexcept
+      {}
+
+      void pop_zeros(std::size_t const) noexcept
+      {}
+
+      auto result() const noexcept
+      {
+        return static_cast<T>(_count);
+      }
+
+    private:
+      std::size_t _count = 0;
+    };
+
+    // Keeps the nonzeros sorted and only counts the zeros, which sit between
+    // the negative and the positive values
+    template <typename I, typename T> struct median_kernel {
+      explicit median_kernel(I const window,
+                             span<std::byte> const scratch = {})
+          : _values{scratch}
+      {
+        if (scratch.empty())
+          _values.reserve(static_cast<std::size_t>(window));
+      }
 
-    auto pop() noexcept
+      void init() noexcept
+      {
+        _values.clear();
+        _zeros = 0;
+      }
+
+      void push(T const value)
+      {
+        _values.insert(
+            std::upper_bound(_values.begin(), _values.end(), value), value);
+      }
+
+      void pop(T const value) noexcept
+      {
+        auto const iter =
+            std::lower_bound(_values.begin(), _values.end(), value);
+        assert(iter != _values.end() && !(value < *iter));
+        _values.erase(iter);
+      }
+
+      void push_zeros(std::size_t const n) noexcept
+      {
+        _zeros += n;
+      }
+
+      void pop_zeros(std::size_t const n) noexcept
+      {
+        _zeros -= n;
+      }
+
+      auto result() const noexcept
+      {
+        auto const rank = (_values.size() + _zeros) / 2;
+        auto const negatives = static_cast<std::size_t>(
+            std::lower_bound(_values.begin(), _values.end(),
+                             static_cast<T>(0)) -
+            _values.begin());
+
+        if (rank < negatives)
+          return _values[rank];
+        if (rank < negatives + _zeros)
+          return static_cast<T>(0);
+        return _values[rank - _zeros];
+      }
+
+    private:
+      buffer<T> _values;
+      std::size_t _zeros = 0;
+    };
+
+    // An approximate median over a histogram of `ceil(1 / eps)` buckets
+    // spanning the range `[lo, hi]` set by `range`. It returns the mean of the
+    // bucket holding the median, so the error is at most one bucket width,
+    // i.e. `eps * (hi - lo)`, and zero when the bucket holds equal values
+    // only. The zeros are counted aside and a median among them is exact.
+    template <typename I, typename T> struct median_approx_kernel {
+      median_approx_kernel(I const, T const eps)
+          : _counts(static_cast<std::size_t>(std::ceil(1 / eps))),
+            _sums(_counts.size())
+      {}
+
+      void range(T const lo, T const hi) noexcept
+      {
+        _lo = lo;
+        _scale = hi > lo ? static_cast<T>(_counts.size()) / (hi - lo) : 0;
+        _zero_bucket = bucket(0);
+      }
+
+      void init() noexcept
+      {
+        std::fill(_counts.begin(), _counts.end(), 0);
+        std::fill(_sums.begin(), _sums.end(), static_cast<T>(0));
+        _size = 0;
+        _zeros = 0;
+      }
+
+      void push(T const value) noexcept
+      {
+        ++_size;
+        if (value == 0) {
+          ++_zeros;
+          return;
+        }
+        auto const b = bucket(value);
+        ++_counts[b];
+        _sums[b] += value;
+      }
+
+      void pop(T const value) noexcept
+      {
+        --_size;
+        if (value == 0) {
+          --_zeros;
+          return;
+        }
+        auto const b = bucket(value);
+        _sums[b] = --_counts[b] ? _sums[b] - value : static_cast<T>(0);
+      }
+
+      void push_zeros(std::size_t const n) noexcept
+      {
+        _size += n;
+        _zeros += n;
+      }
+
+      void pop_zeros(std::size_t const n) noexcept
+      {
+        _size -= n;
+        _zeros -= n;
+      }
+
+      auto result() const noexcept
+      {
+        auto rank = _size / 2;
+        for (std::size_t b = 0;; ++b) {
+          auto const zeros = b == _zero_bucket ? _zeros : 0;
+          if (rank < _counts[b] + zeros)
+            return zeros ? static_cast<T>(0)
+                         : _sums[b] / static_cast<T>(_counts[b]);
+          rank -= _counts[b] + zeros;
+        }
+      }
+
+    private:
+      std::size_t bucket(T const value) const noexcept
+      {
+        return std::min(static_cast<std::size_t>((value - _lo) * _scale),
+                        _counts.size() - 1);
+      }
+
+      buffer<std::size_t> _counts;
+      buffer<T> _sums;
+      std::size_t _size = 0;
+      std::size_t _zeros = 0;
+      std::size_t _zero_bucket = 0;
+      T _lo = 0;
+      T _scale = 0;
+    };
+
+    // `rolling_csr` of `median_approx_kernel`, where the histogram of every
+    // row spans the values of the row and the zeros it is padded with
+    template <typename I, typename J, typename D>
+    void rolling_median_approx_csr(cspan<I> const A_rows, cspan<I> const A_cols,
+                                   cspan<D> const A_data, span<J> const B_cols,
+                                   span<D> const B_data, I const A_n_cols,
+                                   J const window, D const eps)
     {
-      std::sort(_buffer.begin(), _buffer.end());
-      return _buffer[_buffer.size() / 2];
+      auto kernel = median_approx_kernel<J, D>{window, eps};
+
+      auto out_col = B_cols.begin();
+      auto out_val = B_data.begin();
+
+      for (auto const [a, b] : adjacent(A_rows)) {
+        auto const data = A_data.slice(a, b);
+        auto const [lo, hi] = std::minmax_element(data.begin(), data.end());
+        if (lo != data.end())
+          kernel.range(std::min(*lo, static_cast<D>(0)),
+                       std::max(*hi, static_cast<D>(0)));
+
+        rolling_row(A_cols.slice(a, b), data, A_n_cols, window, kernel,
+                    [&](J const col, auto &krn) {
+                      assert(out_col < B_cols.end());
+                      assert(out_val < B_data.end());
+
+                      *out_col++ = col;
+                      *out_val++ = krn.result();
+                    });
+      }
     }
-
-  private:
-    std::vector<T> _buffer;
-  };
+  } // namespace SPECTRE_ISA
 } // namespace spectre
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <iterator>
 #include <type_traits>
 
 namespace spectre {
@@ -78,4 +80,122 @@ namespace spectre {
   };
 
   template <typename T> using cspan = span<T const>;
+
+  // Every `stride`-th element from `p`, e.g. a slice of a numpy array. A
+  // kernel that only iterates over its input reads such a view in place.
+  template <typename T> struct strided_span {
+    using pointer = T *;
+    using reference = T &;
+    using value_type = std::remove_cv_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using size_type = std::size_t;
+
+    struct iterator {
+      using pointer = strided_span::pointer;
+      using reference = strided_span::reference;
+      using value_type = strided_span::value_type;
+      using difference_type = strided_span::difference_type;
+      using iterator_category = std::forward_iterator_tag;
+
+      constexpr reference operator*() const noexcept
+      {
+        return _beg[_n * _stride];
+      }
+
+      constexpr iterator &operator++() noexcept
+      {
+        ++_n;
+        return *this;
+      }
+
+      constexpr iterator operator++(int) noexcept
+      {
+        auto const it = *this;
+        ++_n;
+        return it;
+      }
+
+      // counted rather than compared by address, a stride may be zero
+      constexpr bool operator==(iterator const &other) const noexcept
+      {
+        return _n == other._n;
+      }
+
+      constexpr bool operator!=(iterator const &other) const noexcept
+      {
+        return _n != other._n;
+      }
+
+      pointer _beg;
+      difference_type _stride;
+      difference_type _n;
+    };
+
+    constexpr strided_span() noexcept = default;
+
+    constexpr explicit strided_span(pointer p, size_type n,
+                                    difference_type stride) noexcept
+        : _beg{p}, _size{n}, _stride{stride}
+    {}
+
+    constexpr strided_span(span<T> const s) noexcept
+        : _beg{s.begin()}, _size{s.size()}
+    {}
+
+    constexpr bool empty() const noexcept
+    {
+      return _size == 0;
+    }
+
+    constexpr size_type size() const noexcept
+    {
+      return _size;
+    }
+
+    constexpr difference_type stride() const noexcept
+    {
+      return _stride;
+    }
+
+    // Whether the elements are adjacent, then `contiguous()` views them
+    constexpr bool is_contiguous() const noexcept
+    {
+      return _stride == 1 || _size <= 1;
+    }
+
+    constexpr span<T> contiguous() const noexcept
+    {
+      assert(is_contiguous());
+      return span<T>{_beg, _size};
+    }
+
+    constexpr iterator begin() const noexcept
+    {
+      return {_beg, _stride, 0};
+    }
+
+    constexpr iterator end() const noexcept
+    {
+      return {_beg, _stride, static_cast<difference_type>(_size)};
+    }
+
+    constexpr strided_span slice(size_type const a,
+                                 size_type const b) const noexcept
+    {
+      assert(a <= b && b <= _size);
+      return strided_span{_beg + static_cast<difference_type>(a) * _stride,
+                          b - a, _stride};
+    }
+
+    constexpr reference operator[](size_type const n) const noexcept
+    {
+      assert(n < _size);
+      return _beg[static_cast<difference_type>(n) * _stride];
+    }
+
+  private:
+    pointer _beg = nullptr;
+    size_type _size = 0;
+    difference_type _stride = 1;
+  };
 } // namespace spectre
@@ -0,0 +1,199 @@
+// spectre-preprocess: the sparse preprocessing of a project without Python.
+//
+// The input and output are directories of `.npy` arrays written and read by
+// `spectre.load.to_arrays` and `spectre.load.from_arrays`, the layout of the
+// `spectre.XicCache` entries.
+
+#include "canonical.h"
+#include "core.h"
+#include "npy.h"
+#include "pipeline.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+
+namespace {
+  using index_t = std::int64_t;
+
+  char const usage[] =
+      "usage: spectre-preprocess -w PEAK_WIDTH [-j THREADS] [-v] INPUT OUTPUT\n"
+      "\n"
+      "Removes the noise and the baseline of the project in the directory\n"
+      "INPUT like spectre.cpp.preprocess and writes it to OUTPUT.\n"
+      "\n"
+      "  -w PEAK_WIDTH  the peak width in scans\n"
+      "  -j THREADS     the number of threads, all hardware threads if 0\n"
+      "  -v             report the timing of the steps to stderr\n";
+
+  struct usage_error : std::invalid_argument {
+    using std::invalid_argument::invalid_argument;
+  };
+
+  struct options {
+    double peak_width = 0;
+    unsigned n_threads = 0;
+    bool verbose = false;
+    std::string input;
+    std::string output;
+  };
+
+  double number(std::string const &name, char const *text)
+  {
+    char *end;
+    auto const value = std::strtod(text, &end);
+    if (end == text || *end || !(value >= 0))
+      throw usage_error{"invalid value of " + name + ": " + text};
+    return value;
+  }
+
+  options parse(int const argc, char **argv)
+  {
+    options opts;
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+      std::string const arg = argv[i];
+      if (arg == "-h" || arg == "--help") {
+        std::fputs(usage, stdout);
+        std::exit(0);
+      } else if (arg == "-w" && i + 1 < argc) {
+        opts.peak_width = number(arg, argv[++i]);
+      } else if (arg == "-j" && i + 1 < argc) {
+        opts.n_threads = static_cast<unsigned>(number(arg, argv[++i]));
+      } else if (arg == "-v") {
+        opts.verbose = true;
+      } else if (positional < 2 && arg[0] != '-') {
+        (positional++ ? opts.output : opts.input) = arg;
+      } else {
+        throw usage_error{"unexpected argument " + arg};
+      }
+    }
+    if (positional != 2 || !(opts.peak_width > 0))
+      throw usage_error{"expected -w PEAK_WIDTH, INPUT and OUTPUT"};
+    return opts;
+  }
+
+  class stopwatch {
+  public:
+    explicit stopwatch(bool const verbose) : verbose{verbose} {}
+
+    void lap(char const *step)
+    {
+      auto const now = std::chrono::steady_clock::now();
+      if (verbose)
+        std::fprintf(stderr, "%-12s %9.3f ms\n", step,
+                     std::chrono::duration<double, std::milli>(now - last)
+                         .count());
+      last = now;
+    }
+
+  private:
+    bool verbose;
+    std::chrono::steady_clock::time_point last =
+        std::chrono::steady_clock::now();
+  };
+
+  template <typename D>
+  void run(options const &opts, spectre::npy::meta const &meta,
+           spectre::npy::array const &data, stopwatch &watch)
+  {
+    namespace npy = spectre::npy;
+    auto const &in = opts.input;
+    auto const &out = opts.output;
+
+    if (meta.shape[0] < 0 || meta.shape[1] < 0)
+      throw std::runtime_error{in + ": a negative shape"};
+
+    // the columns of a CSC matrix are the m/z bins, i.e. each major is a
+    // chromatogram along the scans
+    spectre::compressed_matrix<index_t, D> A;
+    A.pointers = npy::cast<index_t>(npy::load(in + "/indptr.npy"));
+    A.indices = npy::cast<index_t>(npy::load(in + "/indices.npy"));
+    A.data = npy::cast<D>(data);
+    A.n_minor = meta.format == "csc" ? meta.shape[0] : meta.shape[1];
+
+    if (A.indices.size() != A.data.size() ||
+        A.pointers.size() !=
+            static_cast<std::size_t>(meta.shape[meta.format == "csc"]) + 1 ||
+        A.pointers.front() != 0 ||
+        A.pointers.back() != static_cast<index_t>(A.data.size()) ||
+        !std::is_sorted(A.pointers.begin(), A.pointers.end()))
+      throw std::runtime_error{in + ": inconsistent sparse arrays"};
+    for (auto const index : A.indices)
+      if (index < 0 || index >= A.n_minor)
+        throw std::runtime_error{in + ": an index out of bounds"};
+
+    auto const mz_scales = npy::cast<double>(npy::load(in + "/mz_scales.npy"));
+    auto const rt_scales = npy::cast<double>(npy::load(in + "/rt_scales.npy"));
+    watch.lap("read");
+
+    if (meta.format == "csr") {
+      A = spectre::transpose(A);
+      watch.lap("transpose");
+    }
+
+    // the kernels expect sorted and unique indices, like `sum_duplicates`
+    if (!spectre::is_canonical_csr(spectre::as_cspan(A.pointers),
+                                   spectre::as_cspan(A.indices),
+                                   opts.n_threads)) {
+      auto const size = spectre::canonicalize_csr(
+          spectre::as_span(A.pointers), spectre::as_span(A.indices),
+          spectre::as_span(A.data), spectre::duplicate_sum, opts.n_threads);
+      A.indices.resize(static_cast<std::size_t>(size));
+      A.data.resize(static_cast<std::size_t>(size));
+      watch.lap("canonicalize");
+    }
+
+    auto const &isa = spectre::select_isa();
+    auto const &kernels =
+        spectre::get_kernels<index_t, index_t, D>(isa.kernels());
+    if (opts.verbose)
+      std::fprintf(stderr, "isa          %s\n", isa.name);
+
+    A = spectre::remove_noise(kernels, std::move(A), opts.peak_width,
+                              opts.n_threads);
+    watch.lap("noise");
+    A = spectre::remove_baseline(kernels, std::move(A),
+                                 static_cast<index_t>(10 * opts.peak_width),
+                                 opts.n_threads);
+    watch.lap("baseline");
+
+    if (mkdir(out.c_str(), 0777) != 0 && errno != EEXIST)
+      throw std::runtime_error{out + ": cannot be created"};
+    npy::save(out + "/data.npy", spectre::as_cspan(A.data));
+    npy::save(out + "/indices.npy", spectre::as_cspan(A.indices));
+    npy::save(out + "/indptr.npy", spectre::as_cspan(A.pointers));
+    npy::save(out + "/mz_scales.npy", spectre::as_span(mz_scales));
+    npy::save(out + "/rt_scales.npy", spectre::as_span(rt_scales));
+    npy::save_meta(out + "/meta.json",
+                   {"csc", {meta.shape[0], meta.shape[1]}});
+    watch.lap("write");
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  try {
+    auto const opts = parse(argc, argv);
+    stopwatch watch{opts.verbose};
+
+    auto const meta = spectre::npy::load_meta(opts.input + "/meta.json");
+    auto const data = spectre::npy::load(opts.input + "/data.npy");
+    if (data.type.kind == 'f' && data.type.size == 4)
+      run<float>(opts, meta, data, watch);
+    else
+      run<double>(opts, meta, data, watch);
+  } catch (usage_error const &e) {
+    std::fprintf(stderr, "spectre-preprocess: %s\n\n%s", e.what(), usage);
+    return 2;
+  } catch (std::exception const &e) {
+    std::fprintf(stderr, "spectre-preprocess: %s\n", e.what());
+    return 1;
+  }
+}
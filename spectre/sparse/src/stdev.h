@@ -1,29 +1,35 @@
 #pragma once
 
+#include "isa.h"
 #include "ranges.h"
 #include "span.h"
+#include <algorithm>
 #include <cmath>
 #include <numeric>
 
 namespace spectre {
-  template <typename I, typename D>
-  void stdev_csr(cspan<I> const rows, cspan<D> const data, I const n_cols,
-                 span<D> const result) noexcept
-  {
-    auto out = result.begin();
+  inline namespace SPECTRE_ISA {
+    // `data` is a `cspan<D>` or a `strided_span<D const>`
+    template <typename I, typename D, typename Data = cspan<D>>
+    void stdev_csr(cspan<I> const rows, Data const data, I const n_cols,
+                   span<D> const result) noexcept
+    {
+      auto out = result.begin();
 
-    for (auto const [a, b] : adjacent(rows)) {
-      auto sum = static_cast<D>(0);
-      auto sum2 = static_cast<D>(0);
+      for (auto const [a, b] : adjacent(rows)) {
+        auto sum = static_cast<D>(0);
+        auto sum2 = static_cast<D>(0);
 
-      for (auto const value : data.slice(a, b)) {
-        sum += value;
-        sum2 += value * value;
-      }
+        for (auto const value : data.slice(a, b)) {
+          sum += value;
+          sum2 += value * value;
+        }
 
-      auto const mean = sum / n_cols;
-      auto const var = sum2 / n_cols - (mean * mean);
-      *out++ = std::sqrt(var);
+        auto const mean = sum / n_cols;
+        // the rounding may leave a nearly constant row a negative variance
+        auto const var = sum2 / n_cols - (mean * mean);
+        *out++ = std::sqrt(std::max(var, static_cast<D>(0)));
+      }
     }
-  }
+  } // namespace SPECTRE_ISA
 } // namespace spectre
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "pipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+namespace spectre {
+  // Parameters of a synthetic LC-MS project, the defaults and the meaning
+  // match `spectre.synthetic.synthetic_xic`
+  struct synthetic_params {
+    std::int64_t n_scans = 1000;
+    double mz_min = 50;
+    double mz_max = 500;
+    double sampling = 0.1;
+    std::int64_t n_peaks = 100;
+    double peak_width = 5;     // the median FWHM of the peaks in scans
+    double width_spread = 0.2; // the standard deviation of the log widths
+    double height = 1000;      // the median height of the peaks
+    double noise = 10;         // the mean intensity of the noise
+    double density = 0.01;     // the fraction of the noisy cells
+    std::uint64_t seed = 0;
+  };
+
+  // A counter-based stream of uniform numbers in [0, 1) derived from
+  // SplitMix64, so that `spectre.synthetic` draws the very same numbers with
+  // vectorized NumPy operations
+  class random_stream {
+  public:
+    random_stream(std::uint64_t const seed, std::uint64_t const stream) noexcept
+        : key{mix(seed + stream)}
+    {
+    }
+
+    double operator()() noexcept
+    {
+      return static_cast<double>(mix(key + ++counter * golden) >> 11) *
+             0x1p-53;
+    }
+
+  private:
+    static constexpr std::uint64_t golden = 0x9E3779B97F4A7C15;
+
+    static std::uint64_t mix(std::uint64_t z) noexcept
+    {
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+      return z ^ (z >> 31);
+    }
+
+    std::uint64_t key;
+    std::uint64_t counter = 0;
+  };
+
+  // The standard normal numbers of two uniform streams (Box-Muller)
+  inline double normal(random_stream &u1, random_stream &u2) noexcept
+  {
+    constexpr auto two_pi = 6.283185307179586;
+    auto const r = std::sqrt(-2 * std::log(1 - u1()));
+    return r * std::cos(two_pi * u2());
+  }
+
+  inline std::int64_t synthetic_n_mz(synthetic_params const &p) noexcept
+  {
+    return static_cast<std::int64_t>(
+               std::floor((p.mz_max - p.mz_min) / p.sampling + 0.5)) +
+           1;
+  }
+
+  // A deterministic CSR matrix of the scans by the m/z bins: Gaussian
+  // elution profiles of `n_peaks` compounds at random retention times and m/z
+  // bins on top of exponentially distributed noise in a random `density`
+  // fraction of the cells. The same parameters give the same matrix, equal to
+  // the one of `spectre.synthetic` up to the rounding of `exp` and `log`.
+  template <typename I, typename D>
+  compressed_matrix<I, D> synthetic_xic(synthetic_params const &p)
+  {
+    auto const n_mz = synthetic_n_mz(p);
+    std::vector<std::tuple<I, I, double>> cells;
+
+    auto const n_noise = static_cast<std::int64_t>(
+        p.density * static_cast<double>(p.n_scans) * static_cast<double>(n_mz));
+    random_stream noise_row{p.seed, 0}, noise_col{p.seed, 1},
+        noise_value{p.seed, 2};
+    for (std::int64_t k = 0; k < n_noise; ++k) {
+      auto const row = static_cast<I>(noise_row() * p.n_scans);
+      auto const col = static_cast<I>(noise_col() * n_mz);
+      cells.emplace_back(row, col, -p.noise * std::log(1 - noise_value()));
+    }
+
+    random_stream peak_rt{p.seed, 3}, peak_col{p.seed, 4}, width_u1{p.seed, 5},
+        width_u2{p.seed, 6}, height_u1{p.seed, 7}, height_u2{p.seed, 8};
+    for (std::int64_t k = 0; k < p.n_peaks; ++k) {
+      auto const center = peak_rt() * p.n_scans;
+      auto const col = static_cast<I>(peak_col() * n_mz);
+      auto const width =
+          p.peak_width * std::exp(p.width_spread * normal(width_u1, width_u2));
+      auto const height = p.height * std::exp(0.5 * normal(height_u1, height_u2));
+
+      // the FWHM of a Gaussian is `2 sqrt(2 ln 2)` sigmas
+      auto const sigma = width / 2.3548200450309493;
+      auto const first = std::max(0.0, std::ceil(center - 4 * sigma));
+      auto const last =
+          std::min(p.n_scans - 1.0, std::floor(center + 4 * sigma));
+      for (auto row = first; row <= last; ++row) {
+        auto const z = (row - center) / sigma;
+        cells.emplace_back(static_cast<I>(row), col,
+                           height * std::exp(-0.5 * z * z));
+      }
+    }
+
+    std::sort(cells.begin(), cells.end());
+
+    compressed_matrix<I, D> A;
+    A.pointers.assign(static_cast<std::size_t>(p.n_scans) + 1, 0);
+    A.n_minor = static_cast<I>(n_mz);
+    for (std::size_t k = 0; k < cells.size();) {
+      auto const [row, col, value] = cells[k];
+      auto sum = value;
+      while (++k < cells.size() && std::get<0>(cells[k]) == row &&
+             std::get<1>(cells[k]) == col)
+        sum += std::get<2>(cells[k]);
+
+      A.indices.push_back(col);
+      A.data.push_back(static_cast<D>(sum));
+      ++A.pointers[static_cast<std::size_t>(row) + 1];
+    }
+    std::partial_sum(A.pointers.begin(), A.pointers.end(), A.pointers.begin());
+    return A;
+  }
+} // namespace spectre
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "span.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// An opt-in tracing of the kernel calls. Every traced call is a `scope`, which
+// records its wall time, the nonzeros it reads and writes, the bytes of its
+// outputs and the utilisation of the threads of its `parallel_for` into a
+// ring buffer of the calling thread. A disabled scope costs one relaxed load.
+namespace spectre::trace {
+  // A finished scope, the times are nanoseconds of the steady clock
+  struct event {
+    char const *name = nullptr;
+    std::int64_t begin = 0;
+    std::int64_t end = 0;
+    std::int64_t nnz_in = 0;
+    std::int64_t nnz_out = 0;
+    std::int64_t bytes = 0;
+    std::int64_t n_threads = 1;
+    std::int64_t busy = 0; // the time the threads worked, summed
+    std::uint64_t thread = 0;
+  };
+
+  inline std::atomic<bool> enabled_flag{false};
+
+  inline bool enabled() noexcept
+  {
+    return enabled_flag.load(std::memory_order_relaxed);
+  }
+
+  inline void enable(bool const on) noexcept
+  {
+    enabled_flag.store(on, std::memory_order_relaxed);
+  }
+
+  inline std::int64_t now() noexcept
+  {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // The identifier of the calling thread, equal to `threading.get_ident()` of
+  // Python on POSIX systems
+  inline std::uint64_t thread_id() noexcept
+  {
+#ifdef _WIN32
+    return std::hash<std::thread::id>{}(std::this_thread::get_id());
+#else
+    auto const self = pthread_self();
+    if constexpr (std::is_pointer_v<decltype(self)>)
+      return reinterpret_cast<std::uintptr_t>(self);
+    else
+      return static_cast<std::uint64_t>(self);
+#endif
+  }
+
+  // The events of one thread, the oldest are overwritten when it is full
+  class ring {
+  public:
+    static constexpr std::size_t capacity = 1 << 12;
+
+    explicit ring(std::uint64_t const thread) noexcept : thread{thread} {}
+
+    void push(event e) noexcept
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      e.thread = thread;
+      events[head++ % capacity] = e;
+    }
+
+    // Moves the events out, returns the number of the overwritten ones
+    std::uint64_t drain(std::vector<event> &out)
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      auto const size = std::min<std::uint64_t>(head, capacity);
+      for (auto i = head - size; i < head; ++i)
+        out.push_back(events[i % capacity]);
+      auto const dropped = head - size;
+      head = 0;
+      return dropped;
+    }
+
+  private:
+    std::mutex mutex;
+    std::array<event, capacity> events;
+    std::uint64_t head = 0;
+    std::uint64_t const thread;
+  };
+
+  struct registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ring>> rings;
+  };
+
+  inline registry &rings() noexcept
+  {
+    static registry instance;
+    return instance;
+  }
+
+  // The ring of the calling thread, created by its first event
+  inline ring &local()
+  {
+    thread_local std::shared_ptr<ring> const local = [] {
+      auto &reg = rings();
+      std::lock_guard<std::mutex> lock{reg.mutex};
+      reg.rings.push_back(std::make_shared<ring>(thread_id()));
+      return reg.rings.back();
+    }();
+    return *local;
+  }
+
+  // The events of all threads since the last call, in no particular order.
+  // The rings of the exited threads are released.
+  inline std::vector<event> drain(std::uint64_t *const dropped = nullptr)
+  {
+    auto &reg = rings();
+    std::lock_guard<std::mutex> lock{reg.mutex};
+
+    std::vector<event> events;
+    std::uint64_t n_dropped = 0;
+    for (auto const &r : reg.rings)
+      n_dropped += r->drain(events);
+    reg.rings.erase(std::remove_if(reg.rings.begin(), reg.rings.end(),
+                                   [](auto const &r) {
+                                     return r.use_count() == 1;
+                                   }),
+                    reg.rings.end());
+
+    if (dropped)
+      *dropped = n_dropped;
+    return events;
+  }
+
+  template <typename... Ts> std::int64_t bytes_of(span<Ts> const... s) noexcept
+  {
+    return static_cast<std::int64_t>(((s.size() * sizeof(Ts)) + ... + 0));
+  }
+
+  // A traced call from its construction to its destruction. The innermost
+  // scope of a thread collects the work of the `parallel_for`s it runs.
+  class scope {
+  public:
+    explicit scope(char const *const name, std::size_t const nnz_in = 0) noexcept
+    {
+      if (!enabled())
+        return;
+      e.name = name;
+      e.nnz_in = static_cast<std::int64_t>(nnz_in);
+      e.begin = now();
+      parent = innermost;
+      innermost = this;
+    }
+
+    scope(scope const &) = delete;
+    scope &operator=(scope const &) = delete;
+
+    ~scope()
+    {
+      if (!e.name)
+        return;
+      e.end = now();
+      innermost = parent;
+      try {
+        local().push(e);
+      } catch (...) {
+        // the event is lost rather than the call
+      }
+    }
+
+    void output(std::size_t const nnz_out, std::int64_t const bytes) noexcept
+    {
+      e.nnz_out = static_cast<std::int64_t>(nnz_out);
+      e.bytes = bytes;
+    }
+
+    void parallel(std::int64_t const n_threads,
+                  std::int64_t const busy) noexcept
+    {
+      e.n_threads = std::max(e.n_threads, n_threads);
+      e.busy += busy;
+    }
+
+    // The innermost active scope of the calling thread or null
+    static scope *active() noexcept
+    {
+      return innermost;
+    }
+
+  private:
+    event e;
+    scope *parent = nullptr;
+    static inline thread_local scope *innermost = nullptr;
+  };
+} // namespace spectre::trace
@@ -0,0 +1,96 @@
+import numpy as np
+from scipy.sparse import coo_matrix
+
+from spectre.xic import Xic
+
+_GOLDEN = np.uint64(0x9E3779B97F4A7C15)
+
+
+def _mix(z: np.ndarray) -> np.ndarray:
+    z = (z ^ (z >> np.uint64(30))) * np.uint64(0xBF58476D1CE4E5B9)
+    z = (z ^ (z >> np.uint64(27))) * np.uint64(0x94D049BB133111EB)
+    return z ^ (z >> np.uint64(31))
+
+
+def _uniform(seed: int, stream: int, n: int) -> np.ndarray:
+    """The first `n` numbers of a counter-based stream of uniform numbers in
+    [0, 1), the same as `random_stream` of `synthetic.h`."""
+    with np.errstate(over='ignore'):
+        key = _mix(np.array([seed + stream], dtype=np.uint64))
+        counter = np.arange(1, n + 1, dtype=np.uint64)
+        bits = _mix(key + counter * _GOLDEN) >> np.uint64(11)
+    return bits * 2.0 ** -53
+
+
+def _normal(seed: int, stream: int, n: int) -> np.ndarray:
+    u1, u2 = _uniform(seed, stream, n), _uniform(seed, stream + 1, n)
+    return np.sqrt(-2 * np.log(1 - u1)) * np.cos(2 * np.pi * u2)
+
+
+def synthetic_xic(n_scans: int = 1000, mz_range=(50., 500.),
+                  sampling: float = 0.1, n_peaks: int = 100,
+                  peak_width: float = 5., width_spread: float = 0.2,
+                  height: float = 1000., noise: float = 10.,
+                  density: float = 0.01, seed: int = 0,
+                  dtype=np.float64) -> Xic:
+    """A deterministic synthetic LC-MS project for tests and benchmarks.
+
+    The data are Gaussian elution profiles of `n_peaks` compounds at random
+    retention times and m/z bins on top of exponentially distributed noise in
+    a random `density` fraction of the cells. The same arguments give the same
+    project, also in C++ (`spectre_core`'s `synthetic.h`) up to the rounding
+    of `exp` and `log`.
+
+    Args:
+        n_scans (int): A number of the scans.
+        mz_range (Tuple[float, float]): A range of the m/z values.
+        sampling (float): A sampling resolution of the m/z values.
+        n_peaks (int): A number of the peaks.
+        peak_width (float): A median FWHM of the peaks in scans.
+        width_spread (float): A standard deviation of the log of the widths.
+        height (float): A median height of the peaks.
+        noise (float): A mean intensity of the noise.
+        density (float): A fraction of the cells with noise.
+        seed (int): A seed of the random numbers.
+        dtype (np.dtype): A type of the values.
+
+    Returns:
+        Xic: A Spectre project with the scans in rows and CSR data.
+    """
+    n_mz = int(np.floor((mz_range[1] - mz_range[0]) / sampling + 0.5)) + 1
+
+    n_noise = int(density * n_scans * n_mz)
+    noise_rows = (_uniform(seed, 0, n_noise) * n_scans).astype(np.int64)
+    noise_cols = (_uniform(seed, 1, n_noise) * n_mz).astype(np.int64)
+    noise_values = -noise * np.log(1 - _uniform(seed, 2, n_noise))
+
+    centers = _uniform(seed, 3, n_peaks) * n_scans
+    cols = (_uniform(seed, 4, n_peaks) * n_mz).astype(np.int64)
+    widths = peak_width * np.exp(width_spread * _normal(seed, 5, n_peaks))
+    heights = height * np.exp(0.5 * _normal(seed, 7, n_peaks))
+
+    # the FWHM of a Gaussian is `2 sqrt(2 ln 2)` sigmas
+    sigmas = widths / 2.3548200450309493
+    first = np.maximum(0., np.ceil(centers - 4 * sigmas))
+    last = np.minimum(n_scans - 1., np.floor(centers + 4 * sigmas))
+    lengths = np.maximum(last - first + 1, 0).astype(np.int64)
+
+    peak = np.repeat(np.arange(n_peaks), lengths)
+    offsets = np.arange(len(peak)) - np.repeat(np.cumsum(lengths) - lengths,
+                                               lengths)
+    peak_rows = first[peak] + offsets
+    z = (peak_rows - centers[peak]) / sigmas[peak]
+    peak_values = heights[peak] * np.exp(-0.5 * z * z)
+
+    rows = np.concatenate([noise_rows, peak_rows.astype(np.int64)])
+    cols = np.concatenate([noise_cols, cols[peak]])
+    values = np.concatenate([noise_values, peak_values])
+
+    # duplicates are summed in double precision
+    data = coo_matrix((values, (rows, cols)), shape=(n_scans, n_mz)).tocsr()
+    data.sum_duplicates()
+
+    mz_scales = mz_range[0] + np.arange(n_mz) * sampling
+    rt_scales = np.arange(n_scans, dtype=np.float64)
+    return Xic(data=data.astype(dtype), mz_scales=mz_scales,
+               rt_scales=rt_scales)
@@ -0,0 +1,203 @@
+"""An opt-in profiling of the pipelines.
+
+While :func:`profile` is active, the stages of the Python pipelines (the
+:func:`span` blocks) and every call of the `_sparse` kernels are recorded.
+The stages record their wall time and the growth of the peak RSS. The kernels
+record their wall time, the nonzeros they read and write, the bytes of their
+outputs and the utilisation of their threads. Outside of :func:`profile` a
+span is a check of a global and the kernels check a relaxed atomic flag.
+"""
+import json
+import os
+import threading
+import time
+from collections import OrderedDict
+from contextlib import contextmanager
+from typing import Dict, List, Optional, Text
+
+_active = None
+
+
+def _max_rss_kb() -> int:
+    try:
+        import resource
+    except ImportError:
+        return 0
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+
+class _NullSpan:
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        return False
+
+
+_NULL_SPAN = _NullSpan()
+
+
+class _Span:
+    __slots__ = ('profile', 'name', 'begin', 'rss')
+
+    def __init__(self, profile: 'Profile', name: Text):
+        self.profile = profile
+        self.name = name
+
+    def __enter__(self):
+        self.rss = _max_rss_kb()
+        self.begin = time.monotonic_ns()
+        return self
+
+    def __exit__(self, *exc):
+        end = time.monotonic_ns()
+        rss = _max_rss_kb()
+        self.profile.events.append({
+            'name': self.name, 'cat': 'stage', 'begin': self.begin,
+            'end': end, 'thread': threading.get_ident(),
+            'args': {'max_rss_kb': rss, 'rss_growth_kb': rss - self.rss}})
+        return False
+
+
+def span(name: Text):
+    """A stage of a pipeline, recorded by an active :func:`profile`.
+
+    Use as `with span('remove_noise'): ...`.
+    """
+    profile = _active
+    if profile is None:
+        return _NULL_SPAN
+    return _Span(profile, name)
+
+
+class Profile:
+    """The stages and the kernel calls recorded by :func:`profile`.
+
+    Attributes:
+        events (List[dict]): The recorded spans, each with a `name`, a `cat`
+            ('stage' or 'kernel'), `begin` and `end` in nanoseconds of
+            `time.monotonic_ns`, a `thread` and `args`.
+        dropped (int): The number of the kernel calls lost to the full ring
+            buffers.
+    """
+
+    def __init__(self):
+        self.events = []  # type: List[dict]
+        self.dropped = 0
+
+    def _add_kernels(self, events, offset: int, dropped: int) -> None:
+        for (name, begin, end, thread, nnz_in, nnz_out, size, n_threads,
+             busy) in events:
+            args = {'nnz_in': nnz_in, 'nnz_out': nnz_out, 'bytes': size,
+                    'n_threads': n_threads}
+            if busy > 0 and end > begin:
+                args['utilisation'] = busy / (n_threads * (end - begin))
+            self.events.append({'name': name, 'cat': 'kernel',
+                                'begin': begin - offset, 'end': end - offset,
+                                'thread': thread, 'args': args})
+        self.events.sort(key=lambda e: (e['begin'], -e['end']))
+        self.dropped += dropped
+
+    def summary(self) -> Dict[Text, dict]:
+        """The totals of the spans by name, the slowest first.
+
+        Returns:
+            Dict[Text, dict]: For each name its `cat`, `count`, `seconds`
+            and the sums of the numeric arguments, except for the
+            `utilisation`, which is averaged over the time, and the
+            `max_rss_kb`, which is the maximum.
+        """
+        totals = {}
+        for e in self.events:
+            total = totals.setdefault(e['name'], {
+                'cat': e['cat'], 'count': 0, 'seconds': 0.})
+            seconds = (e['end'] - e['begin']) * 1e-9
+            total['count'] += 1
+            total['seconds'] += seconds
+            for key, value in e['args'].items():
+                if key == 'max_rss_kb':
+                    total[key] = max(total.get(key, 0), value)
+                elif key == 'utilisation':
+                    total[key] = total.get(key, 0.) + value * seconds
+                    total['_parallel'] = total.get('_parallel', 0.) + seconds
+                elif key != 'n_threads':
+                    total[key] = total.get(key, 0) + value
+
+        for total in totals.values():
+            parallel = total.pop('_parallel', 0.)
+            if parallel > 0:
+                total['utilisation'] /= parallel
+        return OrderedDict(sorted(totals.items(),
+                                  key=lambda item: -item[1]['seconds']))
+
+    def __str__(self) -> str:
+        lines = ['{:<40} {:>6} {:>10} {:>12} {:>12} {:>7} {:>10}'.format(
+            'name', 'count', 'ms', 'nnz in', 'nnz out', 'util', 'rss+ kB')]
+        for name, t in self.summary().items():
+            util = t.get('utilisation')
+            lines.append('{:<40} {:>6} {:>10.3f} {:>12} {:>12} {:>7} {:>10}'
+                         .format(name, t['count'], t['seconds'] * 1e3,
+                                 t.get('nnz_in', ''), t.get('nnz_out', ''),
+                                 '' if util is None else '{:.0%}'.format(util),
+                                 t.get('rss_growth_kb', '')))
+        return '\n'.join(lines)
+
+    def chrome_trace(self) -> dict:
+        """The spans in the Chrome trace event format.
+
+        The result can be saved by :meth:`save` and opened in
+        `chrome://tracing` or https://ui.perfetto.dev.
+        """
+        pid = os.getpid()
+        origin = min((e['begin'] for e in self.events), default=0)
+        events = [{'name': e['name'], 'cat': e['cat'], 'ph': 'X',
+                   'ts': (e['begin'] - origin) * 1e-3,
+                   'dur': (e['end'] - e['begin']) * 1e-3,
+                   'pid': pid, 'tid': e['thread'], 'args': e['args']}
+                  for e in self.events]
+        return {'traceEvents': events, 'displayTimeUnit': 'ms',
+                'otherData': {'dropped': self.dropped}}
+
+    def save(self, file: Text) -> None:
+        """Write :meth:`chrome_trace` as a JSON file."""
+        with open(file, 'w') as f:
+            json.dump(self.chrome_trace(), f)
+
+
+@contextmanager
+def profile(file: Optional[Text] = None):
+    """Record the stages and the kernel calls of the enclosed block.
+
+    Args:
+        file (Optional[Text]): A path to save the Chrome trace of the block
+            to, see :meth:`Profile.save`.
+
+    Yields:
+        Profile: The profile, complete when the block exits.
+
+    Example:
+        >>> with spectre.profile() as prof:
+        ...     spectre.cpp.preprocess(xic, peak_width=5)
+        >>> print(prof)
+    """
+    from spectre.sparse import _sparse
+
+    global _active
+    if _active is not None:
+        raise RuntimeError('a profile is already active')
+
+    prof = Profile()
+    _sparse.trace_drain()
+    offset = _sparse.trace_clock() - time.monotonic_ns()
+
+    _active = prof
+    _sparse.trace_enable(True)
+    try:
+        yield prof
+    finally:
+        _sparse.trace_enable(False)
+        _active = None
+        events, dropped = _sparse.trace_drain()
+        prof._add_kernels(events, offset, dropped)
+        if file is not None:
+            prof.save(file)
@@ -1,16 +1,121 @@
+import numpy as np
+from scipy.sparse import isspmatrix_csc
+
+
 class Xic:
     def __init__(self, data, mz_scales, rt_scales):
         self.data = data
         self.mz_scales = mz_scales
         self.rt_scales = rt_scales
 
+    @property
+    def data(self):
+        return self._data
+
+    @data.setter
+    def data(self, value):
+        self._data = value
+        self._index = None
+
+    def index(self):
+        """The data in canonical CSC format, used to answer chromatogram
+        queries.
+
+        Data that is already canonical CSC of a floating point type is used
+        as is, anything else is converted into a copy. The index is built on
+        first use and kept until `data` is reassigned, so repeated queries
+        neither convert formats nor copy the matrix. Only the reassignment
+        invalidates it, after editing the matrix in place (e.g.
+        `xic.data.data *= 2`) reassign it with `xic.data = xic.data`.
+        """
+        if self._index is None:
+            from spectre.sparse import _sparse
+
+            index = self._data
+            if not (isspmatrix_csc(index) and
+                    index.dtype in (np.float32, np.float64) and
+                    _sparse.is_canonical_csr(index.indptr, index.indices)):
+                index = index.tocsc(copy=True)
+                index.sum_duplicates()
+                if index.dtype not in (np.float32, np.float64):
+                    index = index.astype(np.float64)
+            self._index = index
+        return self._index
+
+    def chromatograms(self, mz, ppm: float, rt_range=None,
+                      pooling: str = 'sum', n_threads: int = 0):
+        """Extract chromatograms of many target m/z values at once.
+
+        Args:
+            mz (array_like): Target m/z values.
+            ppm (float): A relative m/z tolerance in parts per million.
+            rt_range (Optional[Tuple[float, float]]): An inclusive retention
+                time range, the whole run by default.
+            pooling (str): How to merge the m/z columns within the tolerance,
+                either 'sum' or 'max'.
+            n_threads (int): A number of threads, 0 means all hardware
+                threads.
+
+        Returns:
+            (numpy.ndarray, numpy.ndarray): The retention times of the scans
+            within the range and a (targets x scans) array of intensities.
+        """
+        from spectre.sparse import _sparse
+
+        if pooling not in ('sum', 'max'):
+            raise ValueError('Unsupported pooling "{}"'.format(pooling))
+
+        index = self.index()
+        mz = np.ascontiguousarray(np.atleast_1d(mz), dtype=np.float64)
+        mz_scales = np.ascontiguousarray(self.mz_scales, dtype=np.float64)
+
+        if rt_range is None:
+            row_lo, row_hi = 0, index.shape[0]
+        else:
+            row_lo = np.searchsorted(self.rt_scales, rt_range[0], 'left')
+            row_hi = np.searchsorted(self.rt_scales, rt_range[1], 'right')
+
+        traces = np.empty((mz.size, row_hi - row_lo), dtype=index.dtype)
+        _sparse.xic_query_csc(index.indptr, index.indices, index.data,
+                              mz_scales, mz, ppm, int(row_lo), int(row_hi),
+                              traces.ravel(), pooling == 'max', n_threads)
+        return self.rt_scales[row_lo:row_hi], traces
+
+    def chromatogram(self, mz: float, ppm: float, rt_range=None,
+                     pooling: str = 'sum', n_threads: int = 0):
+        """Extract a chromatogram of a single target m/z value.
+
+        See :func:`Xic.chromatograms` for the description of the arguments.
+        """
+        rt, traces = self.chromatograms(mz, ppm, rt_range, pooling,
+                                        n_threads)
+        return rt, traces[0]
+
+    def lazy(self):
+        """A lazy pipeline over this project (see :class:`spectre.lazy.LazyXic`).
+        """
+        from .lazy import LazyXic
+        return LazyXic.from_xic(self)
+
     def to_pickle(self, file: str):
         from .load import to_pickle
         to_pickle(self, file)
 
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        state['_index'] = None
+        return state
+
+    def __setstate__(self, state):
+        # projects pickled before the index was introduced store plain `data`
+        if 'data' in state:
+            state['_data'] = state.pop('data')
+        state.setdefault('_index', None)
+        self.__dict__.update(state)
+
     def __eq__(self, other):
         if isinstance(other, self.__class__):
-            return self.__dict__ == other.__dict__
+            return self.__getstate__() == other.__getstate__()
         return False
 
     def __repr__(self):
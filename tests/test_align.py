@@ -0,0 +1,60 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import csr_matrix, vstack
+
+import spectre
+from spectre.align import align_runs, resample
+from spectre.synthetic import synthetic_xic
+from spectre.xic import Xic
+
+
+def delayed(xic: Xic, shift: int) -> Xic:
+    """The run eluting every compound `shift` scans later."""
+    empty = csr_matrix((shift, xic.data.shape[1]), dtype=xic.data.dtype)
+    data = vstack([empty, xic.data[:-shift]]).tocsr()
+    return Xic(data, xic.mz_scales, xic.rt_scales)
+
+
+class TestAlign(TestCase):
+    def setUp(self):
+        self.reference = synthetic_xic(n_scans=400, n_peaks=80, noise=0.,
+                                       density=0., seed=3)
+
+    def test_identity(self):
+        alignment, = align_runs(self.reference, [self.reference], band=20)
+
+        self.assertTrue(np.allclose(alignment.rt_scales,
+                                    self.reference.rt_scales))
+        self.assertTrue(np.allclose(alignment.xic.data.toarray(),
+                                    self.reference.data.toarray()))
+        self.assertAlmostEqual(alignment.cost, 0)
+
+    def test_shift(self):
+        shift = 7
+        runs = [delayed(self.reference, shift), self.reference]
+        shifted, same = align_runs(self.reference, runs, band=20, n_threads=2)
+
+        # the scans before the first peak and after the last one have nothing
+        # to match, compare the warped times at the apexes
+        rt = self.reference.rt_scales
+        apexes = np.unique(np.asarray(self.reference.data.argmax(axis=0)))
+        apexes = apexes[(apexes > 0) & (apexes < len(rt) - shift)]
+        self.assertTrue(np.allclose(shifted.rt_scales[apexes + shift],
+                                    rt[apexes], atol=2 * (rt[1] - rt[0])))
+        self.assertLess(same.cost, shifted.cost)
+        self.assertTrue(np.all(np.diff(shifted.rt_scales) >= 0))
+
+        self.assertEqual(shifted.xic.data.shape, self.reference.data.shape)
+        self.assertIs(shifted.xic.rt_scales, rt)
+
+    def test_resample(self):
+        x = csr_matrix(np.array([[1., 0., 2.], [0., 4., 0.], [6., 0., 0.]]))
+        xic = Xic(x, np.arange(3.), np.arange(3.))
+        result = resample(xic, [0., 0.5, 1.75, 2., 5.], np.arange(5.))
+
+        expected = [[1., 0., 2.], [0.5, 2., 1.], [4.5, 1., 0.], [6., 0., 0.],
+                    [6., 0., 0.]]
+        self.assertTrue(np.allclose(result.data.toarray(), expected))
+        self.assertTrue(result.data.has_sorted_indices)
+        self.assertIs(spectre.align_runs, align_runs)
@@ -0,0 +1,239 @@
+"""Differential tests of the preprocessing backends.
+
+Every backend implements some of the operations below, each wrapped as an
+adapter returning a dense array. The naive backend is the reference, every
+other backend must agree with it on random sparse matrices with empty rows
+and columns, windows longer than the matrix, 32 and 64-bit indices and both
+float types. A new backend only adds its entry to `BACKENDS`.
+
+The adapters are timed too. With `SPECTRE_PARITY_REPORT` set to a path, the
+speed of every backend relative to the naive one on the same cases is written
+there as JSON.
+"""
+import json
+import os
+import time
+from collections import defaultdict, namedtuple
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import random as sparse_random
+
+import spectre.sparse.hybrid as hybrid
+import spectre.sparse.preprocess_cpp as cpp
+import spectre.sparse.preprocess_naive as naive
+import spectre.sparse.preprocess_numpy as numpy_backend
+from spectre.sparse.hybrid import HybridMatrix
+
+Backend = namedtuple('Backend', ['ops', 'axes'])
+Backend.__doc__ = """The adapters of a backend, keyed by the operation.
+
+    The rolling operations and `savgol` take `(x, window, axis)`, `std` takes
+    `(x, axis)` and `maxclip` takes `(a, b, c, axis)` and returns
+    `min(a, b + c)` with one `c` per column (axis 0) or row (axis 1).
+    `axes` are the axes the backend runs along.
+"""
+
+
+def _degree(window):
+    return min(2, window - 1)
+
+
+def _dense_maxclip(a, b, c, axis):
+    bound = b.toarray() + (c[np.newaxis, :] if axis == 0 else c[:, np.newaxis])
+    return np.minimum(a.toarray(), bound)
+
+
+def _naive_ops():
+    def rolling(name):
+        return lambda x, window, axis: getattr(naive, name)(
+            x, window, axis=axis, mode='constant').toarray()
+
+    return {
+        'rolling_min': rolling('rolling_min'),
+        'rolling_max': rolling('rolling_max'),
+        'rolling_mean': rolling('rolling_mean'),
+        'rolling_median': rolling('rolling_median'),
+        'savgol': lambda x, window, axis: naive.savgol_filter(
+            x, window, _degree(window), axis, mode='constant').toarray(),
+        'std': naive.std,
+        'maxclip': _dense_maxclip,
+    }
+
+
+def _numpy_ops():
+    def rolling(name):
+        def apply(x, window, axis):
+            k = (window, 1) if axis == 0 else (1, window)
+            full = getattr(numpy_backend, name)(x.tocoo(), k, mode='full')
+            lo = window // 2
+            return np.moveaxis(np.moveaxis(full.toarray(), axis, 0)[
+                lo:lo + x.shape[axis]], 0, axis)
+        return apply
+
+    return {
+        'rolling_min': rolling('rolling_min'),
+        'rolling_mean': rolling('rolling_mean'),
+        'rolling_median': rolling('rolling_median'),
+        'std': lambda x, axis: np.asarray(
+            numpy_backend.std(x.tocoo(), axis).toarray()).ravel(),
+    }
+
+
+def _cpp_ops():
+    def rolling(name):
+        return lambda x, window, axis: getattr(cpp, name)(
+            x, window, axis).toarray()
+
+    def maxclip(a, b, c, axis):
+        a = a.copy()
+        cpp.max_clip_spmat_plus_dvec(a, b, c)
+        return a.toarray()
+
+    return {
+        'rolling_min': rolling('rolling_min'),
+        'rolling_max': rolling('rolling_max'),
+        'rolling_mean': rolling('rolling_mean'),
+        'rolling_median': rolling('rolling_median'),
+        'savgol': lambda x, window, axis: cpp.savgol_filter(
+            x, window, _degree(window), axis).toarray(),
+        'std': cpp.std,
+        'maxclip': maxclip,
+    }
+
+
+def _hybrid_ops():
+    def rolling(name):
+        return lambda x, window, axis: getattr(hybrid, name)(
+            HybridMatrix.from_sparse(x), window).toarray()
+
+    def maxclip(a, b, c, axis):
+        # from_sparse picks the dense columns by the pattern, shared here
+        a, b = HybridMatrix.from_sparse(a), HybridMatrix.from_sparse(b)
+        hybrid.max_clip_spmat_plus_dvec(a, b, c)
+        return a.toarray()
+
+    return {
+        'rolling_min': rolling('rolling_min'),
+        'rolling_max': rolling('rolling_max'),
+        'rolling_mean': rolling('rolling_mean'),
+        'rolling_median': rolling('rolling_median'),
+        'savgol': lambda x, window, axis: hybrid.savgol_filter(
+            HybridMatrix.from_sparse(x), window, _degree(window)).toarray(),
+        'std': lambda x, axis: hybrid.std(HybridMatrix.from_sparse(x)),
+        'maxclip': maxclip,
+    }
+
+
+REFERENCE = 'naive'
+BACKENDS = {
+    'naive': Backend(_naive_ops(), (0, 1)),
+    'numpy': Backend(_numpy_ops(), (0, 1)),
+    'cpp': Backend(_cpp_ops(), (0, 1)),
+    'hybrid': Backend(_hybrid_ops(), (0,)),
+}
+
+SHAPES = [(30, 20), (1, 25), (25, 1), (15, 3), (12, 9)]
+WINDOWS = [1, 3, 7, 51]
+DTYPES = [np.float32, np.float64]
+INDEX_TYPES = [np.int32, np.int64]
+
+
+def random_matrix(shape, axis, dtype, index_type, seed):
+    """A random matrix compressed along `axis` with a few empty rows and
+    columns, the last of the shapes is empty altogether."""
+    rng = np.random.RandomState(seed)
+    density = 0. if shape == SHAPES[-1] else 0.3
+    x = sparse_random(*shape, density=density, format='lil', dtype=dtype,
+                      random_state=rng)
+    x[rng.rand(shape[0]) < 0.2, :] = 0
+    x[:, rng.rand(shape[1]) < 0.2] = 0
+    x = (x * 10).astype(dtype)
+    x = x.tocsc() if axis == 0 else x.tocsr()
+    x.eliminate_zeros()
+
+    # scipy picks the smallest index type on construction, override it
+    x.indptr = x.indptr.astype(index_type)
+    x.indices = x.indices.astype(index_type)
+    return x
+
+
+def cases(axis):
+    seed = 0
+    for shape in SHAPES:
+        for dtype in DTYPES:
+            for index_type in INDEX_TYPES:
+                seed += 1
+                yield (random_matrix(shape, axis, dtype, index_type, seed),
+                       dict(shape=shape, dtype=dtype.__name__,
+                            index_type=index_type.__name__))
+
+
+class TestBackends(TestCase):
+    # the seconds of a backend and of the reference on the same cases
+    timings = defaultdict(lambda: [0., 0.])
+
+    @classmethod
+    def tearDownClass(cls):
+        path = os.environ.get('SPECTRE_PARITY_REPORT')
+        if not path:
+            return
+
+        report = defaultdict(dict)
+        for (op, name), (seconds, reference) in sorted(cls.timings.items()):
+            report[op][name] = dict(seconds=seconds,
+                                    reference_seconds=reference,
+                                    speedup=reference / max(seconds, 1e-9))
+        with open(path, 'w') as file:
+            json.dump(report, file, indent=2)
+
+    @staticmethod
+    def run_op(name, op, *args):
+        start = time.perf_counter()
+        result = BACKENDS[name].ops[op](*args)
+        return result, time.perf_counter() - start
+
+    def assertParity(self, op, args, axis, atol=None, **params):
+        expected, reference = self.run_op(REFERENCE, op, *args)
+        tolerance = 1e-4 if params['dtype'] == 'float32' else 1e-9
+        if atol is None:
+            atol = tolerance * max(1., np.abs(expected).max(initial=0))
+
+        for name, backend in BACKENDS.items():
+            if name == REFERENCE or op not in backend.ops \
+                    or axis not in backend.axes:
+                continue
+            with self.subTest(backend=name, op=op, axis=axis, **params):
+                result, seconds = self.run_op(name, op, *args)
+                self.timings[op, name][0] += seconds
+                self.timings[op, name][1] += reference
+                self.assertEqual(result.shape, expected.shape)
+                np.testing.assert_allclose(result, expected, rtol=tolerance,
+                                           atol=atol)
+
+    def test_rolling(self):
+        for axis in [0, 1]:
+            for x, params in cases(axis):
+                for op in ['rolling_min', 'rolling_max', 'rolling_mean',
+                           'rolling_median', 'savgol']:
+                    for window in WINDOWS:
+                        self.assertParity(op, (x, window, axis), axis,
+                                          window=window, **params)
+
+    def test_std(self):
+        for axis in [0, 1]:
+            for x, params in cases(axis):
+                # the native kernels sum the squares in one pass, so a nearly
+                # constant vector keeps a square root of the rounding error
+                scale = np.abs(x.data).max(initial=1)
+                atol = 4 * np.sqrt(np.finfo(x.dtype).eps) * scale
+                self.assertParity('std', (x, axis), axis, atol, **params)
+
+    def test_maxclip(self):
+        for axis in [0, 1]:
+            for a, params in cases(axis):
+                rng = np.random.RandomState(a.nnz)
+                b = a.copy()
+                b.data = (b.data * rng.uniform(0, 1, b.nnz)).astype(a.dtype)
+                c = rng.uniform(0, 2, a.shape[1 - axis]).astype(a.dtype)
+                self.assertParity('maxclip', (a, b, c, axis), axis, **params)
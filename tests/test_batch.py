@@ -0,0 +1,127 @@
+import os
+import tempfile
+import threading
+import time
+from unittest import TestCase
+from unittest.mock import patch
+
+import numpy as np
+
+import spectre.load
+from spectre.batch import process_many
+from spectre.load import from_pickle
+from spectre.synthetic import synthetic_xic
+from spectre.xic import Xic
+
+
+def fake_mzxml(file, sampling):
+    """A synthetic run seeded by the number stored in `file`."""
+    with open(file) as f:
+        seed = int(f.read())
+    return synthetic_xic(n_scans=20, mz_range=(100., 101.), n_peaks=2,
+                         seed=seed)
+
+
+def scaled(xic, peak_width):
+    """A preprocessing finishing in a random order."""
+    time.sleep(np.random.uniform(0, 0.01))
+    return Xic(xic.data * peak_width, xic.mz_scales, xic.rt_scales)
+
+
+class TestProcessMany(TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.files = []
+        for seed in range(8):
+            path = os.path.join(self.directory.name, '{}.mzXML'.format(seed))
+            with open(path, 'w') as f:
+                f.write(str(seed))
+            self.files.append(path)
+
+        self.patch = patch.object(spectre.load, 'from_mzxml', fake_mzxml)
+        self.patch.start()
+
+    def tearDown(self):
+        self.patch.stop()
+        self.directory.cleanup()
+
+    def test_order(self):
+        report = process_many(self.files, 0.01, 3, preprocess=scaled,
+                              n_workers=4)
+        self.assertEqual(report.outputs,
+                         [os.path.splitext(f)[0] + '.pickle'
+                          for f in self.files])
+        for stage in report.stages.values():
+            self.assertEqual(stage.runs, len(self.files))
+
+        for file, output in zip(self.files, report.outputs):
+            expected = scaled(fake_mzxml(file, 0.01), 3)
+            result = from_pickle(output)
+            self.assertTrue(np.array_equal(result.data.toarray(),
+                                           expected.data.toarray()))
+            self.assertTrue(np.array_equal(result.rt_scales,
+                                           expected.rt_scales))
+
+    def test_outputs(self):
+        outputs = [os.path.join(self.directory.name, 'out{}.pkl'.format(i))
+                   for i in range(len(self.files))]
+        report = process_many(self.files, 0.01, 1, outputs, scaled, 2)
+        self.assertEqual(report.outputs, outputs)
+        self.assertTrue(all(os.path.exists(output) for output in outputs))
+
+        with self.assertRaises(ValueError):
+            process_many(self.files, 0.01, 1, outputs[1:], scaled)
+
+    def test_errors(self):
+        def failing_decode(file, sampling):
+            if file == self.files[3]:
+                raise KeyError('decode')
+            return fake_mzxml(file, sampling)
+
+        def failing_preprocess(xic, peak_width):
+            if xic.data.nnz == fake_mzxml(self.files[5], 0).data.nnz:
+                raise ArithmeticError('preprocess')
+            return xic
+
+        with patch.object(spectre.load, 'from_mzxml', failing_decode):
+            with self.assertRaisesRegex(KeyError, 'decode'):
+                process_many(self.files, 0.01, 1, preprocess=scaled,
+                             n_workers=3)
+
+        with self.assertRaisesRegex(ArithmeticError, 'preprocess'):
+            process_many(self.files, 0.01, 1, preprocess=failing_preprocess,
+                         n_workers=3)
+
+        missing = os.path.join(self.directory.name, 'missing', 'out.pkl')
+        with self.assertRaises(OSError):
+            process_many(self.files, 0.01, 1, [missing] * len(self.files),
+                         scaled, 3)
+
+    def test_bounded_queues(self):
+        lock = threading.Lock()
+        counts = dict(decoded=0, written=0, ahead=0)
+
+        def counting_decode(file, sampling):
+            with lock:
+                counts['decoded'] += 1
+                counts['ahead'] = max(counts['ahead'],
+                                      counts['decoded'] - counts['written'])
+            return fake_mzxml(file, sampling)
+
+        def slow_write(xic, file):
+            time.sleep(0.02)
+            with lock:
+                counts['written'] += 1
+
+        queue_size, n_workers = 1, 2
+        files = self.files * 3
+        outputs = [str(i) for i in range(len(files))]
+        with patch.object(spectre.load, 'from_mzxml', counting_decode), \
+                patch.object(spectre.load, 'to_pickle', slow_write), \
+                patch('os.path.getsize', return_value=1):
+            process_many(files, 0.01, 1, outputs, scaled, n_workers,
+                         queue_size)
+
+        # a run in each queue and thread of a stage and one being decoded
+        self.assertEqual(counts['written'], len(files))
+        self.assertLessEqual(counts['ahead'], 2 * queue_size + n_workers + 2)
@@ -0,0 +1,187 @@
+import multiprocessing
+import os
+import shutil
+import tempfile
+from unittest import TestCase
+from unittest.mock import patch
+
+import numpy as np
+
+import spectre
+import spectre.load
+from spectre.cache import XicCache, file_digest
+from spectre.synthetic import synthetic_xic
+from spectre.xic import Xic
+
+
+def make_xic(seed):
+    return synthetic_xic(n_scans=40, mz_range=(100., 102.), n_peaks=3,
+                         seed=seed)
+
+
+def assert_same(test, result, expected):
+    test.assertTrue(np.array_equal(result.data.toarray(),
+                                   expected.data.toarray()))
+    test.assertTrue(np.array_equal(result.mz_scales, expected.mz_scales))
+    test.assertTrue(np.array_equal(result.rt_scales, expected.rt_scales))
+
+
+def doubled(xic, peak_width):
+    return Xic(xic.data * 2, xic.mz_scales, xic.rt_scales)
+
+
+def put_many(directory, seeds):
+    cache = XicCache(directory)
+    for seed in seeds:
+        cache.put(str(seed), make_xic(seed))
+
+
+def get_many(directory, seeds, repeat):
+    """The number of hits, every hit must be a complete entry."""
+    cache = XicCache(directory)
+    hits = 0
+    for _ in range(repeat):
+        for seed in seeds:
+            xic = cache.get(str(seed))
+            if xic is not None:
+                expected = make_xic(seed)
+                if not np.array_equal(xic.data.toarray(),
+                                      expected.data.toarray()):
+                    raise AssertionError('a partial entry of {}'.format(seed))
+                hits += 1
+    return hits
+
+
+class TestXicCache(TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.cache = XicCache(os.path.join(self.directory, 'cache'))
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def temporary(self):
+        return [name for name in os.listdir(self.cache.directory)
+                if name.startswith('.tmp-')]
+
+    def test_keys(self):
+        key = XicCache.key('abc', sampling=0.1, peak_width=3)
+        self.assertEqual(key, XicCache.key('abc', peak_width=3, sampling=0.1))
+        self.assertNotEqual(key, XicCache.key('abd', sampling=0.1,
+                                              peak_width=3))
+        self.assertNotEqual(key, XicCache.key('abc', sampling=0.1,
+                                              peak_width=4))
+        self.assertNotEqual(key, XicCache.key('abc', sampling=0.1))
+        with patch.object(spectre, '__version__', '999'):
+            self.assertNotEqual(key, XicCache.key('abc', sampling=0.1,
+                                                  peak_width=3))
+
+    def test_hit_miss(self):
+        self.assertIsNone(self.cache.get('missing'))
+        xic = make_xic(1)
+        self.cache.put('a', xic)
+        assert_same(self, self.cache.get('a'), xic)
+        self.assertIsNone(self.cache.get('b'))
+
+        # the entries are copy-on-write
+        result = self.cache.get('a')
+        result.data.data[:] = -1
+        assert_same(self, self.cache.get('a'), xic)
+
+        # a concurrent put of the same key keeps the stored entry
+        self.cache.put('a', make_xic(2))
+        assert_same(self, self.cache.get('a'), xic)
+        self.assertEqual(self.temporary(), [])
+
+        self.cache.clear()
+        self.assertIsNone(self.cache.get('a'))
+        self.assertEqual(self.cache.size(), 0)
+
+    def test_load(self):
+        file = os.path.join(self.directory, 'run.mzXML')
+        with open(file, 'w') as f:
+            f.write('1')
+        calls = dict(parse=0, preprocess=0)
+
+        def from_mzxml(path, sampling):
+            calls['parse'] += 1
+            with open(path) as f:
+                return make_xic(int(f.read()))
+
+        def preprocess(xic, peak_width):
+            calls['preprocess'] += 1
+            return doubled(xic, peak_width)
+
+        with patch.object(spectre.load, 'from_mzxml', from_mzxml):
+            raw = self.cache.load(file, 0.1)
+            assert_same(self, self.cache.load(file, 0.1), raw)
+            self.assertEqual(calls, dict(parse=1, preprocess=0))
+
+            # the parsed file is reused by each peak width
+            for peak_width in [3, 3, 4]:
+                result = self.cache.load(file, 0.1, peak_width, preprocess)
+                assert_same(self, result, doubled(raw, peak_width))
+            self.assertEqual(calls, dict(parse=1, preprocess=2))
+
+            # a renamed file hits, an edited one and a new sampling miss
+            renamed = os.path.join(self.directory, 'renamed.mzXML')
+            shutil.copy(file, renamed)
+            self.cache.load(renamed, 0.1)
+            self.assertEqual(calls['parse'], 1)
+            self.cache.load(file, 0.2)
+            self.assertEqual(calls['parse'], 2)
+            with open(file, 'w') as f:
+                f.write('2')
+            assert_same(self, self.cache.load(file, 0.1), make_xic(2))
+            self.assertEqual(calls['parse'], 3)
+            self.cache.load(file, 0.1, digest=file_digest(renamed))
+            self.assertEqual(calls['parse'], 3)
+
+    def test_eviction(self):
+        xic = make_xic(1)
+        self.cache.put('0', xic)
+        size = self.cache.size()
+        self.assertGreater(size, 0)
+
+        self.cache.max_bytes = 2 * size + size // 2
+        self.cache.put('1', xic)
+        # '0' is used before '1' and then again
+        for i in range(2):
+            os.utime(self.cache._path(str(i)), (i + 1, i + 1))
+        self.assertIsNotNone(self.cache.get('0'))
+
+        # the least recently used entry is evicted first
+        self.cache.put('2', xic)
+        self.assertIsNone(self.cache.get('1'))
+        self.assertIsNotNone(self.cache.get('0'))
+        self.assertIsNotNone(self.cache.get('2'))
+        self.assertEqual(self.cache.size(), 2 * size)
+
+        self.cache.max_bytes = size // 2
+        self.cache.evict()
+        self.assertEqual(self.cache.size(), 0)
+        self.assertEqual(self.temporary(), [])
+
+    def test_concurrent(self):
+        seeds = list(range(16))
+        with multiprocessing.Pool(4) as pool:
+            writers = [pool.apply_async(put_many, (self.cache.directory,
+                                                   seeds[i::2]))
+                       for i in range(2)]
+            readers = [pool.apply_async(get_many, (self.cache.directory,
+                                                   seeds, 20))
+                       for _ in range(2)]
+            # clearing never breaks an entry being written
+            while not all(result.ready() for result in writers):
+                self.cache.clear()
+            for result in writers + readers:
+                result.get()
+
+        self.assertEqual(self.temporary(), [])
+        for seed in seeds:
+            xic = self.cache.get(str(seed))
+            if xic is not None:
+                assert_same(self, xic, make_xic(seed))
+
+        put_many(self.cache.directory, seeds)
+        self.assertEqual(get_many(self.cache.directory, seeds, 1), len(seeds))
@@ -0,0 +1,68 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import csr_matrix
+
+import spectre.sparse.preprocess_cpp as cpp
+
+
+def shuffled_matrix(n_rows=50, n_cols=3000, nnz=20000, dtype=np.float64,
+                    seed=0):
+    """A CSR matrix with unsorted rows, many of them with duplicates."""
+    rng = np.random.RandomState(seed)
+    rows = np.sort(rng.randint(0, n_rows, nnz))
+    cols = rng.randint(0, n_cols, nnz)
+    data = rng.uniform(-1, 1, nnz).astype(dtype)
+    indptr = np.searchsorted(rows, np.arange(n_rows + 1)).astype(np.int32)
+    return csr_matrix((data, cols.astype(np.int32), indptr), (n_rows, n_cols))
+
+
+class TestCanonical(TestCase):
+    def test_is_canonical(self):
+        x = shuffled_matrix()
+        self.assertFalse(cpp.is_canonical(x))
+        self.assertFalse(cpp.is_canonical(x.tocoo()))
+
+        x.sum_duplicates()
+        for n_threads in [1, 4]:
+            self.assertTrue(cpp.is_canonical(x, n_threads))
+            self.assertTrue(cpp.is_canonical(x.tocoo(), n_threads))
+
+    def test_canonicalize(self):
+        for dtype in [np.float32, np.float64]:
+            x = shuffled_matrix(dtype=dtype)
+            expected = x.copy()
+            expected.sum_duplicates()
+
+            result = cpp.canonicalize(x, n_threads=4)
+            self.assertIs(result, x)
+            self.assertTrue(x.has_canonical_format)
+            self.assertTrue(np.array_equal(x.indptr, expected.indptr))
+            self.assertTrue(np.array_equal(x.indices, expected.indices))
+            self.assertTrue(np.allclose(x.data, expected.data, atol=1e-6))
+
+    def test_nearly_sorted(self):
+        x = shuffled_matrix()
+        x.sum_duplicates()
+        expected = x.copy()
+        x.indices[[10, 11]] = x.indices[[11, 10]]
+        x.data[[10, 11]] = x.data[[11, 10]]
+
+        cpp.canonicalize(x)
+        self.assertTrue(np.array_equal(x.indices, expected.indices))
+        self.assertTrue(np.array_equal(x.data, expected.data))
+
+    def test_duplicate_ops(self):
+        indptr = np.array([0, 3, 5, 6])
+        cols = np.array([3, 1, 3, 2, 2, 0])
+        data = np.array([1., 2., 5., -1., -4., 7.])
+        for op, values in [('sum', [2, 6, -5, 7]), ('max', [2, 5, -1, 7]),
+                           ('min', [2, 1, -4, 7])]:
+            x = csr_matrix((data.copy(), cols.copy(), indptr.copy()), (3, 4))
+            cpp.canonicalize(x, op)
+            self.assertEqual(list(x.indptr), [0, 2, 3, 4])
+            self.assertEqual(list(x.indices), [1, 3, 2, 0])
+            self.assertEqual(list(x.data), values)
+
+        with self.assertRaises(ValueError):
+            cpp.canonicalize(x, 'mean')
@@ -0,0 +1,152 @@
+import copy
+import os
+import shutil
+import subprocess
+import tempfile
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import csc_matrix
+
+import spectre.sparse.preprocess_cpp as cpp
+from spectre.load import from_arrays, to_arrays
+from spectre.synthetic import synthetic_xic
+
+# the `spectre-preprocess` executable of the build, e.g.
+# `SPECTRE_PREPROCESS=build/spectre-preprocess`, otherwise the one on PATH
+EXECUTABLE = (os.environ.get('SPECTRE_PREPROCESS') or
+              shutil.which('spectre-preprocess'))
+
+
+class TestCommandLine(TestCase):
+    def setUp(self):
+        if EXECUTABLE is None:
+            self.skipTest('spectre-preprocess is not built')
+        self.directory = tempfile.mkdtemp()
+        self.input = os.path.join(self.directory, 'input')
+        self.output = os.path.join(self.directory, 'output')
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def run_cli(self, *args):
+        return subprocess.run([EXECUTABLE, *args], stdout=subprocess.PIPE,
+                              stderr=subprocess.PIPE, universal_newlines=True)
+
+    def assertFails(self, message, *args):
+        process = self.run_cli(*args)
+        self.assertNotEqual(process.returncode, 0)
+        self.assertIn(message, process.stderr)
+
+    def test_round_trip(self):
+        xic = synthetic_xic(n_scans=400, mz_range=(100., 105.), n_peaks=30,
+                            seed=2)
+        for layout in ['csr', 'csc']:
+            for dtype in [np.float32, np.float64]:
+                for index_type in [np.int32, np.int64]:
+                    for peak_width in [3, 4.5]:
+                        with self.subTest(layout=layout, dtype=dtype,
+                                          index_type=index_type,
+                                          peak_width=peak_width):
+                            data = xic.data.asformat(layout).astype(dtype)
+                            data.indptr = data.indptr.astype(index_type)
+                            data.indices = data.indices.astype(index_type)
+                            source = copy.deepcopy(xic)
+                            source.data = data
+                            self.check(source, peak_width)
+
+    def test_duplicates(self):
+        xic = synthetic_xic(n_scans=200, mz_range=(100., 102.), n_peaks=10,
+                            seed=3)
+        data = xic.data.tocoo()
+        rng = np.random.RandomState(0)
+        order = rng.permutation(data.nnz)
+        duplicates = rng.choice(data.nnz, data.nnz // 4)
+        rows = np.r_[data.row[order], data.row[duplicates]]
+        cols = np.r_[data.col[order], data.col[duplicates]]
+        values = np.r_[data.data[order], data.data[duplicates]]
+
+        # unsorted indices with duplicates, summed on the way in
+        order = np.argsort(cols, kind='stable')
+        counts = np.bincount(cols, minlength=data.shape[1])
+        indptr = np.r_[0, np.cumsum(counts)]
+        source = copy.deepcopy(xic)
+        source.data = csc_matrix((values[order], rows[order], indptr),
+                                 shape=data.shape)
+        self.assertFalse(cpp.is_canonical(source.data))
+        self.check(source, 3)
+
+    def check(self, xic, peak_width):
+        to_arrays(xic, self.input)
+        process = self.run_cli('-w', str(peak_width), '-j', '2', self.input,
+                               self.output)
+        self.assertEqual(process.returncode, 0, process.stderr)
+
+        result = from_arrays(self.output)
+        expected = cpp.preprocess(copy.deepcopy(xic), peak_width)
+        self.assertEqual(result.data.format, 'csc')
+        self.assertEqual(result.data.shape, expected.data.shape)
+        self.assertEqual(result.data.dtype, expected.data.dtype)
+        self.assertTrue(np.array_equal(result.mz_scales, xic.mz_scales))
+        self.assertTrue(np.array_equal(result.rt_scales, xic.rt_scales))
+        tol = 1e-4 if result.data.dtype == np.float32 else 1e-9
+        np.testing.assert_allclose(result.data.toarray(),
+                                   expected.data.toarray(), rtol=tol,
+                                   atol=tol)
+
+    def write_npy(self, name, header, payload=b''):
+        """A version 1.0 `.npy` file with a given header dictionary."""
+        header = header.ljust(117) + '\n'
+        with open(os.path.join(self.input, name), 'wb') as f:
+            f.write(b'\x93NUMPY\x01\x00' + len(header).to_bytes(2, 'little'))
+            f.write(header.encode('latin1') + payload)
+
+    def test_malformed(self):
+        to_arrays(synthetic_xic(n_scans=20, mz_range=(100., 101.),
+                                n_peaks=2), self.input)
+        args = ['-w', '3', self.input, self.output]
+        shape = "'fortran_order': False, 'shape': (0,), "
+        for descr in ["'<f'", "'<f2'", "'<c16'", "'>f8'", "'<f8x'", "'<i'",
+                      "'<i3'", "'|b1'", "'<f8", "''", ""]:
+            with self.subTest(descr=descr):
+                self.write_npy('data.npy', "{'descr': " + descr + ", " +
+                               shape + "}")
+                self.assertFails('data.npy: has an unsupported dtype', *args)
+
+        for header in ["{'shape': (0,), }", "{'descr': '<f8', }",
+                       "{'descr':", "{'descr': '<f8', 'shape': (0,",
+                       "{'descr': '<f8', 'shape': (2, 3), }"]:
+            with self.subTest(header=header):
+                self.write_npy('data.npy', header)
+                process = self.run_cli(*args)
+                self.assertEqual(process.returncode, 1, process.stderr)
+                self.assertIn('data.npy: ', process.stderr)
+
+        self.write_npy('data.npy', "{'descr': '<f8', " + shape.replace(
+            '(0,)', '(4,)') + "}", b'\0' * 16)
+        self.assertFails('data.npy: has truncated data', *args)
+
+        for header, message in [("(-1,)", 'is not a one-dimensional array'),
+                                ("(x,)", 'is not a one-dimensional array'),
+                                ("(4611686018427387904,)",
+                                 'has too many elements')]:
+            with self.subTest(header=header):
+                self.write_npy('data.npy', "{'descr': '<f8', " +
+                               shape.replace('(0,)', header) + "}")
+                self.assertFails('data.npy: ' + message, *args)
+
+    def test_malformed_meta(self):
+        to_arrays(synthetic_xic(n_scans=20, mz_range=(100., 101.),
+                                n_peaks=2), self.input)
+        args = ['-w', '3', self.input, self.output]
+        for shape, message in [('', 'has no format or shape'),
+                               ('"shape"', 'has a malformed shape'),
+                               ('"shape": [20]', 'has a malformed shape'),
+                               ('"shape": [20, ]', 'has a malformed shape'),
+                               ('"shape": [20, 5', 'has a malformed shape'),
+                               ('"shape": [-1, 5]', 'a negative shape'),
+                               ('"shape": [20, -1]', 'a negative shape')]:
+            with self.subTest(shape=shape):
+                with open(os.path.join(self.input, 'meta.json'), 'w') as f:
+                    f.write('{"format": "csc", ' + shape + '}')
+                self.assertFails(message, *args)
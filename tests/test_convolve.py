@@ -0,0 +1,75 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.signal import savgol_coeffs
+from scipy.sparse import random as sparse_random
+
+import spectre.sparse.preprocess_cpp as cpp
+
+
+def random_matrix(shape, axis, dtype, index_type, seed):
+    x = sparse_random(*shape, density=0.25, format='csr', dtype=dtype,
+                      random_state=np.random.RandomState(seed)) * 10
+    x = (x.tocsc() if axis == 0 else x.tocsr()).astype(dtype)
+    x.indptr = x.indptr.astype(index_type)
+    x.indices = x.indices.astype(index_type)
+    return x
+
+
+def cases():
+    seed = 0
+    for axis in [0, 1]:
+        for shape in [(40, 15), (1, 9), (9, 1), (6, 4)]:
+            for dtype in [np.float32, np.float64]:
+                for index_type in [np.int32, np.int64]:
+                    seed += 1
+                    yield random_matrix(shape, axis, dtype, index_type,
+                                        seed), axis
+
+
+class TestConvolveMany(TestCase):
+    def assertSame(self, results, expected):
+        self.assertEqual(len(results), len(expected))
+        for result, reference in zip(results, expected):
+            self.assertEqual(type(result), type(reference))
+            self.assertEqual(result.dtype, reference.dtype)
+            self.assertTrue(np.array_equal(result.indptr, reference.indptr))
+            self.assertTrue(np.array_equal(result.indices, reference.indices))
+            rtol = 1e-5 if result.dtype == np.float32 else 1e-12
+            np.testing.assert_allclose(result.data, reference.data,
+                                       rtol=rtol, atol=rtol)
+
+    def test_convolve_many(self):
+        rng = np.random.RandomState(0)
+        for x, axis in cases():
+            for window in [1, 4, 7, 60]:
+                coeffs = rng.normal(size=(3, window))
+                with self.subTest(shape=x.shape, axis=axis, dtype=x.dtype,
+                                  index_type=x.indices.dtype, window=window):
+                    results = cpp.convolve_many(x, coeffs, axis)
+                    self.assertSame(results, [cpp.convolve(x, c, axis)
+                                              for c in coeffs])
+
+    def test_single_kernel(self):
+        x, axis = next(cases())
+        coeffs = np.array([0.25, 0.5, 0.25])
+        self.assertSame(cpp.convolve_many(x, coeffs, axis),
+                        [cpp.convolve(x, coeffs, axis)])
+
+    def test_savgol_filters(self):
+        for x, axis in cases():
+            for window, degree in [(5, 2), (11, 3), (7, 4)]:
+                derivs = [0, 1, 2]
+                with self.subTest(shape=x.shape, axis=axis, dtype=x.dtype,
+                                  window=window, degree=degree):
+                    results = cpp.savgol_filters(x, window, degree, derivs,
+                                                 axis, delta=0.5)
+                    expected = [
+                        cpp.convolve(x, savgol_coeffs(window, degree,
+                                                      deriv=d, delta=0.5),
+                                     axis)
+                        for d in derivs]
+                    self.assertSame(results, expected)
+                    self.assertSame(
+                        results[:1],
+                        [cpp.savgol_filter(x, window, degree, axis)])
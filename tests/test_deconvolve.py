@@ -0,0 +1,70 @@
+from unittest import TestCase
+
+import numpy as np
+
+from spectre.dense.deconvolve import nmf
+from spectre.synthetic import synthetic_xic
+
+
+class TestNmf(TestCase):
+    def setUp(self):
+        self.xic = synthetic_xic(n_scans=120, mz_range=(100., 120.),
+                                 n_peaks=12, noise=1., seed=5)
+
+    def test_shapes(self):
+        n_rt, n_mz = self.xic.data.shape
+        for window in [7, 50, 120, 500]:
+            for warm_start in [True, False]:
+                with self.subTest(window=window, warm_start=warm_start):
+                    spectra, profiles, errors = nmf(
+                        self.xic, 3, window, max_iter=20,
+                        warm_start=warm_start, n_threads=2)
+                    n_windows = -(-n_rt // window)
+
+                    self.assertEqual(spectra.shape, (n_windows, 3, n_mz))
+                    self.assertEqual(profiles.shape, (n_rt, 3))
+                    self.assertEqual(errors.shape, (n_windows,))
+                    self.assertTrue(np.all(spectra >= 0))
+                    self.assertTrue(np.all(profiles >= 0))
+
+    def test_error_decreases(self):
+        def fit(max_iter):
+            return nmf(self.xic, 4, 40, max_iter=max_iter, tol=0,
+                       warm_start=False, n_threads=2)
+
+        _, _, coarse = fit(2)
+        spectra, profiles, fine = fit(200)
+        self.assertTrue(np.all(fine <= coarse + 1e-12))
+        self.assertLess(fine.sum(), coarse.sum())
+
+        # the reported errors are the relative errors of the reconstruction
+        data = self.xic.data.toarray()
+        for w, (a, b) in enumerate([(0, 40), (40, 80), (80, 120)]):
+            fitted = profiles[a:b] @ spectra[w]
+            error = np.linalg.norm(data[a:b] - fitted) / np.linalg.norm(
+                data[a:b])
+            self.assertAlmostEqual(error, fine[w], places=6)
+
+    def test_invalid_arrays(self):
+        from spectre.sparse import _sparse
+
+        data = self.xic.data.tocsr()
+        n_rt, n_mz = data.shape
+        windows = np.array([0, 60, n_rt], dtype=data.indptr.dtype)
+
+        def run(windows=windows, W=n_rt * 3, H=2 * n_mz * 3, errors=2,
+                rank=3):
+            _sparse.nmf_csr(data.indptr, data.indices, data.data, windows,
+                            np.ones(W), np.ones(H), np.zeros(errors), n_mz,
+                            rank, 5, 0., False, 1)
+
+        run()
+        for i, kwargs in enumerate([dict(W=n_rt * 3 - 1), dict(H=n_mz * 3),
+                                    dict(errors=3), dict(rank=2),
+                                    dict(rank=0),
+                                    dict(windows=windows[::-1].copy()),
+                                    dict(windows=windows + 1),
+                                    dict(windows=windows[:0])]):
+            with self.subTest(case=i):
+                with self.assertRaises(ValueError):
+                    run(**kwargs)
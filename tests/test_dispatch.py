@@ -0,0 +1,235 @@
+import os
+import subprocess
+import sys
+import tempfile
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import random as sparse_random
+
+from spectre.sparse import _sparse
+
+INDEX_TYPES = [np.int16, np.int32, np.int64, np.uint16, np.uint32, np.uint64]
+VALUE_TYPES = [np.float32, np.float64]
+LEVELS = ['baseline', 'sse42', 'avx2', 'avx512']
+
+
+class TestDtypeDispatch(TestCase):
+    def setUp(self):
+        self.x = sparse_random(12, 30, density=0.3, format='csr',
+                               random_state=np.random.RandomState(3))
+        self.expected = self.x.toarray().std(axis=1)
+
+    def std(self, indptr, data, result=None, **kwargs):
+        if result is None:
+            result = np.empty(len(indptr) - 1, dtype=data.dtype)
+        _sparse.std_csr(indptr, data, self.x.shape[1], result, **kwargs)
+        return result
+
+    def test_types(self):
+        for index_type in INDEX_TYPES:
+            for value_type in VALUE_TYPES:
+                with self.subTest(index_type=index_type.__name__,
+                                  value_type=value_type.__name__):
+                    result = self.std(self.x.indptr.astype(index_type),
+                                      self.x.data.astype(value_type))
+                    self.assertEqual(result.dtype, value_type)
+                    self.assertTrue(np.allclose(result, self.expected,
+                                                rtol=1e-5, atol=1e-6))
+
+    def test_unsupported_dtypes(self):
+        data = self.x.data
+        with self.assertRaisesRegex(TypeError, "'rows'"):
+            self.std(self.x.indptr.astype(np.int8), data)
+        with self.assertRaisesRegex(TypeError, "'data'"):
+            self.std(self.x.indptr, data.astype(np.float16),
+                     np.empty(12, dtype=np.float16))
+        with self.assertRaisesRegex(TypeError, "'rows'"):
+            self.std(list(self.x.indptr), data, np.empty(12))
+
+    def test_mismatched_dtypes(self):
+        indptr = self.x.indptr.astype(np.int64)
+        data = self.x.data.astype(np.float64)
+
+        # the output is never converted
+        with self.assertRaisesRegex(TypeError, "'result'"):
+            self.std(indptr, data, np.empty(12, dtype=np.float32))
+        with self.assertRaisesRegex(TypeError, "'result'"):
+            self.std(indptr, data, np.empty(12, dtype=np.float32), copy=True)
+
+        # the pattern arrays must share the dtype, unless copy is passed
+        plan_args = (indptr, self.x.indices.astype(np.int32), 30, 3,
+                     np.int64)
+        with self.assertRaisesRegex(TypeError, "'A_cols'"):
+            _sparse.RollingPlan(*plan_args)
+        plan = _sparse.RollingPlan(*plan_args, copy=True)
+        self.assertEqual(plan.indices.dtype, np.int64)
+
+    def test_narrowing(self):
+        indptr = self.x.indptr.astype(np.uint32)
+        indices = self.x.indices.astype(np.uint32)
+        plan = _sparse.RollingPlan(indptr, indices, 30, 3, np.int64)
+        self.assertEqual(plan.indptr.dtype, np.int64)
+
+        with self.assertRaisesRegex(TypeError, 'do not fit'):
+            _sparse.RollingPlan(indptr.astype(np.uint64),
+                                indices.astype(np.uint64), 30, 3, np.int64)
+        with self.assertRaisesRegex(TypeError, 'do not fit'):
+            _sparse.RollingPlan(indptr, indices, 30, 3, np.int32)
+
+    def test_layout(self):
+        indptr = self.x.indptr
+        strided = np.repeat(self.x.indptr, 2)[::2]
+        self.assertFalse(strided.flags.c_contiguous)
+        with self.assertRaisesRegex(TypeError, 'non-contiguous'):
+            self.std(strided, self.x.data)
+        self.assertTrue(np.allclose(self.std(strided, self.x.data,
+                                             copy=True), self.expected))
+
+        # the values are only iterated over, a read-only strided view is
+        # read in place
+        data = np.repeat(self.x.data, 2)[::2]
+        data.flags.writeable = False
+        self.assertFalse(data.flags.c_contiguous)
+        self.assertTrue(np.allclose(self.std(indptr, data), self.expected))
+
+        # read-only inputs are accepted, read-only outputs are not
+        data = self.x.data.copy()
+        data.flags.writeable = False
+        self.assertTrue(np.allclose(self.std(indptr, data), self.expected))
+        result = np.empty(12)
+        result.flags.writeable = False
+        with self.assertRaisesRegex(TypeError, 'read-only'):
+            self.std(indptr, data, result)
+
+
+class TestOutputSizes(TestCase):
+    """The bindings reject caller-provided outputs that do not have the size
+    of their allocation step, rather than writing past their end."""
+
+    def setUp(self):
+        self.x = sparse_random(12, 30, density=0.3, format='csr',
+                               random_state=np.random.RandomState(3))
+
+    def test_rolling(self):
+        x = self.x
+        indptr = np.empty_like(x.indptr)
+        size = _sparse.rolling_alloc_csr(x.indptr, x.indices, indptr, 30, 3)
+        for cols, values in [(size - 1, size), (size, size + 1), (0, 0)]:
+            with self.subTest(cols=cols, values=values):
+                with self.assertRaisesRegex(ValueError, 'B_'):
+                    _sparse.rolling_max_csr(
+                        x.indptr, x.indices, x.data,
+                        np.empty(cols, dtype=indptr.dtype), np.empty(values),
+                        30, 3)
+        with self.assertRaisesRegex(ValueError, 'B_rows'):
+            _sparse.rolling_alloc_csr(x.indptr, x.indices, indptr[:-1], 30, 3)
+        with self.assertRaisesRegex(ValueError, 'A_rows'):
+            _sparse.rolling_max_csr(
+                x.indptr[::-1].copy(), x.indices, x.data,
+                np.empty(size, dtype=indptr.dtype), np.empty(size), 30, 3)
+
+    def test_std(self):
+        x = self.x
+        with self.assertRaisesRegex(ValueError, 'result'):
+            _sparse.std_csr(x.indptr, x.data, 30, np.empty(11))
+        with self.assertRaisesRegex(ValueError, 'rows'):
+            _sparse.std_csr(x.indptr, x.data[:-1], 30, np.empty(12))
+
+    def test_peaks(self):
+        x = self.x
+        indptr = np.empty_like(x.indptr)
+        size = _sparse.peaks_alloc_csr(x.indptr, x.indices, x.data, indptr,
+                                       30, 0., 0., 1)
+        outputs = [np.empty(size, dtype=indptr.dtype)] + [
+            np.empty(size) for _ in range(5)]
+        _sparse.peaks_csr(x.indptr, x.indices, x.data, indptr, *outputs, 30,
+                          0., 0., 1)
+        with self.assertRaisesRegex(ValueError, 'B_right'):
+            _sparse.peaks_csr(x.indptr, x.indices, x.data, indptr,
+                              *outputs[:-1], np.empty(size + 1), 30, 0., 0.,
+                              1)
+
+        # offsets of other arguments do not fit the peaks of the rows
+        other = np.zeros_like(indptr)
+        other[-1] = size
+        with self.assertRaises(ValueError):
+            _sparse.peaks_csr(x.indptr, x.indices, x.data, other, *outputs,
+                              30, 0., 0., 1)
+
+    def test_resample(self):
+        x = self.x
+        positions = np.linspace(0, 11, 7)
+        indptr = np.empty(8, dtype=x.indptr.dtype)
+        size = _sparse.resample_alloc_csr(x.indptr, x.indices, positions,
+                                          indptr)
+        indices = np.empty(size, dtype=indptr.dtype)
+        with self.assertRaisesRegex(ValueError, 'B_data'):
+            _sparse.resample_csr(x.indptr, x.indices, x.data, positions,
+                                 indptr, indices, np.empty(size - 1))
+        with self.assertRaises(ValueError):
+            _sparse.resample_csr(x.indptr, x.indices, x.data, positions,
+                                 np.r_[indptr[:-1], size + 1].astype(
+                                     indptr.dtype),
+                                 np.empty(size + 1, dtype=indptr.dtype),
+                                 np.empty(size + 1))
+
+
+# Runs in a fresh interpreter with `SPECTRE_ISA` set, the level is selected
+# once when the module is imported
+ISA_SCRIPT = '''
+import sys
+import numpy as np
+from scipy.sparse import random as sparse_random
+from spectre.sparse import _sparse
+import spectre.sparse.preprocess_cpp as cpp
+
+x = sparse_random(200, 50, density=0.2, format='csc',
+                  random_state=np.random.RandomState(0))
+np.savez(sys.argv[1], isa=_sparse.isa,
+         median=cpp.rolling_median(x, 7, 0).toarray(),
+         mean=cpp.rolling_mean(x, 7, 0).toarray(),
+         savgol=cpp.savgol_filter(x, 7, 2, 0).toarray(),
+         std=cpp.std(x, 0))
+'''
+
+
+class TestIsa(TestCase):
+    def run_isa(self, level):
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'result.npz')
+            env = dict(os.environ, SPECTRE_ISA=level)
+            process = subprocess.run([sys.executable, '-c', ISA_SCRIPT, path],
+                                     env=env, stderr=subprocess.PIPE)
+            if process.returncode:
+                return process.stderr.decode(), None
+            with np.load(path) as result:
+                return None, dict(result)
+
+    def test_selected(self):
+        self.assertIn(_sparse.isa, LEVELS)
+
+    def test_levels(self):
+        error, reference = self.run_isa('baseline')
+        self.assertIsNone(error)
+        self.assertEqual(reference['isa'], 'baseline')
+
+        for level in LEVELS[1:]:
+            with self.subTest(level=level):
+                error, result = self.run_isa(level)
+                if error is not None:
+                    # only the levels of this CPU and this build may be forced
+                    self.assertRegex(error, 'SPECTRE_ISA={} is not'
+                                            .format(level))
+                    continue
+                self.assertEqual(result['isa'], level)
+                # the medians are exact, the sums may be contracted to FMA
+                np.testing.assert_array_equal(result['median'],
+                                              reference['median'])
+                for name in ['mean', 'savgol', 'std']:
+                    np.testing.assert_allclose(result[name], reference[name],
+                                               rtol=1e-9, atol=1e-12)
+
+    def test_unknown(self):
+        error, _ = self.run_isa('sse9')
+        self.assertRegex(error, 'SPECTRE_ISA=sse9 is not built')
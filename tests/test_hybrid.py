@@ -0,0 +1,77 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import random as sparse_random
+
+import spectre.sparse.hybrid as hybrid
+import spectre.sparse.preprocess_cpp as cpp
+from spectre.sparse.hybrid import HybridMatrix, HybridXic
+from spectre.synthetic import synthetic_xic
+
+
+def busy_matrix(dtype=np.float64, seed=0):
+    """A sparse matrix with a few almost dense columns."""
+    rng = np.random.RandomState(seed)
+    x = sparse_random(200, 60, density=0.05, format='lil', dtype=dtype,
+                      random_state=rng)
+    for col in [0, 1, 17, 59]:
+        x[:, col] = rng.uniform(0.5, 2, (200, 1)) * (rng.rand(200, 1) < 0.9)
+    return x.tocsc()
+
+
+class TestHybridMatrix(TestCase):
+    def test_conversions(self):
+        x = busy_matrix()
+        h = HybridMatrix.from_sparse(x, threshold=0.5)
+
+        self.assertEqual(list(h.columns), [0, 1, 17, 59])
+        self.assertEqual(h.dense.shape, (4, 200))
+        self.assertEqual(np.diff(h.sparse.indptr)[h.columns].sum(), 0)
+        self.assertTrue(np.array_equal(h.toarray(), x.toarray()))
+        self.assertTrue(np.array_equal(h.tocsc().toarray(), x.toarray()))
+
+        xic = synthetic_xic(n_scans=100, n_peaks=10)
+        back = HybridXic.from_xic(xic, threshold=2).to_xic()
+        self.assertTrue(np.array_equal(back.data.toarray(),
+                                       xic.data.toarray()))
+
+    def assertKernel(self, hybrid_result, sparse_result):
+        self.assertTrue(np.allclose(hybrid_result.toarray(),
+                                    sparse_result.toarray(), atol=1e-12))
+
+    def test_rolling(self):
+        for dtype in [np.float32, np.float64]:
+            x = busy_matrix(dtype)
+            h = HybridMatrix.from_sparse(x)
+            for op in ['min', 'max', 'mean', 'median', 'sum', 'count']:
+                for window in [1, 4, 15, 401]:
+                    with self.subTest(dtype=dtype, op=op, window=window):
+                        name = 'rolling_' + op
+                        result = getattr(hybrid, name)(h, window)
+                        self.assertEqual(result.dtype, dtype)
+                        self.assertTrue(np.allclose(
+                            result.toarray(),
+                            getattr(cpp, name)(x, window, 0).toarray(),
+                            rtol=1e-5 if dtype == np.float32 else 1e-12))
+
+    def test_convolve_and_std(self):
+        x = busy_matrix()
+        h = HybridMatrix.from_sparse(x)
+
+        self.assertKernel(hybrid.savgol_filter(h, 7, 3),
+                          cpp.savgol_filter(x, 7, 3, axis=0))
+        self.assertTrue(np.allclose(hybrid.std(h), cpp.std(x, axis=0)))
+
+    def test_estimate_baseline(self):
+        x = busy_matrix()
+        h = HybridMatrix.from_sparse(x)
+
+        self.assertKernel(hybrid.estimate_baseline(h, 21),
+                          cpp.estimate_baseline(x, 21))
+
+    def test_mismatched_columns(self):
+        x = busy_matrix()
+        a = HybridMatrix.from_sparse(x, threshold=0.5)
+        b = HybridMatrix.from_sparse(x, threshold=2)
+        with self.assertRaises(ValueError):
+            hybrid.max_clip_spmat_plus_dvec(a, b, np.zeros(x.shape[1]))
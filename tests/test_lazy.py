@@ -0,0 +1,172 @@
+import copy
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import csc_matrix, random as sparse_random
+
+import spectre.sparse.preprocess_cpp as cpp
+from spectre.lazy import LazyXic, _SubtractClip, _fuse
+from spectre.synthetic import synthetic_xic
+from spectre.xic import Xic
+
+
+def random_matrix(shape, seed, dtype=np.float64):
+    x = sparse_random(*shape, density=0.3, format='csc', dtype=dtype,
+                      random_state=np.random.RandomState(seed))
+    x.data -= 0.5
+    return x
+
+
+class TestSubtractClip(TestCase):
+    def test_clip_of_difference(self):
+        seed = 0
+        for axis in [0, 1]:
+            for shape in [(30, 12), (1, 7), (7, 1), (0, 3)]:
+                for lower, upper in [(0, np.inf), (-0.2, 0.3), (-np.inf, 0),
+                                     (0, 0)]:
+                    seed += 1
+                    a = random_matrix(shape, seed)
+                    b = random_matrix(shape, seed + 1000)
+                    with self.subTest(axis=axis, shape=shape, lower=lower,
+                                      upper=upper):
+                        result = cpp.subtract_clip(a, b, lower, upper, axis)
+                        expected = cpp.clip(a - b, lower, upper, axis)
+                        self.assertEqual(result.format, expected.format)
+                        self.assertTrue(result.has_canonical_format)
+                        self.assertTrue(np.array_equal(result.indptr,
+                                                       expected.indptr))
+                        self.assertTrue(np.array_equal(result.indices,
+                                                       expected.indices))
+                        self.assertTrue(np.array_equal(result.data,
+                                                       expected.data))
+
+    def test_operands(self):
+        a = random_matrix((20, 9), 1, np.float32)
+        b = random_matrix((20, 9), 2).tocsr()
+        b.indices = b.indices.astype(np.int64)
+        b.indptr = b.indptr.astype(np.int64)
+        result = cpp.subtract_clip(a, b)
+        self.assertEqual(result.dtype, np.float64)
+        self.assertTrue(np.array_equal(
+            result.toarray(), np.maximum(a.toarray() - b.toarray(), 0)))
+
+        # duplicates and unsorted indices of the inputs are merged first
+        c = csc_matrix((np.ones(3), np.array([4, 1, 4]), np.array([0, 3, 3])),
+                       shape=(5, 2))
+        indices = c.indices.copy()
+        result = cpp.subtract_clip(c, c * 0.5, 0, 0.75)
+        self.assertTrue(np.array_equal(result.toarray(),
+                                       np.minimum(c.toarray() * 0.5, 0.75)))
+        self.assertTrue(np.array_equal(c.indices, indices))
+
+    def test_errors(self):
+        a = random_matrix((5, 4), 1)
+        with self.assertRaises(ValueError):
+            cpp.subtract_clip(a, a, 0.5, 1)
+        with self.assertRaises(ValueError):
+            cpp.subtract_clip(a, random_matrix((4, 5), 1))
+
+
+class TestLazy(TestCase):
+    def setUp(self):
+        self.xic = synthetic_xic(n_scans=300, mz_range=(100., 104.),
+                                 n_peaks=20, peak_width=4., seed=1)
+
+    def eager(self, peak_width):
+        return cpp.preprocess(copy.deepcopy(self.xic), peak_width).data
+
+    def select(self, x, mz_range=None, rt_range=None):
+        """The eager slicing of `LazyXic.select`."""
+        def bounds(scales, value_range):
+            if value_range is None:
+                return 0, len(scales)
+            return (np.searchsorted(scales, value_range[0], 'left'),
+                    np.searchsorted(scales, value_range[1], 'right'))
+
+        (r0, r1) = bounds(self.xic.rt_scales, rt_range)
+        (c0, c1) = bounds(self.xic.mz_scales, mz_range)
+        return x.tocsc()[r0:r1, c0:c1]
+
+    def assertSame(self, result, expected):
+        self.assertEqual(result.shape, expected.shape)
+        np.testing.assert_allclose(result.toarray(), expected.toarray(),
+                                   rtol=1e-12, atol=1e-12)
+
+    def ranges(self):
+        rt, mz = self.xic.rt_scales, self.xic.mz_scales
+        yield None, None
+        yield (mz[10], mz[25]), None
+        yield None, (rt[40], rt[100])
+        yield (mz[3], mz[3]), (rt[0], rt[7])
+        yield (mz[-5], mz[-1] + 1), (rt[-9], rt[-1] + 1)
+        yield (mz[0] - 1, mz[0] - 0.5), None
+
+    def test_preprocess(self):
+        for peak_width in [3, 4, 2.5]:
+            expected = self.eager(peak_width)
+            pipeline = self.xic.lazy().preprocess(peak_width)
+            for mz_range, rt_range in self.ranges():
+                with self.subTest(peak_width=peak_width, mz_range=mz_range,
+                                  rt_range=rt_range):
+                    result = pipeline.select(mz_range, rt_range).compute()
+                    self.assertSame(result.data, self.select(
+                        expected, mz_range, rt_range))
+
+    def test_windows(self):
+        # without a baseline the retention time range is pushed down, and
+        # each input is only computed over the range extended by the halo
+        x = self.xic.data
+        for window in [1, 2, 4, 5, 8]:
+            smooth = cpp.savgol_filter(x, window | 1, 2 if window > 2 else 0,
+                                       axis=0)
+            for stat in ['min', 'max', 'mean', 'median', 'sum', 'count']:
+                pipeline = self.xic.lazy().smooth(window | 1,
+                                                  2 if window > 2 else 0)
+                pipeline = pipeline.rolling(stat, window)
+                expected = getattr(cpp, 'rolling_' + stat)(smooth, window, 0)
+                for mz_range, rt_range in self.ranges():
+                    with self.subTest(window=window, stat=stat,
+                                      mz_range=mz_range, rt_range=rt_range):
+                        result = pipeline.select(mz_range, rt_range).compute()
+                        self.assertSame(result.data, self.select(
+                            expected, mz_range, rt_range))
+
+    def test_shared(self):
+        # the smoothing feeds both sides of the subtraction, over the union
+        # of the regions they request
+        x = self.xic.data
+        smooth = cpp.savgol_filter(x, 5, 2, axis=0)
+        for window in [4, 9]:
+            lazy = self.xic.lazy().smooth(5, 2)
+            pipeline = (lazy - lazy.rolling('min', window)).clip(0, 50)
+            expected = cpp.clip(smooth - cpp.rolling_min(smooth, window, 0),
+                                0, 50, axis=0)
+            for mz_range, rt_range in self.ranges():
+                with self.subTest(window=window, mz_range=mz_range,
+                                  rt_range=rt_range):
+                    selected = pipeline.select(mz_range, rt_range)
+                    self.assertSame(selected.compute().data, self.select(
+                        expected, mz_range, rt_range))
+
+            explain = pipeline.select(None, (self.xic.rt_scales[50],
+                                             self.xic.rt_scales[60])).explain()
+            self.assertEqual(explain.count('smooth'), 1)
+            self.assertIn('subtract_clip(0, 50)', explain)
+
+    def test_fused(self):
+        lazy = self.xic.lazy()
+        node = _fuse((lazy - lazy.rolling('max', 3)).clip(0).clip(-1, 2)
+                     ._node, {})
+        self.assertIsInstance(node, _SubtractClip)
+        self.assertEqual((node.lower, node.upper), (0, 2))
+
+    def test_source_copy(self):
+        data = csc_matrix((np.array([1., 2., 3.]), np.array([3, 1, 3]),
+                           np.array([0, 3, 3])), shape=(5, 2))
+        indices, values = data.indices.copy(), data.data.copy()
+        result = LazyXic.from_xic(Xic(data, np.arange(2.),
+                                      np.arange(5.))).compute()
+        self.assertTrue(np.array_equal(data.indices, indices))
+        self.assertTrue(np.array_equal(data.data, values))
+        self.assertTrue(np.array_equal(result.data.toarray(),
+                                       data.toarray()))
@@ -0,0 +1,129 @@
+import copy
+from unittest import TestCase
+
+import numpy as np
+from scipy.ndimage import maximum_filter1d
+
+import spectre.sparse.preprocess_cpp as cpp
+from spectre.online import AppendableXic, OnlinePreprocessor
+from spectre.synthetic import synthetic_xic
+
+
+def scans(xic):
+    """The raw scans of `xic`, its m/z values and intensities."""
+    data = xic.data.tocsr()
+    for i, rt in enumerate(xic.rt_scales):
+        a, b = data.indptr[i], data.indptr[i + 1]
+        yield rt, xic.mz_scales[data.indices[a:b]], data.data[a:b]
+
+
+class TestOnlinePreprocessor(TestCase):
+    def setUp(self):
+        self.xic = synthetic_xic(n_scans=300, mz_range=(100., 104.),
+                                 n_peaks=20, peak_width=4., seed=1)
+        # a column with a constant background, the baseline of which is not
+        # zero
+        data = self.xic.data.tolil()
+        data[:, 5] = data[:, 5].toarray() + 50
+        self.xic.data = data.tocsr()
+
+    def unclipped(self, peak_width):
+        """Whether no baseline value contributing to an output value was
+        clipped, i.e. the median did not exceed the minimum, so the result
+        does not depend on the standard deviation of the minimum."""
+        k = int(10 * peak_width)
+        k_med = min(k, self.xic.data.shape[0] - 1)
+        k_med = k_med if (k_med % 2) else (k_med - 1)
+
+        data = cpp.remove_noise(self.xic.data, peak_width).tocsc()
+        data_min = cpp.rolling_min(data, k, 0).toarray()
+        data_med = cpp.rolling_median(data, k_med, 0).toarray()
+        clipped = (data_med > data_min).astype(np.int8)
+        return maximum_filter1d(clipped, k + 1, axis=0) == 0
+
+    def test_batch(self):
+        for peak_width in [3, 2.5, 4]:
+            with self.subTest(peak_width=peak_width):
+                online = OnlinePreprocessor((100., 104.), 0.1, peak_width)
+                finalized = 0
+                for i, scan in enumerate(scans(self.xic)):
+                    finalized += online.append_scan(*scan)
+                    self.assertEqual(len(online.result),
+                                     max(0, i + 1 - online.latency))
+                self.assertEqual(finalized, len(online.result))
+
+                result = online.finish()
+                expected = cpp.preprocess(copy.deepcopy(self.xic),
+                                          peak_width)
+                self.assertEqual(result.data.shape, expected.data.shape)
+                self.assertTrue(np.array_equal(result.rt_scales,
+                                               expected.rt_scales))
+                self.assertTrue(np.allclose(result.mz_scales,
+                                            expected.mz_scales))
+
+                mask = self.unclipped(peak_width)
+                self.assertGreater(mask[:, 5].sum(), 0)
+                result, expected = (result.data.toarray(),
+                                    expected.data.toarray())
+                np.testing.assert_allclose(result[mask], expected[mask],
+                                           rtol=1e-12, atol=1e-9)
+                self.assertTrue(np.all(result >= 0))
+
+    def test_errors(self):
+        online = OnlinePreprocessor((100., 104.), 0.1, 3)
+        online.append_scan(1., [100.5], [10.])
+        with self.assertRaises(ValueError):
+            online.append_scan(1., [100.5], [10.])
+        with self.assertRaises(ValueError):
+            online.append_scan(0.5, [100.5], [10.])
+        with self.assertRaises(ValueError):
+            online.append_scan(2., [104.2], [10.])
+        with self.assertRaises(ValueError):
+            OnlinePreprocessor((100., 104.), 0.1, 0.05)
+
+
+class TestAppendableXic(TestCase):
+    def test_sample(self):
+        xic = AppendableXic((100., 101.), 0.1)
+        cols, values = xic.sample([100.52, 100.0, 100.48, 101.0],
+                                  [1., 2., 3., 4.])
+        self.assertTrue(np.array_equal(cols, [0, 5, 10]))
+        self.assertTrue(np.array_equal(values, [2., 3., 4.]))
+
+    def test_views(self):
+        xic = AppendableXic((100., 101.), 0.1, capacity=2)
+        rng = np.random.RandomState(0)
+        snapshots = []
+        for rt in range(50):
+            cols = np.flatnonzero(rng.uniform(size=xic.n_cols) < 0.5)
+            xic.append_row(float(rt), cols, rng.uniform(size=cols.size))
+            view = xic.to_xic()
+            snapshots.append((view, view.data.toarray(),
+                              view.rt_scales.copy()))
+
+        # the buffers were reallocated and written after the first views
+        for view, data, rt_scales in snapshots:
+            self.assertTrue(np.array_equal(view.data.toarray(), data))
+            self.assertTrue(np.array_equal(view.rt_scales, rt_scales))
+        self.assertTrue(np.array_equal(xic.to_xic().data.toarray()[:10],
+                                       snapshots[9][1]))
+
+    def test_errors(self):
+        with self.assertRaises(ValueError):
+            AppendableXic((101., 100.), 0.1)
+
+        xic = AppendableXic((100., 101.), 0.1)
+        with self.assertRaises(ValueError):
+            xic.append_scan(0., [99.9], [1.])
+        with self.assertRaises(ValueError):
+            xic.append_scan(0., [101.1], [1.])
+        with self.assertRaises(ValueError):
+            xic.append_scan(0., [100.5, 100.6], [1.])
+        self.assertEqual(len(xic), 0)
+
+        xic.append_scan(1., [100.5], [1.])
+        with self.assertRaises(ValueError):
+            xic.append_scan(1., [100.5], [1.])
+        with self.assertRaises(ValueError):
+            xic.append_row(0., np.array([1]), np.array([1.]))
+        self.assertEqual(xic.shape, (1, 11))
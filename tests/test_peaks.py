@@ -0,0 +1,59 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.signal import find_peaks as scipy_find_peaks, peak_widths
+
+import spectre.sparse.preprocess_cpp as cpp
+from spectre.synthetic import synthetic_xic
+
+
+class TestFindPeaks(TestCase):
+    def setUp(self):
+        self.xic = synthetic_xic(n_scans=300, mz_range=(100., 130.),
+                                 n_peaks=40, noise=5., density=0.05, seed=2)
+        self.peak_width = 5
+
+    def expected(self, prominence, min_width):
+        """The peaks of every smoothed column by `scipy.signal`."""
+        smoothed = cpp.matched_filter(self.xic.data, self.peak_width,
+                                      axis=0).toarray()
+        for col in range(smoothed.shape[1]):
+            x = smoothed[:, col]
+            peaks, props = scipy_find_peaks(x, prominence=prominence,
+                                            width=min_width, rel_height=0.5)
+            _, _, left, right = peak_widths(
+                x, peaks, rel_height=0.5,
+                prominence_data=(props['prominences'], props['left_bases'],
+                                 props['right_bases']))
+            for i, apex in enumerate(peaks):
+                lo, hi = props['left_bases'][i], props['right_bases'][i]
+                area = np.sum(x[lo:hi] + x[lo + 1:hi + 1]) / 2
+                yield (col, apex, x[apex], props['prominences'][i], area,
+                       left[i], right[i])
+
+    def test_against_scipy(self):
+        rt = self.xic.rt_scales
+        spacing = np.gradient(rt)
+        scans = np.arange(len(rt))
+        columns = {mz: col for col, mz in enumerate(self.xic.mz_scales)}
+
+        for prominence, min_width in [(0, 0), (20, 0), (1, 3)]:
+            with self.subTest(prominence=prominence, min_width=min_width):
+                features = cpp.find_peaks(self.xic, self.peak_width,
+                                          prominence, min_width, n_threads=2)
+                expected = list(self.expected(prominence, min_width))
+                self.assertGreater(len(expected), 0)
+                self.assertEqual(len(features.rt), len(expected))
+
+                for i, (col, apex, height, prom, area, left, right) in \
+                        enumerate(expected):
+                    self.assertEqual(columns[features.mz[i]], col)
+                    self.assertEqual(features.rt[i], rt[apex])
+                    self.assertAlmostEqual(features.height[i], height)
+                    self.assertAlmostEqual(features.prominence[i], prom)
+                    self.assertAlmostEqual(features.area[i],
+                                           area * spacing[apex])
+                    self.assertAlmostEqual(
+                        features.width[i],
+                        np.interp(right, scans, rt) -
+                        np.interp(left, scans, rt))
@@ -0,0 +1,71 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import random as sparse_random
+
+from spectre.sparse.preprocess_cpp import rolling_median
+from spectre.sparse.preprocess_cpp import rolling_median_approx
+
+
+class TestRollingMedianApprox(TestCase):
+    def assertWithinBound(self, x, window, axis, eps):
+        exact = rolling_median(x, window, axis)
+        approx = rolling_median_approx(x, window, axis, eps)
+
+        self.assertTrue(np.array_equal(exact.indptr, approx.indptr))
+        self.assertTrue(np.array_equal(exact.indices, approx.indices))
+
+        # the bound is relative to the range of each rolled line and zero
+        dense = x.toarray() if axis else x.toarray().T
+        lo = np.minimum(dense.min(axis=1), 0)
+        hi = np.maximum(dense.max(axis=1), 0)
+        bound = eps * (hi - lo) * (1 + 1e-9)
+
+        lines = np.repeat(np.arange(len(exact.indptr) - 1),
+                          np.diff(exact.indptr))
+        error = np.abs(exact.data - approx.data)
+        self.assertTrue(np.all(error <= bound[lines]),
+                        'max error {} for eps {}'.format(
+                            np.max(error / np.maximum(bound[lines], 1e-300),
+                                   initial=0),
+                            eps))
+
+    def test_error_bound(self):
+        rng = np.random.RandomState(0)
+        for _ in range(50):
+            x = sparse_random(rng.randint(1, 80), rng.randint(1, 20),
+                              density=rng.uniform(0.05, 0.8), format='csc',
+                              random_state=rng)
+            x.data = rng.normal(5, 10, x.nnz)
+            for eps in (1, 0.1, 0.01, 0.001):
+                window = rng.randint(1, 60)
+                self.assertWithinBound(x, window, 0, eps)
+                self.assertWithinBound(x.tocsr(), window, 1, eps)
+
+    def test_large_window(self):
+        rng = np.random.RandomState(1)
+        x = sparse_random(2000, 5, density=0.3, format='csc',
+                          random_state=rng, dtype=np.float32)
+        x.data *= 1e4
+        self.assertWithinBound(x, 301, 0, 0.005)
+
+    def test_zeros_are_exact(self):
+        x = sparse_random(100, 10, density=0.1, format='csc',
+                          random_state=np.random.RandomState(2))
+        exact = rolling_median(x, 31, 0)
+        approx = rolling_median_approx(x, 31, 0, eps=0.5)
+        self.assertTrue(np.all(approx.data[exact.data == 0] == 0))
+
+    def test_constant(self):
+        x = sparse_random(50, 4, density=1, format='csc',
+                          random_state=np.random.RandomState(3))
+        x.data[:] = 7
+        approx = rolling_median_approx(x, 9, 0, eps=0.3)
+        self.assertTrue(np.allclose(approx.toarray(),
+                                    rolling_median(x, 9, 0).toarray()))
+
+    def test_invalid_eps(self):
+        x = sparse_random(10, 10, density=0.5, format='csc')
+        for eps in (0, -0.1, 1.5):
+            with self.assertRaises(ValueError):
+                rolling_median_approx(x, 3, 0, eps)
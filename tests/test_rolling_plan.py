@@ -0,0 +1,206 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import csc_matrix, csr_matrix, random as sparse_random
+
+import spectre.sparse.preprocess_cpp as cpp
+import spectre.sparse.preprocess_naive as naive
+from spectre.sparse import _sparse
+from spectre.sparse.preprocess_cpp import RollingPlan
+
+OPS = ['min', 'max', 'mean', 'median', 'sum', 'count']
+
+
+def dense_rolling(x, window, axis, op):
+    """A rolling statistic of the dense matrix over centered windows, the
+    implicit zeros and the padding around each row count as values."""
+    dense = x.toarray() if axis == 0 else x.toarray().T
+    if op == 'count':
+        dense = (dense != 0).astype(dense.dtype)
+    lo = (window - 1) // 2
+    padded = np.pad(dense, ((lo, window - 1 - lo), (0, 0)))
+    shifts = [padded[i:i + len(dense)] for i in range(window)]
+    if op == 'min':
+        result = np.minimum.reduce(shifts)
+    elif op == 'max':
+        result = np.maximum.reduce(shifts)
+    else:
+        result = sum(shifts)
+        if op == 'mean':
+            result = result / window
+    return result if axis == 0 else result.T
+
+
+class TestRollingPlan(TestCase):
+    def setUp(self):
+        rng = np.random.RandomState(7)
+        x = sparse_random(300, 40, density=0.2, format='lil',
+                          random_state=rng) * 10
+        x[:, 5] = 0
+        self.x = x.tocsc()
+
+    def values_of(self, x, seed):
+        """A matrix of the pattern of `x` with other values."""
+        y = x.copy()
+        y.data = np.random.RandomState(seed).uniform(1, 5, y.nnz)
+        return y
+
+    def test_ops(self):
+        for axis, x in [(0, self.x), (1, csr_matrix(self.x.T))]:
+            for window in [1, 3, 7, 501]:
+                plan = RollingPlan(x, window, axis, n_threads=2)
+                for op in OPS:
+                    with self.subTest(axis=axis, window=window, op=op):
+                        result = getattr(plan, op)(x)
+                        expected = getattr(cpp, 'rolling_' + op)(x, window,
+                                                                 axis)
+                        self.assertEqual(type(result), type(expected))
+                        self.assertTrue(np.array_equal(result.indptr,
+                                                       expected.indptr))
+                        self.assertTrue(np.array_equal(result.indices,
+                                                       expected.indices))
+                        self.assertTrue(np.allclose(result.data,
+                                                    expected.data))
+
+                        if op in ['sum', 'count']:
+                            reference = dense_rolling(x, window, axis, op)
+                        else:
+                            reference = getattr(naive, 'rolling_' + op)(
+                                x, window, axis=axis,
+                                mode='constant').toarray()
+                        self.assertTrue(np.allclose(result.toarray(),
+                                                    reference))
+
+    def test_reuse(self):
+        plan = RollingPlan(self.x, 5, 0)
+        out = np.empty(plan._plan.indices.shape)
+        for seed in range(3):
+            y = self.values_of(self.x, seed)
+            result = plan.median(y, out=out)
+            self.assertTrue(np.shares_memory(result.data, out))
+            self.assertTrue(np.allclose(result.toarray(),
+                                        cpp.rolling_median(y, 5, 0).toarray()))
+
+    def test_owned_output(self):
+        plan = RollingPlan(self.x, 5, 0, n_threads=3)
+        first = plan.max(self.x, reuse=True)
+        expected = cpp.rolling_max(self.x, 5, 0).toarray()
+        self.assertTrue(np.allclose(first.toarray(), expected))
+
+        # the next run of the dtype overwrites the values of the plan
+        y = self.values_of(self.x, 1)
+        second = plan.median(y, reuse=True)
+        self.assertTrue(np.shares_memory(first.data, second.data))
+        self.assertTrue(np.allclose(second.toarray(),
+                                    cpp.rolling_median(y, 5, 0).toarray()))
+
+        # other dtypes and the runs without `reuse` have their own values
+        single = plan.max(self.x.astype(np.float32), reuse=True)
+        self.assertFalse(np.shares_memory(single.data, second.data))
+        self.assertTrue(np.allclose(single.toarray(), expected))
+        fresh = plan.max(self.x)
+        self.assertFalse(np.shares_memory(fresh.data, second.data))
+
+    def test_invalid_pattern(self):
+        indptr, indices = self.x.indptr, self.x.indices
+        shifted = indptr + 1
+        unsorted = indices.copy()
+        unsorted[[0, 1]] = unsorted[[1, 0]]
+        outside = indices.copy()
+        outside[-1] = self.x.shape[0]
+        for args in [(indptr[:0], indices), (shifted, indices),
+                     (indptr[::-1].copy(), indices),
+                     (indptr, indices[:-1]), (indptr, unsorted),
+                     (indptr, outside)]:
+            with self.assertRaises(ValueError):
+                _sparse.RollingPlan(*args, self.x.shape[0], 5, np.int64)
+        with self.assertRaises(ValueError):
+            _sparse.RollingPlan(indptr, indices, self.x.shape[0], 0, np.int64)
+
+    def test_mismatched_pattern(self):
+        plan = RollingPlan(self.x, 5, 0)
+
+        # the same number of nonzeros in every column, moved to other rows
+        moved = self.x.copy()
+        moved.indices = (moved.indices + 1) % moved.shape[0]
+        moved.sort_indices()
+        self.assertTrue(np.array_equal(moved.indptr, self.x.indptr))
+        with self.assertRaises(ValueError):
+            plan.max(moved)
+
+        # the same number of nonzeros in other columns
+        shifted = csc_matrix(np.roll(self.x.toarray(), 1, axis=1))
+        self.assertEqual(shifted.nnz, self.x.nnz)
+        with self.assertRaises(ValueError):
+            plan.max(shifted)
+
+        with self.assertRaises(ValueError):
+            plan.sum(self.x[:, :-1])
+
+        # the plan stays usable after a rejected matrix
+        self.assertTrue(np.allclose(
+            plan.max(self.x).toarray(),
+            cpp.rolling_max(self.x, 5, 0).toarray()))
+
+    def test_writeable(self):
+        plan = RollingPlan(self.x, 3, 0)
+        result = plan.min(self.x)
+        self.assertFalse(result.indices.flags.writeable)
+        with self.assertRaises(ValueError):
+            result.eliminate_zeros()
+
+        copied = result.copy()
+        copied.eliminate_zeros()
+        self.assertTrue(np.allclose(copied.toarray(), result.toarray()))
+
+        # a single run owns its structure
+        result = cpp.rolling_min(self.x, 3, 0)
+        self.assertTrue(result.indices.flags.writeable)
+        result.eliminate_zeros()
+
+
+class TestRollingDense(TestCase):
+    """The bulk runs of zeros and the kernels against dense references."""
+
+    def check(self, x, windows, ops=('min', 'max', 'mean', 'sum', 'count')):
+        for axis, y in [(0, csc_matrix(x)), (1, csr_matrix(x.T))]:
+            for window in windows:
+                for op in ops:
+                    with self.subTest(axis=axis, window=window, op=op):
+                        result = getattr(cpp, 'rolling_' + op)(y, window, axis)
+                        self.assertTrue(np.allclose(
+                            result.toarray(),
+                            dense_rolling(y, window, axis, op)))
+
+    def test_long_gaps(self):
+        # runs of three nonzeros apart by gaps of 1 to 80 zeros, wider than
+        # most windows
+        x = np.zeros((200, 6))
+        rng = np.random.RandomState(3)
+        for j, gap in enumerate([1, 4, 9, 17, 40, 80]):
+            rows = np.arange(2, 200, gap + 3)
+            for shift in range(3):
+                x[np.minimum(rows + shift, 199), j] = rng.uniform(-5, 5,
+                                                                  len(rows))
+        self.check(x, [1, 2, 3, 8, 15, 30, 64, 250])
+
+    def test_isolated_peaks(self):
+        # single nonzeros, at the ends and alone in their columns
+        x = np.zeros((50, 5))
+        x[0, 0] = 3
+        x[49, 1] = -2
+        x[[10, 40], 2] = [4, -1]
+        x[25, 3] = 7
+        self.check(x, [1, 2, 5, 20, 49, 50, 101])
+
+    def test_all_negative(self):
+        # windows within the dense runs never see a zero
+        rng = np.random.RandomState(4)
+        x = -rng.uniform(1, 5, (60, 4))
+        x[20:35, 1] = 0
+        x[::7, 2] = 0
+        x[:, 3] = 0
+        x[30, 3] = -1
+        self.check(x, [1, 3, 6, 11, 59])
+        self.assertTrue(np.all(
+            cpp.rolling_max(csc_matrix(x), 3, 0).toarray()[1:-1, 0] < 0))
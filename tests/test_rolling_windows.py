@@ -0,0 +1,80 @@
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import random as sparse_random
+
+import spectre.sparse.preprocess_cpp as cpp
+
+STATS = ['min', 'max', 'mean', 'sum', 'count']
+WINDOWS = [1, 2, 3, 4, 7, 8, 31, 200]
+
+
+def random_matrix(shape, axis, dtype, index_type, seed):
+    rng = np.random.RandomState(seed)
+    x = sparse_random(*shape, density=0.2, format='csr', dtype=dtype,
+                      random_state=rng)
+    x.data = (x.data - 0.5).astype(dtype)
+    x = x.tocsc() if axis == 0 else x.tocsr()
+    x.indptr = x.indptr.astype(index_type)
+    x.indices = x.indices.astype(index_type)
+    return x
+
+
+def cases():
+    seed = 0
+    for axis in [0, 1]:
+        for shape in [(60, 25), (1, 9), (9, 1), (0, 4), (5, 0)]:
+            for dtype in [np.float32, np.float64]:
+                for index_type in [np.int32, np.int64]:
+                    seed += 1
+                    yield random_matrix(shape, axis, dtype, index_type,
+                                        seed), axis
+
+
+class TestRollingWindows(TestCase):
+    def assertSame(self, result, expected, stat):
+        self.assertEqual(type(result), type(expected))
+        self.assertEqual(result.shape, expected.shape)
+        self.assertEqual(result.dtype, expected.dtype)
+        self.assertTrue(np.array_equal(result.indptr, expected.indptr))
+        self.assertTrue(np.array_equal(result.indices, expected.indices))
+        if stat in ('min', 'max', 'count'):
+            self.assertTrue(np.array_equal(result.data, expected.data))
+        else:
+            # the prefix sums round differently than the sliding sums
+            tol = 1e-5 if result.dtype == np.float32 else 1e-12
+            np.testing.assert_allclose(result.data, expected.data,
+                                       rtol=tol, atol=tol)
+
+    def test_single_windows(self):
+        for x, axis in cases():
+            for stat in STATS:
+                with self.subTest(shape=x.shape, axis=axis, dtype=x.dtype,
+                                  index_type=x.indices.dtype, stat=stat):
+                    results = cpp.rolling_windows(x, WINDOWS, stat, axis)
+                    self.assertEqual(len(results), len(WINDOWS))
+                    single = getattr(cpp, 'rolling_' + stat)
+                    for window, result in zip(WINDOWS, results):
+                        self.assertSame(result, single(x, window, axis),
+                                        stat)
+
+    def test_threads(self):
+        x, axis = next(cases())
+        windows = [5, 3, 5, 1]
+        for stat in STATS:
+            expected = cpp.rolling_windows(x, windows, stat, axis,
+                                           n_threads=1)
+            for n_threads in [2, 0]:
+                with self.subTest(stat=stat, n_threads=n_threads):
+                    results = cpp.rolling_windows(x, windows, stat, axis,
+                                                  n_threads)
+                    for result, reference in zip(results, expected):
+                        self.assertSame(result, reference, 'min')
+
+    def test_errors(self):
+        x, axis = next(cases())
+        self.assertEqual(cpp.rolling_windows(x, [], 'sum', axis), [])
+        with self.assertRaises(ValueError):
+            cpp.rolling_windows(x, [3], 'median', axis)
+        with self.assertRaises(ValueError):
+            cpp.rolling_windows(x, [3, 0], 'mean', axis)
@@ -0,0 +1,46 @@
+from unittest import TestCase
+
+import numpy as np
+
+from spectre.synthetic import synthetic_xic
+
+
+class TestSyntheticXic(TestCase):
+    def test_deterministic(self):
+        a = synthetic_xic(n_scans=300, n_peaks=50, seed=7)
+        b = synthetic_xic(n_scans=300, n_peaks=50, seed=7)
+        c = synthetic_xic(n_scans=300, n_peaks=50, seed=8)
+
+        self.assertTrue(np.array_equal(a.data.indptr, b.data.indptr))
+        self.assertTrue(np.array_equal(a.data.indices, b.data.indices))
+        self.assertTrue(np.array_equal(a.data.data, b.data.data))
+        self.assertFalse(np.array_equal(a.data.toarray(), c.data.toarray()))
+
+    def test_shape_and_scales(self):
+        xic = synthetic_xic(n_scans=200, mz_range=(100., 200.), sampling=0.5,
+                            dtype=np.float32)
+
+        self.assertEqual(xic.data.shape, (200, 201))
+        self.assertEqual(xic.data.dtype, np.float32)
+        self.assertTrue(xic.data.has_canonical_format)
+        self.assertTrue(np.allclose(xic.mz_scales[[0, -1]], [100., 200.]))
+        self.assertEqual(len(xic.rt_scales), 200)
+
+    def test_noise_density(self):
+        xic = synthetic_xic(n_scans=500, n_peaks=0, density=0.02, noise=5.)
+        cells = xic.data.shape[0] * xic.data.shape[1]
+
+        # a few noisy cells collide
+        self.assertAlmostEqual(xic.data.nnz / cells, 0.02, delta=0.001)
+        self.assertAlmostEqual(xic.data.data.mean(), 5., delta=0.2)
+        self.assertTrue(np.all(xic.data.data > 0))
+
+    def test_peak_width(self):
+        xic = synthetic_xic(n_scans=400, n_peaks=1, peak_width=20.,
+                            width_spread=0., density=0.)
+        dense = xic.data.toarray()
+        column = dense[:, np.flatnonzero(dense.any(axis=0))[0]]
+
+        half = column >= column.max() / 2
+        self.assertEqual(np.count_nonzero(dense.any(axis=0)), 1)
+        self.assertAlmostEqual(np.count_nonzero(half), 20, delta=1)
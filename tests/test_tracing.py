@@ -0,0 +1,74 @@
+import json
+import os
+import tempfile
+from unittest import TestCase
+
+import numpy as np
+
+import spectre
+from spectre.synthetic import synthetic_xic
+from spectre.tracing import span
+
+
+class TestTracing(TestCase):
+    def test_disabled(self):
+        with span('outside') as s:
+            pass
+        with spectre.profile() as prof:
+            pass
+
+        self.assertIsNotNone(s)
+        self.assertEqual(prof.events, [])
+
+    def test_nested_profiles(self):
+        with spectre.profile():
+            with self.assertRaises(RuntimeError):
+                with spectre.profile():
+                    pass
+
+    def test_preprocess(self):
+        xic = synthetic_xic(n_scans=300, n_peaks=50)
+        nnz = xic.data.nnz
+        with spectre.profile() as prof:
+            spectre.cpp.preprocess(xic, peak_width=5)
+
+        summary = prof.summary()
+        for stage in ['preprocess', 'remove_noise', 'estimate_baseline',
+                      'remove_baseline']:
+            self.assertEqual(summary[stage]['cat'], 'stage')
+            self.assertEqual(summary[stage]['count'], 1)
+        self.assertEqual(summary['convolve_csr_dv']['cat'], 'kernel')
+        self.assertEqual(summary['convolve_csr_dv']['nnz_in'], nnz)
+        self.assertGreater(summary['RollingPlan.median']['bytes'], 0)
+
+        # the kernels nest in their stages
+        outer = [e for e in prof.events if e['name'] == 'preprocess'][0]
+        for e in prof.events:
+            self.assertGreaterEqual(e['begin'], outer['begin'])
+            self.assertLessEqual(e['end'], outer['end'])
+
+        for util in [t['utilisation'] for t in summary.values()
+                     if 'utilisation' in t]:
+            self.assertTrue(0 < util <= 1.01, util)
+
+    def test_chrome_trace(self):
+        with tempfile.TemporaryDirectory() as directory:
+            file = os.path.join(directory, 'trace.json')
+            with spectre.profile(file) as prof:
+                with span('outer'):
+                    with span('inner'):
+                        np.ones(1000).sum()
+
+            with open(file) as f:
+                trace = json.load(f)
+
+        events = trace['traceEvents']
+        self.assertEqual([e['name'] for e in events], ['outer', 'inner'])
+        self.assertEqual(trace['otherData']['dropped'], 0)
+        for e in events:
+            self.assertEqual(e['ph'], 'X')
+            self.assertGreaterEqual(e['dur'], 0)
+        self.assertEqual(events[0]['ts'], 0)
+        self.assertLessEqual(events[1]['ts'] + events[1]['dur'],
+                             events[0]['dur'])
+        self.assertIn('outer', str(prof))
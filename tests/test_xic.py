@@ -0,0 +1,152 @@
+import os
+import pickle
+import tempfile
+from unittest import TestCase
+
+import numpy as np
+from scipy.sparse import csc_matrix
+
+from spectre.synthetic import synthetic_xic
+from spectre.xic import Xic
+
+
+def dense_chromatogram(xic, mz, ppm, rt_range=None, pooling='sum'):
+    """The chromatogram of the dense matrix, column by column."""
+    data = xic.data.toarray()
+    rt = np.asarray(xic.rt_scales)
+    rows = np.ones(len(rt), dtype=bool)
+    if rt_range is not None:
+        rows = (rt >= rt_range[0]) & (rt <= rt_range[1])
+
+    tol = mz * ppm * 1e-6
+    cols = (xic.mz_scales >= mz - tol) & (xic.mz_scales <= mz + tol)
+    selected = data[rows][:, cols]
+    if pooling == 'max':
+        trace = selected.max(axis=1, initial=0)
+    else:
+        trace = selected.sum(axis=1)
+    return rt[rows], trace
+
+
+class TestChromatograms(TestCase):
+    def setUp(self):
+        self.xic = synthetic_xic(n_scans=200, mz_range=(100., 110.),
+                                 n_peaks=30, noise=2., density=0.1, seed=4)
+
+    def assertQuery(self, mz, ppm, rt_range=None, pooling='sum'):
+        rt, traces = self.xic.chromatograms(mz, ppm, rt_range, pooling,
+                                            n_threads=2)
+        self.assertEqual(traces.shape, (len(mz), len(rt)))
+        for target, trace in zip(mz, traces):
+            expected_rt, expected = dense_chromatogram(self.xic, target, ppm,
+                                                       rt_range, pooling)
+            self.assertTrue(np.array_equal(rt, expected_rt))
+            self.assertTrue(np.allclose(trace, expected))
+
+    def test_pooling(self):
+        mz = self.xic.mz_scales[[3, 50, 51, 99]] + 0.01
+        for pooling in ['sum', 'max']:
+            for ppm in [0, 100, 1000]:
+                with self.subTest(pooling=pooling, ppm=ppm):
+                    self.assertQuery(mz, ppm, pooling=pooling)
+
+    def test_ppm_edges(self):
+        # a tolerance ending exactly at a column includes it
+        mz_scales = self.xic.mz_scales
+        target = mz_scales[40]
+        ppm = (mz_scales[41] - target) / target * 1e6
+        self.assertQuery([target], ppm * (1 + 1e-9))
+        self.assertQuery([target], ppm * (1 - 1e-9))
+        self.assertQuery([mz_scales[0] - 1, mz_scales[-1] + 1], 10)
+
+    def test_rt_range(self):
+        rt = self.xic.rt_scales
+        mz = self.xic.mz_scales[::7]
+        for rt_range in [(rt[10], rt[20]), (rt[10] + 1e-6, rt[20] - 1e-6),
+                         (rt[0] - 1, rt[-1] + 1), (rt[5], rt[5]),
+                         (rt[-1] + 1, rt[-1] + 2)]:
+            with self.subTest(rt_range=rt_range):
+                self.assertQuery(mz, 1000, rt_range)
+
+    def test_chromatogram(self):
+        target = self.xic.mz_scales[12]
+        rt, trace = self.xic.chromatogram(target, 500, pooling='max',
+                                          n_threads=2)
+        expected_rt, expected = dense_chromatogram(self.xic, target, 500,
+                                                   pooling='max')
+        self.assertTrue(np.array_equal(rt, expected_rt))
+        self.assertTrue(np.allclose(trace, expected))
+
+        with self.assertRaises(ValueError):
+            self.xic.chromatogram(target, 500, pooling='mean')
+
+    def test_mismatched_mz_scales(self):
+        xic = Xic(self.xic.data, np.r_[self.xic.mz_scales, 200.],
+                  self.xic.rt_scales)
+        with self.assertRaises(ValueError):
+            xic.chromatograms([200.], 10)
+
+
+class TestIndex(TestCase):
+    def test_copy(self):
+        # duplicates and unsorted rows of a CSC matrix stay untouched
+        data = csc_matrix((np.array([1., 2., 3.]), np.array([2, 0, 2]),
+                           np.array([0, 3, 3])), (4, 2))
+        xic = Xic(data, np.array([100., 101.]), np.arange(4.))
+
+        index = xic.index()
+        self.assertIsNot(index, data)
+        self.assertEqual(list(data.indices), [2, 0, 2])
+        self.assertEqual(list(index.indices), [0, 2])
+        self.assertIs(xic.index(), index)
+
+        _, trace = xic.chromatogram(100., 1)
+        self.assertEqual(list(trace), [2., 0., 4., 0.])
+
+        # the index follows a reassignment of the data only
+        xic.data.data *= 2
+        self.assertIs(xic.index(), index)
+        xic.data = xic.data
+        _, trace = xic.chromatogram(100., 1)
+        self.assertEqual(list(trace), [4., 0., 8., 0.])
+
+    def test_canonical(self):
+        # canonical CSC data is the index itself, other formats are copied
+        data = synthetic_xic(n_scans=50, mz_range=(100., 102.), n_peaks=4,
+                             seed=1).data.tocsc()
+        data.sum_duplicates()
+        xic = Xic(data, np.linspace(100., 102., data.shape[1]),
+                  np.arange(float(data.shape[0])))
+        self.assertIs(xic.index(), data)
+
+        for other in [data.tocsr(), data.astype(np.int64)]:
+            xic.data = other
+            self.assertIsNot(xic.index(), other)
+            self.assertTrue(np.array_equal(xic.index().toarray(),
+                                           other.toarray()))
+
+    def test_pickle(self):
+        xic = synthetic_xic(n_scans=50, mz_range=(100., 105.), n_peaks=5)
+        xic.index()
+
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'xic.pkl')
+            xic.to_pickle(path)
+            loaded = Xic.from_pickle(path)
+
+        self.assertIsNone(loaded._index)
+        self.assertTrue(np.array_equal(loaded.data.toarray(),
+                                       xic.data.toarray()))
+        self.assertTrue(np.array_equal(loaded.mz_scales, xic.mz_scales))
+        self.assertTrue(np.array_equal(loaded.rt_scales, xic.rt_scales))
+        self.assertTrue(np.array_equal(
+            loaded.chromatograms(xic.mz_scales[:3], 10)[1],
+            xic.chromatograms(xic.mz_scales[:3], 10)[1]))
+
+        # projects pickled before the index store a plain `data` attribute
+        old = Xic.__new__(Xic)
+        old.__setstate__({'data': xic.data, 'mz_scales': xic.mz_scales,
+                          'rt_scales': xic.rt_scales})
+        self.assertIs(old.data, xic.data)
+        self.assertIsNone(old._index)
+        self.assertIsNot(pickle.loads(pickle.dumps(old)).data, xic.data)
@@ -0,0 +1,46 @@
+# Checks that the code reachable from the baseline runs on any x86-64 CPU.
+#
+# The hot kernels are compiled once per ISA level (see CMakeLists.txt) and any
+# function they share with the baseline, e.g. an out-of-line copy of a
+# standard library template, may end up compiled for the newest level. This
+# disassembles BINARY and fails on a VEX or EVEX encoded instruction, an
+# AVX-512 mask instruction or POPCNT in a function outside of the namespaces
+# of the levels.
+#
+#   cmake -DOBJDUMP=objdump -DBINARY=spectre-preprocess
+#         -DLEVELS=sse42,avx2,avx512 -P check_isa.cmake
+
+execute_process(
+        COMMAND ${OBJDUMP} -d -C --no-show-raw-insn ${BINARY}
+        OUTPUT_VARIABLE disassembly
+        RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${OBJDUMP} failed on ${BINARY}")
+endif ()
+
+# the names of the functions and the instructions of interest, in order
+string(REPLACE ";" "," disassembly "${disassembly}")
+string(REGEX MATCHALL
+        "\n[0-9a-f]+ <[^\n]*>:|\n +[0-9a-f]+:\t(v[a-z0-9]+|k[a-z]+|popcnt) "
+        matches "${disassembly}")
+
+string(REPLACE "," "|" levels "${LEVELS}")
+set(function "")
+set(violations "")
+foreach (match IN LISTS matches)
+    if (match MATCHES "^\n[0-9a-f]+ <(.*)>:$")
+        set(function "${CMAKE_MATCH_1}")
+    elseif (NOT function MATCHES "spectre::(${levels})::")
+        string(REGEX REPLACE "^\n +[0-9a-f]+:\t([a-z0-9]+) $" "\\1"
+                instruction "${match}")
+        list(APPEND violations "${function}: ${instruction}")
+    endif ()
+endforeach ()
+
+list(REMOVE_DUPLICATES violations)
+if (violations)
+    list(JOIN violations "\n  " violations)
+    message(FATAL_ERROR "Functions outside of the ISA levels use "
+            "instructions beyond the baseline:\n  ${violations}")
+endif ()
+message(STATUS "${BINARY}: the baseline code uses baseline instructions only")